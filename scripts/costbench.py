@@ -0,0 +1,328 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Fits the weights used by mwparserfromhell.estimate_cost() to measured
+tokenizing times, and reports how well the estimate predicts them.
+
+Pages are read from the given files and directories (one page per file). If
+none are given, a corpus is generated from typical article markup and the
+tokenizer test cases in tests/tokenizer, with unclosed constructs injected into
+some of the pages. Each page is tokenized --repeat times with the C tokenizer,
+and its fastest time is compared with its features from cost_features().
+Weights are fitted on half of the pages and checked on the other half:
+
+    python scripts/costbench.py path/to/pages/
+    python scripts/costbench.py --fit   (print new weights for costs.py)
+"""
+
+import argparse
+import os
+import random
+import sys
+import time
+
+from mwparserfromhell import parser
+from mwparserfromhell.costs import WEIGHTS, CostFeatures, cost_features
+
+TESTS_DIR = os.path.join(os.path.dirname(__file__), os.pardir, "tests", "tokenizer")
+
+# Pieces of a typical article, and constructs that are left unclosed in broken
+# ones, which make the tokenizer backtrack:
+PIECES = [
+    "The [[quick brown fox]] jumps over the {{lang|en|lazy}} dog. ",
+    "It was '''first''' described in ''1901''.<ref name=a>{{cite|url=x}}</ref> ",
+    "See also [http://example.com the site] and [[Foo|bar]]s.<br />\n",
+    "\n== Section ==\n",
+    "\n{| class=wikitable\n|-\n! A !! B\n|-\n| [[a]] || {{b}}\n|}\n",
+    "{{Infobox\n| name = Foo\n| image = [[File:X.png|thumb|{{c}}]]\n}}\n",
+    '<div style="color: red">Some &amp; text</div> ',
+    "* Item <small>one</small>\n* Item ''two''\n",
+    "Plain prose, without any markup at all, makes up much of most pages. ",
+    "{{cite web|url=http://example.com|title={{lang|en|Foo}}|date=2001}}",
+    "[[Foo]], [[Bar|baz]] and [[Qux]]",
+]
+BROKEN = ["<ref>", "'''", "\n{|\n", "[[a|", "<b>", "{{a|", "{{{", "<span>"]
+
+# The features fitted to broken pages only:
+UNCLOSED = ["unclosed", "unclosed_span", "unclosed_tag_span", "unclosed_markers"]
+
+
+def load_snippets():
+    """Return the inputs of the tokenizer test cases, as in test_tokenizer.py."""
+    snippets = []
+    for filename in sorted(os.listdir(TESTS_DIR)):
+        with open(os.path.join(TESTS_DIR, filename), encoding="utf8") as fp:
+            for line in fp:
+                if line.startswith("input:"):
+                    raw = line[len("input:") :].strip()[1:-1]
+                    raw = raw.encode("raw_unicode_escape").decode("unicode_escape")
+                    snippets.append(raw)
+    return snippets
+
+
+def generate_pages(count, seed):
+    """Generate a corpus of article-like pages, some of them broken.
+
+    Pages are made of typical markup, with a few of the tokenizer test cases
+    mixed in, and a third of them have some unclosed constructs. Each page
+    draws its pieces in different proportions, from plain prose to nothing but
+    templates, so that the features vary independently of each other.
+    """
+    rng = random.Random(seed)
+    snippets = load_snippets()
+    pages = []
+    for _ in range(count):
+        mix = [rng.random() ** 4 for _ in PIECES]
+        if rng.random() < 0.25:
+            only = rng.randrange(len(PIECES))
+            mix = [float(i == only) for i in range(len(PIECES))]
+        parts = []
+        for _ in range(rng.choice([10, 50, 200, 800, 1600])):
+            if rng.random() < 0.02:
+                parts.append(rng.choice(snippets))
+            else:
+                parts.append(rng.choices(PIECES, mix)[0])
+        if rng.random() < 0.33:
+            for _ in range(rng.randint(1, 5)):
+                parts.insert(rng.randrange(len(parts) + 1), rng.choice(BROKEN))
+        pages.append("".join(parts))
+    return pages
+
+
+def read_pages(paths):
+    """Read one page from each file in the given paths."""
+    pages = []
+    for path in paths:
+        if os.path.isdir(path):
+            names = sorted(os.listdir(path))
+            pages.extend(read_pages([os.path.join(path, name) for name in names]))
+        else:
+            with open(path, encoding="utf8") as fp:
+                pages.append(fp.read())
+    return pages
+
+
+def measure(text, repeat):
+    """Return the fastest time to tokenize some text, in microseconds."""
+    tokenizer = parser.CTokenizer()
+    best = None
+    for _ in range(repeat):
+        start = time.perf_counter()
+        tokenizer.tokenize(text)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best * 1e6
+
+
+def solve(rows, targets, columns):
+    """Solve the least squares problem for some columns by the normal equations.
+
+    Return the weights of the columns, or None if they are linearly dependent.
+    """
+    size = len(columns)
+    matrix = [[0.0] * (size + 1) for _ in range(size)]
+    for row, target in zip(rows, targets):
+        values = [row[col] for col in columns]
+        for i in range(size):
+            for j in range(size):
+                matrix[i][j] += values[i] * values[j]
+            matrix[i][size] += values[i] * target
+    for i in range(size):
+        pivot = max(range(i, size), key=lambda k: abs(matrix[k][i]))
+        if abs(matrix[pivot][i]) < 1e-12:
+            return None
+        matrix[i], matrix[pivot] = matrix[pivot], matrix[i]
+        for k in range(size):
+            if k != i:
+                factor = matrix[k][i] / matrix[i][i]
+                for j in range(i, size + 1):
+                    matrix[k][j] -= factor * matrix[i][j]
+    return [matrix[i][size] / matrix[i][i] for i in range(size)]
+
+
+def nnls(rows, targets, columns):
+    """Solve the least squares problem for some columns, keeping the weights
+    non-negative, by the Lawson-Hanson algorithm.
+
+    Return the weights of all of the columns of the rows, with zeros for those
+    left out. Columns are normalized so the normal equations are
+    well-conditioned.
+    """
+    size = len(CostFeatures._fields)
+    norms = {col: max(row[col] for row in rows) or 1 for col in columns}
+    rows = [{col: row[col] / norms[col] for col in columns} for row in rows]
+
+    def gradient(weights):
+        residuals = [
+            target - sum(weights[col] * row[col] for col in columns)
+            for row, target in zip(rows, targets)
+        ]
+        return {
+            col: sum(row[col] * res for row, res in zip(rows, residuals))
+            for col in columns
+        }
+
+    weights = dict.fromkeys(columns, 0.0)
+    active = []
+    while True:
+        grad = gradient(weights)
+        candidates = [col for col in columns if col not in active]
+        best = max(candidates, key=lambda col: grad[col], default=None)
+        if best is None or grad[best] <= 1e-9:
+            break
+        active.append(best)
+        while True:
+            solution = solve(rows, targets, active)
+            if solution is None:
+                active.remove(best)
+                break
+            if all(value > 0 for value in solution):
+                weights.update(zip(active, solution))
+                break
+            step = min(
+                weights[col] / (weights[col] - value)
+                for col, value in zip(active, solution)
+                if value <= 0
+            )
+            for col, value in zip(active, solution):
+                weights[col] += step * (value - weights[col])
+            active = [col for col in active if weights[col] > 1e-12]
+            for col in columns:
+                if col not in active:
+                    weights[col] = 0.0
+        if best not in active:
+            break
+    result = [0.0] * size
+    for col in columns:
+        result[col] = weights[col] / norms[col]
+    return result
+
+
+def fit(rows, targets):
+    """Fit non-negative weights to measured times in two stages.
+
+    The markup features are fitted to the pages without unclosed constructs,
+    and then the unclosed features to what is left of the times of the other
+    pages, so that a few pathological pages don't decide the weights of the
+    markup that every page has. Errors are relative to each page's time, so
+    small pages count as much as large ones, which is what matters when
+    ranking them.
+    """
+    unclosed = [CostFeatures._fields.index(name) for name in UNCLOSED]
+    markup = [col for col in range(len(CostFeatures._fields)) if col not in unclosed]
+    scaled = [
+        ([value / max(target, 1) for value in row], target, max(target, 1))
+        for row, target in zip(rows, targets)
+    ]
+    clean = [(row, 1.0) for row, _, _ in scaled if not row[unclosed[0]]]
+    base = nnls([row for row, _ in clean], [one for _, one in clean], markup)
+    broken = [
+        (row, max(target - estimate(base, row) * scale, 0) / scale)
+        for row, target, scale in scaled
+        if row[unclosed[0]]
+    ]
+    extra = nnls([row for row, _ in broken], [left for _, left in broken], unclosed)
+    return CostFeatures(*[a + b for a, b in zip(base, extra)])
+
+
+def estimate(weights, row):
+    """Return the estimated time of a page from its features."""
+    return sum(weight * value for weight, value in zip(weights, row))
+
+
+def ranks(values):
+    """Return the rank of each value, averaging the ranks of ties."""
+    order = sorted(range(len(values)), key=lambda i: values[i])
+    result = [0.0] * len(values)
+    start = 0
+    while start < len(order):
+        end = start
+        while end + 1 < len(order) and values[order[end + 1]] == values[order[start]]:
+            end += 1
+        for k in range(start, end + 1):
+            result[order[k]] = (start + end) / 2
+        start = end + 1
+    return result
+
+
+def rank_correlation(xs, ys):
+    """Return Spearman's rank correlation between two lists of values."""
+    xs, ys = ranks(xs), ranks(ys)
+    mean = (len(xs) - 1) / 2
+    cov = sum((x - mean) * (y - mean) for x, y in zip(xs, ys))
+    var = (sum((x - mean) ** 2 for x in xs) * sum((y - mean) ** 2 for y in ys)) ** 0.5
+    return cov / var if var else 0.0
+
+
+def report(weights, rows, targets):
+    """Print how well some weights predict the measured times."""
+    estimates = [estimate(weights, row) for row in rows]
+    mean = sum(targets) / len(targets)
+    total = sum((t - mean) ** 2 for t in targets)
+    residual = sum((t - e) ** 2 for t, e in zip(targets, estimates))
+    print("pages: {}, total time: {:.1f} ms".format(len(rows), sum(targets) / 1e3))
+    print("R^2: {:.3f}".format(1 - residual / total if total else 0))
+    print("rank correlation: {:.3f}".format(rank_correlation(estimates, targets)))
+    order = sorted(range(len(rows)), key=lambda i: estimates[i], reverse=True)
+    top = order[: max(len(rows) // 20, 1)]
+    share = sum(targets[i] for i in top) / sum(targets)
+    print(
+        "share of time in the 5% of pages estimated to be slowest: {:.1%}".format(share)
+    )
+    worst = max(range(len(rows)), key=lambda i: targets[i] / max(estimates[i], 1))
+    print(
+        "worst underestimate: {:.0f} us measured, {:.0f} us estimated".format(
+            targets[worst], estimates[worst]
+        )
+    )
+
+
+def main():
+    argparser = argparse.ArgumentParser(description=__doc__.strip().split("\n\n")[0])
+    argparser.add_argument("paths", nargs="*", help="files or directories of pages")
+    argparser.add_argument("--pages", type=int, default=300, help="pages to generate")
+    argparser.add_argument("--seed", type=int, default=0, help="generator seed")
+    argparser.add_argument("--repeat", type=int, default=5, help="timed runs per page")
+    argparser.add_argument("--fit", action="store_true", help="fit new weights")
+    args = argparser.parse_args()
+
+    if not parser.CTokenizer:
+        sys.exit("The C tokenizer isn't available")
+    pages = (
+        read_pages(args.paths) if args.paths else generate_pages(args.pages, args.seed)
+    )
+    rows = [cost_features(page) for page in pages]
+    targets = [measure(page, args.repeat) for page in pages]
+
+    print("current weights:")
+    report(WEIGHTS, rows, targets)
+    if args.fit:
+        weights = fit(rows[::2], targets[::2])
+        print("\nfitted weights, on the held-out pages:")
+        report(weights, rows[1::2], targets[1::2])
+        print()
+        for name, weight in zip(CostFeatures._fields, weights):
+            print("    {}={:.4g},".format(name, weight))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,249 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Runs microbenchmarks of the CTokenizer's primitives, like textbuffer writes,
+stack pushes, and bad route lookups, in isolation.
+
+The benchmarks are only compiled into the extension when it is built with the
+WITH_MICROBENCH environment variable set:
+
+    WITH_MICROBENCH=1 python setup.py build_ext --inplace
+
+Each benchmark is calibrated to run for at least --min-time seconds, warmed up,
+and then timed --repeat times. Results can be saved with --json and compared
+against a previous run with --compare, which uses a Mann-Whitney U test to tell
+real changes from noise:
+
+    python scripts/microbench.py --json before.json
+    (make changes and rebuild)
+    python scripts/microbench.py --compare before.json
+"""
+
+import argparse
+from datetime import datetime
+import json
+from math import erf, sqrt
+import platform
+import subprocess
+import sys
+import time
+
+from mwparserfromhell.parser import _tokenizer
+
+FORMAT_VERSION = 1
+
+
+def percentile(values, fraction):
+    """Return a percentile of a sorted list, interpolating between values."""
+    pos = (len(values) - 1) * fraction
+    low = int(pos)
+    high = min(low + 1, len(values) - 1)
+    return values[low] + (values[high] - values[low]) * (pos - low)
+
+
+def summarize(samples):
+    """Return summary statistics for a list of timings in ns per operation."""
+    values = sorted(samples)
+    mean = sum(values) / len(values)
+    variance = sum((v - mean) ** 2 for v in values) / max(len(values) - 1, 1)
+    return {
+        "min": values[0],
+        "p5": percentile(values, 0.05),
+        "median": percentile(values, 0.5),
+        "p95": percentile(values, 0.95),
+        "max": values[-1],
+        "mean": mean,
+        "stdev": sqrt(variance),
+    }
+
+
+def mann_whitney(first, second):
+    """Return the two-sided p-value of a Mann-Whitney U test on two samples.
+
+    This uses the normal approximation with a correction for ties, which is
+    accurate enough for the sample sizes we use (at least 10 or so each).
+    """
+    combined = sorted([(v, 0) for v in first] + [(v, 1) for v in second])
+    ranks = [0.0] * len(combined)
+    ties = 0.0
+    i = 0
+    while i < len(combined):
+        j = i
+        while j + 1 < len(combined) and combined[j + 1][0] == combined[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2 + 1
+        ties += (j - i + 1) ** 3 - (j - i + 1)
+        i = j + 1
+
+    n1, n2 = len(first), len(second)
+    total = n1 + n2
+    rank_sum = sum(rank for rank, (_, group) in zip(ranks, combined) if group == 0)
+    u = rank_sum - n1 * (n1 + 1) / 2
+    variance = n1 * n2 / 12 * ((total + 1) - ties / (total * (total - 1)))
+    if variance <= 0:
+        return 1.0
+    z = (abs(u - n1 * n2 / 2) - 0.5) / sqrt(variance)
+    return max(0.0, min(1.0, 1 - erf(max(z, 0) / sqrt(2))))
+
+
+def calibrate(name, min_time):
+    """Return a number of iterations that takes at least *min_time* to run."""
+    iterations = 1000
+    while True:
+        start = time.perf_counter()
+        _tokenizer._microbench(name, iterations)
+        elapsed = time.perf_counter() - start
+        if elapsed >= min_time:
+            return iterations
+        iterations *= 2 if elapsed <= 0 else min(max(min_time / elapsed, 1.5), 10)
+        iterations = int(iterations)
+
+
+def run(name, iterations, warmup, repeat):
+    """Run a benchmark, returning its timings in nanoseconds per operation."""
+    for _ in range(warmup):
+        _tokenizer._microbench(name, iterations)
+    samples = []
+    for _ in range(repeat):
+        start = time.perf_counter()
+        _tokenizer._microbench(name, iterations)
+        samples.append((time.perf_counter() - start) * 1e9 / iterations)
+    return samples
+
+
+def get_commit():
+    """Return the current git commit, or None if it can't be found."""
+    try:
+        out = subprocess.run(
+            ["git", "rev-parse", "--short", "HEAD"],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            check=True,
+        ).stdout
+    except (OSError, subprocess.CalledProcessError):
+        return None
+    return out.decode().strip() or None
+
+
+def compare(results, baseline, alpha, unit="ns"):
+    """Print a comparison of two sets of results."""
+    print()
+    print(
+        "{:<20} {:>12} {:>12} {:>9} {:>9}".format(
+            "benchmark",
+            "before ({})".format(unit),
+            "after ({})".format(unit),
+            "change",
+            "p-value",
+        )
+    )
+    for name, result in results.items():
+        if name not in baseline:
+            continue
+        before, after = baseline[name], result
+        change = after["median"] / before["median"] - 1
+        pvalue = mann_whitney(before["samples"], after["samples"])
+        verdict = ""
+        if pvalue < alpha:
+            verdict = "slower" if change > 0 else "faster"
+        print(
+            "{:<20} {:>12.2f} {:>12.2f} {:>+8.1%} {:>9.4f}  {}".format(
+                name, before["median"], after["median"], change, pvalue, verdict
+            )
+        )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split("\n\n")[0])
+    parser.add_argument("names", nargs="*", help="benchmarks to run (default: all)")
+    parser.add_argument("--repeat", type=int, default=25, help="timed runs")
+    parser.add_argument("--warmup", type=int, default=3, help="untimed runs")
+    parser.add_argument(
+        "--min-time", type=float, default=0.02, help="minimum seconds per run"
+    )
+    parser.add_argument("--json", metavar="FILE", help="save results to FILE")
+    parser.add_argument("--compare", metavar="FILE", help="compare against FILE")
+    parser.add_argument(
+        "--alpha", type=float, default=0.01, help="significance level for --compare"
+    )
+    args = parser.parse_args()
+
+    if not hasattr(_tokenizer, "_microbench"):
+        sys.exit(
+            "The microbenchmarks aren't built; rebuild the extension with "
+            "WITH_MICROBENCH=1 python setup.py build_ext --inplace"
+        )
+    available = _tokenizer._microbench_names()
+    names = args.names or available
+    for name in names:
+        if name not in available:
+            sys.exit(
+                "Unknown benchmark: {} (available: {})".format(
+                    name, ", ".join(available)
+                )
+            )
+
+    results = {}
+    print(
+        "{:<20} {:>12} {:>10} {:>10} {:>10} {:>8}".format(
+            "benchmark", "iterations", "median", "p5", "p95", "stdev"
+        )
+    )
+    for name in names:
+        iterations = calibrate(name, args.min_time)
+        samples = run(name, iterations, args.warmup, args.repeat)
+        stats = summarize(samples)
+        results[name] = dict(stats, iterations=iterations, samples=samples)
+        print(
+            "{:<20} {:>12} {:>10.2f} {:>10.2f} {:>10.2f} {:>8.2f}".format(
+                name,
+                iterations,
+                stats["median"],
+                stats["p5"],
+                stats["p95"],
+                stats["stdev"],
+            )
+        )
+
+    if args.json:
+        data = {
+            "version": FORMAT_VERSION,
+            "date": datetime.now().isoformat(timespec="seconds"),
+            "commit": get_commit(),
+            "python": platform.python_version(),
+            "platform": platform.platform(),
+            "unit": "ns/op",
+            "benchmarks": results,
+        }
+        with open(args.json, "w") as fp:
+            json.dump(data, fp, indent=2)
+
+    if args.compare:
+        with open(args.compare) as fp:
+            baseline = json.load(fp)
+        if baseline.get("version") != FORMAT_VERSION:
+            sys.exit("Unsupported results file: " + args.compare)
+        compare(results, baseline["benchmarks"], args.alpha)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,142 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Measures how long it takes a fresh interpreter to import mwparserfromhell and
+parse its first page, which short-lived jobs pay every time they start.
+
+Each sample runs a new Python process that times ``import mwparserfromhell``
+and then the first call to ``mwparserfromhell.parse()``. Results can be saved
+and compared in the same way as with microbench.py:
+
+    python scripts/startbench.py --json before.json
+    (make changes and rebuild)
+    python scripts/startbench.py --compare before.json
+
+Use ``python -X importtime -c "import mwparserfromhell"`` to find out which
+modules are responsible for a slow import.
+"""
+
+import argparse
+from datetime import datetime
+import json
+import platform
+import subprocess
+import sys
+import time
+
+from microbench import compare, get_commit, summarize
+
+FORMAT_VERSION = 1
+
+TEXT = (
+    "{{Infobox person|name=A &amp; B|birth_place=[[Paris]]}}\n"
+    "'''A''' is a <ref name=x>[http://example.com source]</ref> person.\n"
+    "== Life ==\n* [[Category:People|A]] {{cite|{{{1|x}}}}} <!-- c -->\n"
+)
+
+CHILD = """
+import time
+start = time.perf_counter()
+import mwparserfromhell
+imported = time.perf_counter()
+mwparserfromhell.parser.use_c = {use_c}
+mwparserfromhell.parse({text!r})
+parsed = time.perf_counter()
+print(imported - start, parsed - imported)
+"""
+
+NAMES = ["import", "first_parse", "process"]
+
+
+def run_child(python, code):
+    """Run one fresh interpreter, returning its timings in seconds."""
+    start = time.perf_counter()
+    command = [python, "-c", code]
+    out = subprocess.run(command, stdout=subprocess.PIPE, check=True).stdout
+    elapsed = time.perf_counter() - start
+    imported, parsed = (float(value) for value in out.split())
+    return {"import": imported, "first_parse": parsed, "process": elapsed}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split("\n\n")[0])
+    parser.add_argument("--repeat", type=int, default=30, help="timed runs")
+    parser.add_argument("--warmup", type=int, default=3, help="untimed runs")
+    parser.add_argument(
+        "--python", default=sys.executable, help="interpreter to run (default: this)"
+    )
+    parser.add_argument(
+        "--pure", action="store_true", help="use the pure Python tokenizer"
+    )
+    parser.add_argument("--json", metavar="FILE", help="save results to FILE")
+    parser.add_argument("--compare", metavar="FILE", help="compare against FILE")
+    parser.add_argument(
+        "--alpha", type=float, default=0.01, help="significance level for --compare"
+    )
+    args = parser.parse_args()
+
+    code = CHILD.format(text=TEXT, use_c=not args.pure)
+    for _ in range(args.warmup):
+        run_child(args.python, code)
+    samples = {name: [] for name in NAMES}
+    for _ in range(args.repeat):
+        for name, value in run_child(args.python, code).items():
+            samples[name].append(value * 1e3)
+
+    results = {}
+    print(
+        "{:<20} {:>10} {:>10} {:>10} {:>8}".format(
+            "benchmark", "median", "p5", "p95", "stdev"
+        )
+    )
+    for name in NAMES:
+        stats = summarize(samples[name])
+        results[name] = dict(stats, samples=samples[name])
+        print(
+            "{:<20} {:>10.2f} {:>10.2f} {:>10.2f} {:>8.2f}".format(
+                name, stats["median"], stats["p5"], stats["p95"], stats["stdev"]
+            )
+        )
+
+    if args.json:
+        data = {
+            "version": FORMAT_VERSION,
+            "date": datetime.now().isoformat(timespec="seconds"),
+            "commit": get_commit(),
+            "python": platform.python_version(),
+            "platform": platform.platform(),
+            "unit": "ms",
+            "benchmarks": results,
+        }
+        with open(args.json, "w") as fp:
+            json.dump(data, fp, indent=2)
+
+    if args.compare:
+        with open(args.compare) as fp:
+            baseline = json.load(fp)
+        if baseline.get("version") != FORMAT_VERSION:
+            sys.exit("Unsupported results file: " + args.compare)
+        compare(results, baseline["benchmarks"], args.alpha, unit="ms")
+
+
+if __name__ == "__main__":
+    main()
@@ -71,10 +71,18 @@ if fallback:
 
 # Project-specific part begins here:
 
+# Set env var WITH_MICROBENCH=1 to build the microbenchmarks used by
+# scripts/microbench.py into the extension:
+
+define_macros = []
+if os.environ.get("WITH_MICROBENCH") == "1":
+    define_macros.append(("MWP_MICROBENCH", "1"))
+
 tokenizer = Extension(
     "mwparserfromhell.parser._tokenizer",
     sources=sorted(glob("src/mwparserfromhell/parser/ctokenizer/*.c")),
     depends=sorted(glob("src/mwparserfromhell/parser/ctokenizer/*.h")),
+    define_macros=define_macros,
 )
 
 setup(
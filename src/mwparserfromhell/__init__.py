@@ -30,6 +30,44 @@ __license__ = "MIT License"
 __version__ = "0.7.dev0"
 __email__ = "ben.kurtovic@gmail.com"
 
+from importlib import import_module
+import sys
+
 from . import definitions, nodes, parser, smart_list, string_mixin, utils, wikicode
 
 parse = utils.parse_anything
+
+# Modules (and shortcuts to their functions) that most jobs never use, so they
+# aren't imported until they are first accessed:
+_LAZY = {
+    "costs": ("costs", None),
+    "diffs": ("diffs", None),
+    "expansion": ("expansion", None),
+    "jsonify": ("jsonify", None),
+    "prefilters": ("prefilters", None),
+    "rewrite": ("rewrite", None),
+    "selectors": ("selectors", None),
+    "diff": ("diffs", "diff"),
+    "estimate_cost": ("costs", "estimate_cost"),
+    "expand": ("expansion", "expand"),
+    "prefilter": ("prefilters", "prefilter"),
+}
+
+
+def __getattr__(name):
+    if name not in _LAZY:
+        raise AttributeError("module {!r} has no attribute {!r}".format(__name__, name))
+    modname, attr = _LAZY[name]
+    module = import_module("." + modname, __name__)
+    value = module if attr is None else getattr(module, attr)
+    globals()[name] = value
+    return value
+
+
+def __dir__():
+    return sorted(set(globals()) | set(_LAZY))
+
+
+if sys.version_info < (3, 7):  # No module __getattr__ before PEP 562
+    for _name in _LAZY:
+        __getattr__(_name)
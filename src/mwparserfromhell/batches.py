@@ -0,0 +1,287 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Contains columnar record batches for collecting large numbers of extraction
+results, such as every template parameter in a dump, without creating a Python
+object for each row.
+
+A :class:`RecordBatch` stores each column in contiguous buffers, in the same
+layout as Arrow arrays: integer columns are an :class:`array.array` of 64-bit
+integers, and string columns are an array of ``len(column) + 1`` 64-bit
+offsets into a :class:`bytearray` of UTF-8 data, so that row *i* is
+``data[offsets[i]:offsets[i + 1]]``. All of these support the buffer
+protocol, so they can be wrapped without copying, for example with
+``numpy.frombuffer(column, dtype="int64")`` or, for a string column,
+``pyarrow.Array.from_buffers(pyarrow.large_utf8(), len(column), [None,
+pyarrow.py_buffer(column.offsets), pyarrow.py_buffer(column.data)])``.
+
+:func:`extract_templates` and :func:`scan_pages` fill batches from parsed
+pages and from raw text scanned by a :class:`.Prefilter`.
+"""
+
+from array import array
+from itertools import repeat
+
+from .nodes import Template, Text
+from .utils import iter_layout, parse_anything, render_title
+
+__all__ = [
+    "RecordBatch",
+    "StringColumn",
+    "TEMPLATE_SCHEMA",
+    "SCAN_SCHEMA",
+    "extract_templates",
+    "scan_pages",
+]
+
+#: The columns of the batches made by :func:`extract_templates`.
+TEMPLATE_SCHEMA = (
+    ("page_id", "int64"),
+    ("template", "string"),
+    ("param", "string"),
+    ("value", "string"),
+    ("start", "int64"),
+    ("end", "int64"),
+)
+
+#: The columns of the batches made by :func:`scan_pages`.
+SCAN_SCHEMA = (("page_id", "int64"), ("offset", "int64"), ("pattern", "string"))
+
+
+class StringColumn:
+    """A column of strings stored as offsets into one buffer of UTF-8 data.
+
+    :attr:`offsets` is an :class:`array.array` of 64-bit integers and
+    :attr:`data` is a :class:`bytearray`. Indexing decodes a single string.
+    Columns read by :mod:`.transport` hold read-only :class:`memoryview`
+    objects instead, and can't be appended to.
+    """
+
+    __slots__ = ("offsets", "data")
+
+    def __init__(self, values=()):
+        self.offsets = array("q", [0])
+        self.data = bytearray()
+        for value in values:
+            self.append(value)
+
+    def __repr__(self):
+        return "StringColumn({!r})".format(self.to_list())
+
+    def __len__(self):
+        return len(self.offsets) - 1
+
+    def __getitem__(self, index):
+        if index < 0:
+            index += len(self)
+        if not 0 <= index < len(self):
+            raise IndexError("StringColumn index out of range")
+        start, end = self.offsets[index], self.offsets[index + 1]
+        return str(self.data[start:end], "utf8")
+
+    def __eq__(self, other):
+        if isinstance(other, StringColumn):
+            return self.offsets == other.offsets and self.data == other.data
+        return NotImplemented
+
+    @property
+    def nbytes(self):
+        """The size of the column's buffers, in bytes."""
+        return self.offsets.itemsize * len(self.offsets) + len(self.data)
+
+    def append(self, value):
+        """Add a string to the end of the column."""
+        self.data += value.encode("utf8")
+        self.offsets.append(len(self.data))
+
+    def to_list(self):
+        """Return the column as a list of strings."""
+        data, offsets = self.data, self.offsets
+        return [
+            str(data[offsets[i] : offsets[i + 1]], "utf8") for i in range(len(self))
+        ]
+
+
+class RecordBatch:
+    """A batch of rows stored as columns.
+
+    *schema* is a sequence of ``(name, type)`` pairs, where *type* is
+    ``"int64"`` or ``"string"``. Columns are available by name through
+    indexing, as an ``array("q")`` for integer columns or a
+    :class:`StringColumn`.
+    """
+
+    def __init__(self, schema):
+        self._schema = tuple(schema)
+        self._columns = {}
+        for name, kind in self._schema:
+            if kind == "int64":
+                self._columns[name] = array("q")
+            elif kind == "string":
+                self._columns[name] = StringColumn()
+            else:
+                raise ValueError("Unknown column type: {!r}".format(kind))
+
+    @classmethod
+    def _from_columns(cls, schema, columns):
+        """Return a batch wrapping existing columns, without copying them."""
+        batch = cls.__new__(cls)
+        batch._schema = tuple(schema)
+        batch._columns = dict(columns)
+        return batch
+
+    def __repr__(self):
+        names = ", ".join(name for name, _ in self._schema)
+        return "RecordBatch({} rows: {})".format(len(self), names)
+
+    def __len__(self):
+        return len(self._columns[self._schema[0][0]]) if self._schema else 0
+
+    def __getitem__(self, name):
+        return self._columns[name]
+
+    @property
+    def schema(self):
+        """The ``(name, type)`` pairs of the batch's columns."""
+        return self._schema
+
+    @property
+    def nbytes(self):
+        """The total size of the batch's buffers, in bytes."""
+        total = 0
+        for column in self._columns.values():
+            if isinstance(column, StringColumn):
+                total += column.nbytes
+            else:
+                total += column.itemsize * len(column)
+        return total
+
+    def append(self, *row):
+        """Add a row, given as one value per column, in schema order."""
+        if len(row) != len(self._schema):
+            raise ValueError("Expected {} values".format(len(self._schema)))
+        for (name, _), value in zip(self._schema, row):
+            self._columns[name].append(value)
+
+    def to_pylist(self):
+        """Return the rows of the batch as a list of dicts."""
+        names = [name for name, _ in self._schema]
+        columns = [
+            column.to_list() if isinstance(column, StringColumn) else column.tolist()
+            for column in (self._columns[name] for name in names)
+        ]
+        return [dict(zip(names, row)) for row in zip(*columns)]
+
+
+def _add_templates(batch, page_id, code):
+    """Add a row to *batch* for each parameter of each template in *code*.
+
+    Rows go straight into the columns as the tree is walked, in the order of
+    :meth:`.Wikicode.filter`. A template's rows are added before its children
+    are visited, so their ``end`` is filled in once the walk gets past it.
+    """
+    page_ids, starts, ends = batch["page_id"], batch["start"], batch["end"]
+    templates, params, values = batch["template"], batch["param"], batch["value"]
+
+    def visit(code, pos):
+        for node in code.nodes:
+            if type(node) is Text:  # pylint: disable=unidiomatic-typecheck
+                pos += len(node.value)
+                continue
+            first, count = len(ends), 0
+            if isinstance(node, Template):
+                name = render_title(node.name)
+                for param in node.params:
+                    params.append(str(param.name).strip())
+                    values.append(str(param.value).strip())
+                    count += 1
+                if not count:
+                    params.append("")
+                    values.append("")
+                    count = 1
+                for _ in range(count):
+                    templates.append(name)
+                page_ids.extend(repeat(page_id, count))
+                starts.extend(repeat(pos, count))
+                ends.extend(repeat(pos, count))
+            for part in iter_layout(node):
+                if isinstance(part, int):
+                    pos += part
+                else:
+                    pos = visit(part, pos)
+            for row in range(first, first + count):
+                ends[row] = pos
+        return pos
+
+    visit(code, 0)
+
+
+def extract_templates(pages, batch_size=65536):
+    """Yield :class:`RecordBatch` objects of the templates in some pages.
+
+    *pages* is an iterable of ``(page_id, code)`` pairs, where *code* is a
+    :class:`.Wikicode` object or a string to be parsed; use ``((page.id,
+    page.code) for page in pipeline)`` for a :class:`.DumpPipeline`. The
+    batches follow :data:`TEMPLATE_SCHEMA`, with one row for each parameter
+    of each template, including nested templates. A template without
+    parameters gets one row with an empty parameter name and value.
+
+    ``template`` is the template's name, normalized by
+    :func:`.utils.normalize_title`, ``param`` and ``value`` are stripped of
+    surrounding whitespace, and ``start`` and ``end`` are the offsets of the
+    whole template in the page's text. A batch is yielded once it has at
+    least *batch_size* rows, so the rows of a page are never split.
+    """
+    batch = RecordBatch(TEMPLATE_SCHEMA)
+    for page_id, code in pages:
+        _add_templates(batch, page_id, parse_anything(code))
+        if len(batch) >= batch_size:
+            yield batch
+            batch = RecordBatch(TEMPLATE_SCHEMA)
+    if len(batch):
+        yield batch
+
+
+def scan_pages(prefilter, pages, batch_size=65536):
+    """Yield :class:`RecordBatch` objects of the hits of a :class:`.Prefilter`.
+
+    *pages* is an iterable of ``(page_id, text)`` pairs, where *text* is a
+    string or UTF-8 encoded ``bytes``. The pages are not parsed. The batches
+    follow :data:`SCAN_SCHEMA`, with one row for each result of
+    :meth:`.Prefilter.search`, and are yielded like in
+    :func:`extract_templates`.
+    """
+    batch = RecordBatch(SCAN_SCHEMA)
+    for page_id, text in pages:
+        hits = prefilter.search(text)
+        if hits:
+            page_ids, offsets = batch["page_id"], batch["offset"]
+            patterns = batch["pattern"]
+            for offset, pattern in hits:
+                page_ids.append(page_id)
+                offsets.append(offset)
+                patterns.append(pattern)
+            if len(batch) >= batch_size:
+                yield batch
+                batch = RecordBatch(SCAN_SCHEMA)
+    if len(batch):
+        yield batch
@@ -0,0 +1,450 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Contains the command-line interface, run as ``python -m mwparserfromhell``.
+
+It has four subcommands, which each read a batch of pages and write one line
+of JSON per page:
+
+- ``extract`` writes the templates and wikilinks of each page;
+- ``strip`` writes the text of each page, as given by
+  :meth:`.Wikicode.strip_code`;
+- ``stats`` writes the size of each page, how long it took to parse, and how
+  many nodes of each type it has;
+- ``bench`` only parses the pages, and writes nothing but the summary.
+
+Pages are read from files, directories (searched for files matching
+``--glob``, ``*.wiki`` by default), standard input (``-``, which is also the
+default), or a multistream dump given with ``--dump`` and ``--index``. The
+title of a page read from a file is its path.
+
+Pages are handled by a pool of ``--jobs`` worker processes, since the
+tokenizer holds the GIL. Workers read the files and decompress the dump
+streams themselves, so the main process only writes the output. Lines are
+written in input order, or as soon as they are ready with ``--unordered``.
+Pages that can't contain any of the templates or links given with ``--match``
+are skipped without being parsed (see :mod:`.prefilters`).
+
+Files that can't be read and pages that fail to parse don't stop the run:
+each error is written to standard error as it happens and counted in the
+summary, and the exit status is 1 if there were any.
+
+When it's done, a summary with the throughput and the slowest pages is
+written to standard error, or to standard output for ``bench``.
+"""
+
+import argparse
+from fnmatch import fnmatch
+import heapq
+import json
+from multiprocessing import Pool
+import os
+import sys
+import time
+
+from . import parser
+from .dumps import MultistreamDump
+from .nodes import Template, Wikilink
+from .utils import parse_anything
+
+__all__ = ["main"]
+
+_encode = json.JSONEncoder(ensure_ascii=False, separators=(",", ":")).encode
+
+# The options of the current process, set by _init_worker():
+_options = None
+_prefilter = None
+
+
+def _extract(code):
+    """Return the templates and wikilinks of a page."""
+    templates = []
+    links = []
+    for node in code.filter(forcetype=(Template, Wikilink)):
+        if isinstance(node, Template):
+            params = {
+                str(param.name).strip(): str(param.value).strip()
+                for param in node.params
+            }
+            templates.append({"name": str(node.name).strip(), "params": params})
+        else:
+            text = str(node.text).strip() if node.text is not None else None
+            links.append({"title": str(node.title).strip(), "text": text})
+    return {"templates": templates, "links": links}
+
+
+def _strip(code):
+    """Return the stripped text of a page."""
+    keep = _options.keep_template_params
+    return {"text": code.strip_code(keep_template_params=keep)}
+
+
+def _stats(code):
+    """Return the number of nodes of each type in a page."""
+    counts = {}
+    for node in code.filter():
+        name = type(node).__name__.lower()
+        counts[name] = counts.get(name, 0) + 1
+    return {"nodes": counts}
+
+
+_COMMANDS = {"extract": _extract, "strip": _strip, "stats": _stats, "bench": None}
+
+
+def _init_worker(options):
+    """Set up a process to handle pages with the given options."""
+    global _options, _prefilter  # pylint: disable=global-statement
+    _options = options
+    _prefilter = None
+    if options.match:
+        from .prefilters import Prefilter
+
+        _prefilter = Prefilter(options.match)
+
+
+def _load(unit):
+    """Return the pages of a unit of work as ``(id, title, text)`` tuples."""
+    kind, value = unit
+    if kind == "file":
+        with open(value, "rb") as fp:
+            return [(None, value, fp.read().decode("utf8", "replace"))]
+    if kind == "text":
+        return [(None, "-", value)]
+    dump = MultistreamDump(_options.dump, _options.index)
+    return [(pid, title, text) for pid, _, title, text in dump.read_stream(*value)]
+
+
+def _describe(exc):
+    """Return the message of an exception raised while handling a page."""
+    if isinstance(exc, OSError):
+        return exc.strerror or str(exc)
+    return "{}: {}".format(type(exc).__name__, exc)
+
+
+def _handle(unit):
+    """Handle a unit of work, returning a result for each of its pages.
+
+    Each result is a ``(id, title, size, seconds, line, error)`` tuple, where
+    *size* is in UTF-8 bytes, *seconds* is the time spent parsing the page and
+    running the command on it, and *line* is its JSON output (``None`` for
+    pages that were skipped, and for ``bench``). *error* is ``None``, or a
+    message if the page failed, in which case *seconds* and *line* are
+    ``None``; a unit that can't be read gives a single failed result titled
+    with its path.
+    """
+    command = _COMMANDS[_options.command]
+    try:
+        pages = _load(unit)
+    except Exception as exc:  # pylint: disable=broad-except
+        path = unit[1] if unit[0] == "file" else _options.dump
+        return [(None, path, 0, None, None, _describe(exc))]
+    results = []
+    for pid, title, text in pages:
+        size = len(text.encode("utf8"))
+        if _prefilter and not _prefilter.matches(text):
+            results.append((pid, title, size, None, None, None))
+            continue
+        start = time.perf_counter()
+        try:
+            code = parse_anything(text, skip_style_tags=_options.skip_style_tags)
+            data = command(code) if command else None
+        except Exception as exc:  # pylint: disable=broad-except
+            results.append((pid, title, size, None, None, _describe(exc)))
+            continue
+        seconds = time.perf_counter() - start
+        line = None
+        if command:
+            record = {"id": pid, "title": title}
+            if _options.command == "stats":
+                record.update(bytes=size, seconds=round(seconds, 6))
+            record.update(data)
+            line = _encode(record)
+        results.append((pid, title, size, seconds, line, None))
+    return results
+
+
+def _find_units(options, stdin):
+    """Yield the units of work given on the command line."""
+    if options.dump:
+        for stream in MultistreamDump(options.dump, options.index).streams:
+            yield ("stream", stream)
+    for path in options.inputs or ([] if options.dump else ["-"]):
+        if path == "-":
+            yield ("text", stdin.read())
+        elif os.path.isdir(path):
+            for root, dirs, files in os.walk(path):
+                dirs.sort()
+                for name in sorted(files):
+                    if fnmatch(name, options.glob):
+                        yield ("file", os.path.join(root, name))
+        else:
+            yield ("file", path)
+
+
+class _Summary:
+    """Collects the throughput of a run and its slowest pages."""
+
+    def __init__(self, outliers):
+        self.pages = 0
+        self.skipped = 0
+        self.errors = []
+        self.size = 0
+        self.seconds = 0.0
+        self._outliers = outliers
+        self._slowest = []
+        self._start = time.perf_counter()
+        self._order = 0
+
+    def add(self, pid, title, size, seconds, error=None):
+        """Record the result of a page."""
+        self.size += size
+        if error is not None:
+            self.errors.append({"id": pid, "title": title, "error": error})
+            return
+        if seconds is None:
+            self.skipped += 1
+            return
+        self.pages += 1
+        self.seconds += seconds
+        if self._outliers:
+            self._order += 1
+            item = (seconds, self._order, pid, title, size)
+            if len(self._slowest) < self._outliers:
+                heapq.heappush(self._slowest, item)
+            else:
+                heapq.heappushpop(self._slowest, item)
+
+    def as_dict(self, jobs):
+        """Return the summary as a JSON-compatible dict."""
+        elapsed = time.perf_counter() - self._start
+        slowest = sorted(self._slowest, reverse=True)
+        return {
+            "pages": self.pages,
+            "skipped": self.skipped,
+            "failed": len(self.errors),
+            "bytes": self.size,
+            "elapsed": elapsed,
+            "parse_seconds": self.seconds,
+            "pages_per_second": self.pages / elapsed if elapsed else 0.0,
+            "bytes_per_second": self.size / elapsed if elapsed else 0.0,
+            "jobs": jobs,
+            "tokenizer": "C" if parser.use_c else "Python",
+            "slowest": [
+                {"id": pid, "title": title, "bytes": size, "seconds": seconds}
+                for seconds, _, pid, title, size in slowest
+            ],
+            "errors": self.errors,
+        }
+
+
+def _format_summary(summary):
+    """Return a summary returned by :meth:`_Summary.as_dict` as text."""
+    lines = [
+        "{} pages ({} skipped, {} failed), {:.2f} MB in {:.3f} s".format(
+            summary["pages"],
+            summary["skipped"],
+            summary["failed"],
+            summary["bytes"] / 1e6,
+            summary["elapsed"],
+        ),
+        "{:.1f} pages/s, {:.2f} MB/s ({} jobs, {} tokenizer)".format(
+            summary["pages_per_second"],
+            summary["bytes_per_second"] / 1e6,
+            summary["jobs"],
+            summary["tokenizer"],
+        ),
+    ]
+    if summary["slowest"]:
+        lines.append("slowest pages:")
+        for page in summary["slowest"]:
+            lines.append(
+                "  {:10.3f} ms {:10.1f} kB  {}".format(
+                    page["seconds"] * 1000, page["bytes"] / 1000, page["title"]
+                )
+            )
+    if summary["errors"]:
+        lines.append("failed pages:")
+        for page in summary["errors"]:
+            lines.append("  {}: {}".format(page["title"], page["error"]))
+    return "\n".join(lines) + "\n"
+
+
+def _make_parser():
+    """Return the :class:`argparse.ArgumentParser` for the command line."""
+    common = argparse.ArgumentParser(add_help=False)
+    common.add_argument(
+        "inputs",
+        nargs="*",
+        metavar="PATH",
+        help="files or directories to read pages from, or - for stdin",
+    )
+    common.add_argument(
+        "--glob",
+        default="*.wiki",
+        help="the names of the files to read in directories (default: *.wiki)",
+    )
+    common.add_argument("--dump", help="a local multistream dump to read pages from")
+    common.add_argument("--index", help="the index of the dump given with --dump")
+    common.add_argument(
+        "-j",
+        "--jobs",
+        type=int,
+        default=os.cpu_count() or 1,
+        help="the number of worker processes (default: the number of CPUs)",
+    )
+    common.add_argument(
+        "--chunksize",
+        type=int,
+        default=8,
+        help="the number of files or dump streams given to a worker at once",
+    )
+    common.add_argument(
+        "-u",
+        "--unordered",
+        action="store_true",
+        help="write pages as soon as they are done instead of in input order",
+    )
+    common.add_argument(
+        "-o", "--output", help="the file to write the output to (default: stdout)"
+    )
+    common.add_argument(
+        "--match",
+        action="append",
+        metavar="NAME",
+        help="skip pages that can't use this template or link to this page "
+        "(may be given more than once)",
+    )
+    common.add_argument(
+        "--skip-style-tags",
+        action="store_true",
+        help="don't parse '' and ''' as italics and bold",
+    )
+    common.add_argument(
+        "--outliers",
+        type=int,
+        default=5,
+        metavar="N",
+        help="the number of slowest pages to list in the summary (default: 5)",
+    )
+    common.add_argument(
+        "-q", "--quiet", action="store_true", help="don't write the summary"
+    )
+
+    argparser = argparse.ArgumentParser(
+        prog="python -m mwparserfromhell",
+        description="Parse a batch of pages in parallel.",
+    )
+    subparsers = argparser.add_subparsers(dest="command", metavar="COMMAND")
+    subparsers.required = True
+    subparsers.add_parser(
+        "extract", parents=[common], help="write the templates and links of pages"
+    )
+    strip = subparsers.add_parser(
+        "strip", parents=[common], help="write the text of pages without markup"
+    )
+    strip.add_argument(
+        "--keep-template-params",
+        action="store_true",
+        help="keep the values of template parameters",
+    )
+    subparsers.add_parser(
+        "stats", parents=[common], help="write the size and node counts of pages"
+    )
+    bench = subparsers.add_parser(
+        "bench", parents=[common], help="parse pages and only write the summary"
+    )
+    bench.add_argument("--json", action="store_true", help="write the summary as JSON")
+    return argparser
+
+
+def _run(options, units, write, summary, stderr):
+    """Handle the units of work, writing their output as it's ready.
+
+    Pages that failed are reported to *stderr* as they come in.
+    """
+    if options.jobs <= 1:
+        _init_worker(options)
+        results = map(_handle, units)
+        pool = None
+    else:
+        pool = Pool(options.jobs, _init_worker, (options,))
+        imap = pool.imap_unordered if options.unordered else pool.imap
+        results = imap(_handle, units, options.chunksize)
+    try:
+        for pages in results:
+            for pid, title, size, seconds, line, error in pages:
+                summary.add(pid, title, size, seconds, error)
+                if error is not None:
+                    stderr.write("error: {}: {}\n".format(title, error))
+                elif line is not None:
+                    write(line + "\n")
+    finally:
+        if pool:
+            pool.terminate()
+            pool.join()
+
+
+def main(argv=None, stdin=None, stdout=None, stderr=None):
+    """Run the command line with the given arguments, returning an exit status.
+
+    *argv* defaults to :data:`sys.argv`, and the streams to those of
+    :mod:`sys`.
+    """
+    stdin = stdin or sys.stdin
+    stdout = stdout or sys.stdout
+    stderr = stderr or sys.stderr
+    argparser = _make_parser()
+    options = argparser.parse_args(argv)
+    if bool(options.dump) != bool(options.index):
+        argparser.error("--dump and --index must be given together")
+    if options.jobs < 1 or options.chunksize < 1:
+        argparser.error("--jobs and --chunksize must be positive")
+    if options.match:
+        from .prefilters import Prefilter
+
+        try:
+            Prefilter(options.match)
+        except ValueError as exc:
+            argparser.error(str(exc))
+    if not hasattr(options, "keep_template_params"):
+        options.keep_template_params = False
+
+    summary = _Summary(options.outliers)
+    units = _find_units(options, stdin)
+    try:
+        if options.output:
+            with open(options.output, "w", encoding="utf8") as fp:
+                _run(options, units, fp.write, summary, stderr)
+        else:
+            _run(options, units, stdout.write, summary, stderr)
+    except OSError as exc:
+        stderr.write("error: {}\n".format(exc))
+        return 1
+
+    result = summary.as_dict(options.jobs)
+    if options.command == "bench" and options.json:
+        stdout.write(json.dumps(result, ensure_ascii=False, indent=2) + "\n")
+    elif options.command == "bench":
+        stdout.write(_format_summary(result))
+    elif not options.quiet:
+        stderr.write(_format_summary(result))
+    return 1 if summary.errors else 0
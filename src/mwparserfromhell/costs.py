@@ -0,0 +1,180 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Contains a cheap estimate of how long some wikicode will take to parse, for
+scheduling pages before parsing them, as in :func:`estimate_cost`.
+
+Most of the time spent tokenizing a page is proportional to its length and
+number of markup characters, but a few features make some pages far slower
+than their size suggests: an unclosed tag, table, or link makes the tokenizer
+try to close it until the end of the page before backtracking, so it costs
+about as much as the markup after it, and runs of apostrophes, tags, and
+tables each need extra work. The estimate counts these
+features in a single linear scan of the text, which runs in C, without
+holding the GIL, when the C tokenizer is available, and combines them with
+weights fitted to measured tokenizing times (see ``scripts/costbench.py``).
+"""
+
+from collections import namedtuple
+import re
+
+from . import parser
+
+try:
+    from .parser._tokenizer import _cost_scan
+except ImportError:
+    _cost_scan = None
+
+__all__ = ["CostFeatures", "cost_features", "estimate_cost"]
+
+CostFeatures = namedtuple(
+    "CostFeatures",
+    [
+        "length",
+        "markers",
+        "templates",
+        "links",
+        "tags",
+        "apostrophes",
+        "table_markers",
+        "unclosed",
+        "unclosed_span",
+        "unclosed_tag_span",
+        "unclosed_markers",
+    ],
+)
+
+# Microseconds of C tokenizer time per unit of each feature, as fitted by
+# scripts/costbench.py:
+WEIGHTS = CostFeatures(
+    length=0.0262,
+    markers=0.183,
+    templates=3.45,
+    links=1.59,
+    tags=5.96,
+    apostrophes=0.0,
+    table_markers=0.856,
+    unclosed=5.57,
+    unclosed_span=0.00947,
+    unclosed_tag_span=0.0,
+    unclosed_markers=0.376,
+)
+
+_MARKERS = set("{}[]<>|=&'#*;:/-!\n\0")
+_SINGLE = {"br", "wbr", "hr", "meta", "link", "img", "li", "dt", "dd", "th", "td", "tr"}
+_TAG_NAME = re.compile(r"[A-Za-z]*")
+
+
+def _scan(text):
+    """Python version of scan() in cost.c."""
+    if not isinstance(text, str):
+        text = bytes(text).decode("latin1")
+    length = len(text)
+    counts = dict.fromkeys(CostFeatures._fields, 0)
+    braces, brackets, tags, tables = [], [], [], []
+    line_start = True
+    in_tag = False
+    i = 0
+    while i < length:
+        char = text[i]
+        if char not in _MARKERS:
+            line_start = False
+            i += 1
+            continue
+        run = 1
+        while i + run < length and text[i + run] == char:
+            run += 1
+        after = text[i + run] if i + run < length else ""
+        counts["markers"] += run
+        if char == "{":
+            if run >= 2:
+                counts["templates"] += 1
+                braces.append((i, counts["markers"]))
+            elif line_start and after == "|":
+                counts["table_markers"] += 1
+                tables.append((i, counts["markers"]))
+        elif char == "[":
+            if run >= 2:
+                counts["links"] += 1
+                brackets.append((i, counts["markers"]))
+        elif char == "}":
+            del braces[max(len(braces) - run // 2, 0) :]
+        elif char == "]":
+            del brackets[max(len(brackets) - run // 2, 0) :]
+        elif char == "'":
+            if run >= 2:
+                counts["apostrophes"] += 1
+        elif char in "|!":
+            if char == "|" and line_start and run == 1 and after == "}" and tables:
+                tables.pop()
+            counts["table_markers"] += line_start + (run >= 2)
+        elif char == "<":
+            if run == 1 and after == "/":
+                if tags:
+                    tags.pop()
+                in_tag = False
+            elif run == 1 and after < "\x80" and "a" <= after.lower() <= "z":
+                counts["tags"] += 1
+                name = _TAG_NAME.match(text, i + 1).group(0)
+                if name.lower() not in _SINGLE:
+                    tags.append((i, counts["markers"]))
+                    in_tag = True
+        elif char == "/":
+            if after == ">" and in_tag and tags:
+                tags.pop()
+                in_tag = False
+        elif char == ">":
+            in_tag = False
+        line_start = char == "\n"
+        i += run
+
+    counts["length"] = length
+    counts["unclosed"] = len(braces) + len(brackets) + len(tags) + len(tables)
+    openers = braces + brackets + tags + tables
+    counts["unclosed_span"] = sum(length - index for index, _ in braces + brackets)
+    counts["unclosed_tag_span"] = sum(length - index for index, _ in tags + tables)
+    counts["unclosed_markers"] = sum(counts["markers"] - num for _, num in openers)
+    return tuple(counts.values())
+
+
+def cost_features(text):
+    """Return the :class:`CostFeatures` of *text* used to estimate its cost.
+
+    *text* is a string, or UTF-8 encoded ``bytes`` (in which case lengths and
+    offsets are counted in bytes).
+    """
+    if _cost_scan and parser.use_c:
+        return CostFeatures(*_cost_scan(text))
+    return CostFeatures(*_scan(text))
+
+
+def estimate_cost(text):
+    """Return an estimate of how long it will take to tokenize *text*.
+
+    The result is in microseconds of C tokenizer time on the machine the
+    weights were fitted on, so it is most useful for comparing pages with each
+    other, such as to balance shards of work or to send the most expensive
+    pages to dedicated workers. Scanning is much faster than parsing: about as
+    fast as :meth:`.Prefilter.matches`.
+    """
+    features = cost_features(text)
+    return sum(weight * value for weight, value in zip(WEIGHTS, features))
@@ -0,0 +1,286 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Contains :func:`diff`, which compares the structure of two :class:`.Wikicode`
+trees, such as two revisions of a page.
+
+Every node, parameter, and attribute in both trees is first given a hash of its
+type, its fields, and the hashes of its children, in one pass over each tree.
+Lists of children are then aligned by hash, so identical subtrees are matched
+and skipped without being walked again, and only the parts that differ are
+compared in detail. The result is a list of :class:`Change` objects:
+
+- ``"remove"``: an item of the old tree that has no counterpart in the new one;
+- ``"insert"``: an item of the new tree that has no counterpart in the old one;
+- ``"modify"``: an item that is in both trees, but with different contents.
+
+Items of the same type in the same place are treated as modified versions of
+each other, preferring items with the same name: templates and wikilinks are
+matched by normalized title, and parameters and attributes by name. A modified
+item is followed by the changes inside it, so a changed parameter is reported
+as a modified template, then a modified parameter, then changes to the nodes in
+its value.
+
+Each change has the paths of its item in the old and new trees (``None`` for
+the tree it isn't in). A path is a tuple of keys leading from the root, where
+integers index lists of nodes, parameters, or attributes, and strings name the
+fields that hold them, as in :mod:`.jsonify`: ``(3, "params", 0, "value", 1)``
+is the second node in the value of the first parameter of the fourth node.
+"""
+
+from collections import deque, namedtuple
+from difflib import SequenceMatcher
+
+from .nodes import (
+    Argument,
+    Comment,
+    ExternalLink,
+    Heading,
+    HTMLEntity,
+    Tag,
+    Template,
+    Text,
+    Wikilink,
+)
+from .nodes.extras import Attribute, Parameter
+from .utils import parse_anything, render_title
+from .wikicode import Wikicode
+
+__all__ = ["Change", "diff"]
+
+Change = namedtuple("Change", ["op", "old_path", "new_path", "old", "new"])
+
+
+def _fields(item):
+    """Return the type, scalar fields, and child fields of a tree item.
+
+    Child fields are ``(name, value)`` pairs, where *value* is a
+    :class:`.Wikicode` object, a list of parameters or attributes, or ``None``.
+    """
+    kind = type(item)
+    if kind is Text:
+        return "text", (item.value,), ()
+    if kind is Template:
+        return "template", (), (("name", item.name), ("params", item.params))
+    if kind is Parameter:
+        children = (("name", item.name), ("value", item.value))
+        return "parameter", (item.showkey,), children
+    if kind is Wikilink:
+        return "wikilink", (), (("title", item.title), ("text", item.text))
+    if kind is Argument:
+        return "argument", (), (("name", item.name), ("default", item.default))
+    if kind is ExternalLink:
+        scalars = (item.brackets, item.suppress_space)
+        return "extlink", scalars, (("url", item.url), ("title", item.title))
+    if kind is Heading:
+        return "heading", (item.level,), (("title", item.title),)
+    if kind is Comment:
+        return "comment", (item.contents,), ()
+    if kind is HTMLEntity:
+        return "entity", (item.value, item.named, item.hexadecimal, item.hex_char), ()
+    if kind is Tag:
+        scalars = (
+            item.wiki_markup,
+            item.self_closing,
+            item.invalid,
+            item.implicit,
+            item.padding,
+            item.wiki_style_separator,
+            item.closing_wiki_markup,
+        )
+        children = (
+            ("tag", item.tag),
+            ("attributes", item.attributes),
+            ("contents", item.contents),
+            ("closing_tag", item.closing_tag),
+        )
+        return "tag", scalars, children
+    if kind is Attribute:
+        scalars = (item.quotes, item.pad_first, item.pad_before_eq, item.pad_after_eq)
+        return "attribute", scalars, (("name", item.name), ("value", item.value))
+    return kind.__name__, (str(item),), ()
+
+
+def _items(value):
+    """Return the list of items in a child field."""
+    if value is None:
+        return []
+    if isinstance(value, Wikicode):
+        return value.nodes
+    return value
+
+
+class _Differ:
+    """Hashes two trees and collects the changes between them."""
+
+    def __init__(self):
+        self.hashes = {}
+        self.changes = []
+
+    def hash_items(self, items):
+        """Hash a list of items and everything inside them.
+
+        Each item's hash is stored by ID, and the hash of the list is returned.
+        """
+        hashes = self.hashes
+        values = []
+        for item in items:
+            if type(item) is Text:  # pylint: disable=unidiomatic-typecheck
+                value = hash(item.value)
+            else:
+                kind, scalars, children = _fields(item)
+                subtrees = tuple(
+                    None if child is None else self.hash_items(_items(child))
+                    for _, child in children
+                )
+                value = hash((kind, scalars, subtrees))
+            hashes[id(item)] = value
+            values.append(value)
+        return hash(tuple(values))
+
+    @staticmethod
+    def key(item):
+        """Return what an item is matched by, on top of its type."""
+        kind = type(item)
+        if kind is Template:
+            return render_title(item.name)
+        if kind is Parameter:
+            return str(item.name).strip()
+        if kind is Attribute:
+            return str(item.name).strip().lower()
+        if kind is Wikilink:
+            return render_title(item.title)
+        return None
+
+    @staticmethod
+    def fallback_key(item):
+        """Return what an item is matched by if its key doesn't match."""
+        kind = type(item)
+        return None if kind is Parameter or kind is Attribute else kind
+
+    def pair(self, old, new):
+        """Pair up unmatched old and new items that are versions of each other.
+
+        Return a list where each new item has the index of its old item, or
+        ``None``. Items with the same type and key are paired first, then the
+        remaining nodes with the same type, in order. Parameters and attributes
+        with different names are never paired.
+        """
+        pairs = [None] * len(new)
+        used = set()
+        for key in (lambda item: (type(item), self.key(item)), self.fallback_key):
+            waiting = {}
+            for i, item in enumerate(old):
+                if i not in used:
+                    waiting.setdefault(key(item), deque()).append(i)
+            waiting.pop(None, None)
+            for j, item in enumerate(new):
+                if pairs[j] is None:
+                    candidates = waiting.get(key(item))
+                    if candidates:
+                        pairs[j] = candidates.popleft()
+                        used.add(pairs[j])
+        return pairs
+
+    def diff_items(self, old, new, old_path, new_path):
+        """Diff two lists of items, found at the given paths."""
+        hashes = self.hashes
+        old_hashes = [hashes[id(item)] for item in old]
+        new_hashes = [hashes[id(item)] for item in new]
+        if old_hashes == new_hashes:
+            return
+
+        start = 0
+        end = min(len(old), len(new))
+        while start < end and old_hashes[start] == new_hashes[start]:
+            start += 1
+        tail = 0
+        while tail < end - start and old_hashes[-1 - tail] == new_hashes[-1 - tail]:
+            tail += 1
+
+        matcher = SequenceMatcher(
+            None,
+            old_hashes[start : len(old) - tail],
+            new_hashes[start : len(new) - tail],
+        )
+        for op, i1, i2, j1, j2 in matcher.get_opcodes():
+            if op != "equal":
+                olds = range(start + i1, start + i2)
+                news = range(start + j1, start + j2)
+                self.diff_block(old, new, olds, news, old_path, new_path)
+
+    def diff_block(self, old, new, olds, news, old_path, new_path):
+        """Diff the items at two ranges of indices that weren't matched by hash."""
+        pairs = self.pair([old[i] for i in olds], [new[j] for j in news])
+        paired = set(pairs)
+        for n, i in enumerate(olds):
+            if n not in paired:
+                self.changes.append(
+                    Change("remove", old_path + (i,), None, old[i], None)
+                )
+        for j, n in zip(news, pairs):
+            path = new_path + (j,)
+            if n is None:
+                self.changes.append(Change("insert", None, path, None, new[j]))
+            else:
+                i = olds[n]
+                self.diff_item(old[i], new[j], old_path + (i,), path)
+
+    def diff_item(self, old, new, old_path, new_path):
+        """Diff two versions of the same item."""
+        if self.hashes[id(old)] == self.hashes[id(new)]:
+            return
+        self.changes.append(Change("modify", old_path, new_path, old, new))
+        _, _, old_children = _fields(old)
+        _, _, new_children = _fields(new)
+        for (name, old_child), (_, new_child) in zip(old_children, new_children):
+            self.diff_items(
+                _items(old_child),
+                _items(new_child),
+                old_path + (name,),
+                new_path + (name,),
+            )
+
+
+def diff(old, new):
+    """Return the structural differences between two trees.
+
+    *old* and *new* are :class:`.Wikicode` objects, or anything that can be
+    parsed by :func:`.parse_anything`. The result is a list of
+    :class:`Change` named tuples of ``(op, old_path, new_path, old, new)``, as
+    described in the module documentation, where *old* and *new* are the
+    changed nodes, parameters, or attributes. Changes are listed in the order
+    their items appear, except that removals come first in each run of items
+    that differ.
+
+    Identical subtrees are skipped by comparing hashes, so the time taken is
+    roughly linear in the size of the trees.
+    """
+    if not isinstance(old, Wikicode):
+        old = parse_anything(old)
+    if not isinstance(new, Wikicode):
+        new = parse_anything(new)
+    differ = _Differ()
+    differ.hash_items(old.nodes)
+    differ.hash_items(new.nodes)
+    differ.diff_items(old.nodes, new.nodes, (), ())
+    return differ.changes
@@ -0,0 +1,475 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Contains tools for reading local multistream XML dumps (the
+``pages-articles-multistream.xml.bz2`` files published by Wikimedia) and
+parsing their pages in a pipeline of worker threads.
+
+A multistream dump is a concatenation of independent bz2 streams, each holding
+up to a hundred ``<page>`` elements, and comes with an index file that gives
+the byte offset of every stream. Since :mod:`bz2` releases the GIL while
+decompressing, the streams can be decompressed in parallel threads and then
+handed to parser workers through bounded queues.
+"""
+
+import bz2
+from collections import namedtuple
+import os
+import queue
+import threading
+import time
+from xml.etree import ElementTree
+
+from .parser import Parser
+from .prefilters import Prefilter
+
+__all__ = ["DumpPage", "DumpPipeline", "DumpStats", "IndexEntry", "MultistreamDump"]
+
+IndexEntry = namedtuple("IndexEntry", ["offset", "id", "title"])
+DumpPage = namedtuple("DumpPage", ["id", "ns", "title", "text", "code"])
+
+_FOOTER = b"</mediawiki>"
+
+
+def _open_maybe_bz2(path):
+    """Open *path* for reading text, transparently decompressing bz2 files."""
+    with open(path, "rb") as fp:
+        magic = fp.read(3)
+    if magic == b"BZh":
+        return bz2.open(path, "rt", encoding="utf8")
+    return open(path, "r", encoding="utf8")
+
+
+def read_index(path):
+    """Yield :class:`IndexEntry` tuples from a multistream index file.
+
+    Each line of the index has the form ``offset:page_id:title``. The file may
+    be bz2-compressed (as published) or already decompressed.
+    """
+    with _open_maybe_bz2(path) as fp:
+        for line in fp:
+            line = line.rstrip("\n")
+            if not line:
+                continue
+            offset, page_id, title = line.split(":", 2)
+            yield IndexEntry(int(offset), int(page_id), title)
+
+
+def _parse_stream(data):
+    """Return the pages contained in a decompressed stream of XML."""
+    data = data.rstrip()
+    if data.endswith(_FOOTER):
+        data = data[: -len(_FOOTER)]
+    root = ElementTree.fromstring(b"<pages>" + data + b"</pages>")
+    pages = []
+    for page in root.iter("page"):
+        revisions = page.findall("revision")
+        text = revisions[-1].findtext("text") if revisions else None
+        pages.append(
+            (
+                int(page.findtext("id")),
+                int(page.findtext("ns", "0")),
+                page.findtext("title"),
+                text or "",
+            )
+        )
+    return pages
+
+
+class DumpStats:
+    """Throughput and queue-depth statistics for a :class:`DumpPipeline`.
+
+    All counters are updated by the worker threads while the pipeline runs and
+    can be read at any time; :meth:`as_dict` returns a consistent snapshot.
+    """
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._started = None
+        self._finished = None
+        self.streams = 0
+        self.pages = 0
+        self.skipped_pages = 0
+        self.compressed_bytes = 0
+        self.uncompressed_bytes = 0
+        self._depths = {}
+
+    def _start(self):
+        self._started = time.perf_counter()
+
+    def _finish(self):
+        if self._finished is None:
+            self._finished = time.perf_counter()
+
+    def _add_stream(self, compressed, uncompressed, pages, skipped=0):
+        with self._lock:
+            self.streams += 1
+            self.pages += pages
+            self.skipped_pages += skipped
+            self.compressed_bytes += compressed
+            self.uncompressed_bytes += uncompressed
+
+    def _record_depth(self, name, depth):
+        with self._lock:
+            current = self._depths.get(name)
+            if current is None:
+                self._depths[name] = [depth, depth, depth, 1]
+            else:
+                current[0] = depth
+                current[1] = max(current[1], depth)
+                current[2] += depth
+                current[3] += 1
+
+    @property
+    def elapsed(self):
+        """The number of seconds the pipeline has been running for."""
+        if self._started is None:
+            return 0.0
+        end = self._finished if self._finished is not None else time.perf_counter()
+        return end - self._started
+
+    @property
+    def pages_per_second(self):
+        """The average number of pages read per second."""
+        elapsed = self.elapsed
+        return self.pages / elapsed if elapsed else 0.0
+
+    @property
+    def bytes_per_second(self):
+        """The average number of uncompressed bytes read per second."""
+        elapsed = self.elapsed
+        return self.uncompressed_bytes / elapsed if elapsed else 0.0
+
+    def queue_depth(self, name):
+        """Return ``(current, maximum, mean)`` depths of the queue *name*.
+
+        The queues are ``"streams"`` (decompressed streams waiting for a parser
+        worker) and ``"results"`` (parsed pages waiting for the consumer).
+        """
+        with self._lock:
+            current = self._depths.get(name)
+            if current is None:
+                return (0, 0, 0.0)
+            return (current[0], current[1], current[2] / current[3])
+
+    def as_dict(self):
+        """Return a snapshot of all statistics as a dictionary."""
+        with self._lock:
+            depths = {
+                name: {"current": d[0], "max": d[1], "mean": d[2] / d[3]}
+                for name, d in self._depths.items()
+            }
+            data = {
+                "streams": self.streams,
+                "pages": self.pages,
+                "skipped_pages": self.skipped_pages,
+                "compressed_bytes": self.compressed_bytes,
+                "uncompressed_bytes": self.uncompressed_bytes,
+            }
+        data["elapsed"] = self.elapsed
+        data["pages_per_second"] = self.pages_per_second
+        data["bytes_per_second"] = self.bytes_per_second
+        data["queues"] = depths
+        return data
+
+
+class MultistreamDump:
+    """Represents a local multistream dump file and its index.
+
+    *path* is the ``.xml.bz2`` dump and *index_path* is its index, either
+    compressed or not. Nothing is read until the streams are needed.
+    """
+
+    def __init__(self, path, index_path):
+        self._path = path
+        self._index_path = index_path
+        self._streams = None
+
+    @property
+    def path(self):
+        """The path to the dump file."""
+        return self._path
+
+    @property
+    def index_path(self):
+        """The path to the dump's index file."""
+        return self._index_path
+
+    @property
+    def streams(self):
+        """A list of ``(start, end)`` byte ranges of the dump's page streams.
+
+        The leading stream containing the ``<siteinfo>`` header is excluded.
+        """
+        if self._streams is None:
+            offsets = sorted({entry.offset for entry in read_index(self._index_path)})
+            ends = offsets[1:] + [os.path.getsize(self._path)]
+            self._streams = list(zip(offsets, ends))
+        return self._streams
+
+    def read_stream(self, start, end, fp=None):
+        """Return the pages in the stream between the byte offsets given.
+
+        Pages are returned as ``(id, ns, title, text)`` tuples. *fp*, if given,
+        is an open binary file object for the dump to read from.
+        """
+        return _parse_stream(self._read(start, end, fp)[1])
+
+    def _read(self, start, end, fp=None):
+        """Return the compressed size and decompressed data of a stream."""
+        if fp is None:
+            with open(self._path, "rb") as fp:
+                return self._read(start, end, fp)
+        fp.seek(start)
+        raw = fp.read(end - start)
+        return len(raw), bz2.decompress(raw)
+
+    def pages(self, **kwargs):
+        """Return a :class:`DumpPipeline` over the pages in this dump.
+
+        Keyword arguments are passed to :class:`DumpPipeline`.
+        """
+        return DumpPipeline(self, **kwargs)
+
+
+class _Sentinel:
+    """Marks the end of a worker's input or output."""
+
+
+_DONE = _Sentinel()
+
+
+class DumpPipeline:
+    """An iterator over the parsed pages of a :class:`MultistreamDump`.
+
+    Streams are decompressed by *threads* worker threads and handed through a
+    bounded queue of *queue_size* streams to *parse_threads* parser workers,
+    each with its own :class:`.Parser`. Parsed pages are yielded as
+    :class:`DumpPage` tuples whose ``code`` is a :class:`.Wikicode` object, or
+    ``None`` if *parse* is ``False``.
+
+    If *ordered* is ``True``, pages are yielded in dump order; at most
+    *queue_size* streams are buffered ahead of the slowest one. Otherwise,
+    pages are yielded as soon as their stream is finished. *skip_style_tags* is
+    passed to :meth:`.Parser.parse`.
+
+    If *prefilter* is given, as a :class:`.Prefilter` or a list of patterns for
+    one, pages that it doesn't match are skipped by the decompression threads
+    without being parsed or yielded. They are counted in the ``skipped_pages``
+    statistic.
+
+    Note that the C tokenizer holds the GIL while parsing, so additional parser
+    workers mostly help to overlap parsing with XML decoding; the
+    decompression threads are where the parallelism comes from.
+
+    Statistics are available from :attr:`stats` while iterating and after.
+    Iteration may be stopped early; the worker threads are shut down when the
+    iterator is closed or garbage collected.
+    """
+
+    def __init__(
+        self,
+        dump,
+        threads=4,
+        parse_threads=1,
+        ordered=True,
+        queue_size=16,
+        parse=True,
+        skip_style_tags=False,
+        prefilter=None,
+    ):
+        if threads < 1 or parse_threads < 1 or queue_size < 1:
+            raise ValueError("threads and queue_size must be positive")
+        self._dump = dump
+        self._threads = threads
+        self._parse_threads = parse_threads if parse else 0
+        self._ordered = ordered
+        self._queue_size = queue_size
+        self._skip_style_tags = skip_style_tags
+        if prefilter is not None and not isinstance(prefilter, Prefilter):
+            prefilter = Prefilter(prefilter)
+        self._prefilter = prefilter
+        self._stats = DumpStats()
+        self._iter = None
+
+    @property
+    def stats(self):
+        """The :class:`DumpStats` for this pipeline."""
+        return self._stats
+
+    def __iter__(self):
+        if self._iter is None:
+            self._iter = self._run()
+        return self._iter
+
+    def __next__(self):
+        return next(iter(self))
+
+    def close(self):
+        """Stop iterating and shut down the worker threads."""
+        if self._iter is not None:
+            self._iter.close()
+
+    def _put(self, target, item, name=None):
+        """Put *item* into the queue *target* unless the pipeline stops."""
+        while not self._stop.is_set():
+            try:
+                target.put(item, timeout=0.05)
+            except queue.Full:
+                continue
+            if name:
+                self._stats._record_depth(name, target.qsize())
+            return True
+        return False
+
+    def _get(self, source):
+        """Get the next item from the queue *source* unless we stop."""
+        while not self._stop.is_set():
+            try:
+                return source.get(timeout=0.05)
+            except queue.Empty:
+                continue
+        return _DONE
+
+    def _decompress_worker(self):
+        """Decompress and decode streams until there are none left."""
+        stop, window = self._stop, self._window
+        try:
+            with open(self._dump.path, "rb") as fp:
+                while not stop.is_set():
+                    if window is not None:
+                        while not window.acquire(timeout=0.05):
+                            if stop.is_set():
+                                return
+                    try:
+                        seq = self._tasks.get_nowait()
+                    except queue.Empty:
+                        if window is not None:
+                            window.release()
+                        return
+                    start, end = self._streams[seq]
+                    size, data = self._dump._read(start, end, fp)
+                    pages = _parse_stream(data)
+                    count = len(pages)
+                    if self._prefilter is not None:
+                        matches = self._prefilter.matches
+                        pages = [page for page in pages if matches(page[3])]
+                    self._stats._add_stream(size, len(data), count, count - len(pages))
+                    if not self._put(self._stream_queue, (seq, pages), "streams"):
+                        return
+        except BaseException as exc:  # pylint: disable=broad-except
+            self._errors.append(exc)
+            stop.set()
+        finally:
+            with self._lock:
+                self._running -= 1
+                last = self._running == 0
+            if last:
+                for _ in range(max(self._parse_threads, 1)):
+                    self._put(self._stream_queue, _DONE)
+
+    def _parse_worker(self):
+        """Parse the pages of decompressed streams until there are none left."""
+        parser = Parser(keep_interned=True)
+        skip = self._skip_style_tags
+        try:
+            while True:
+                item = self._get(self._stream_queue)
+                if item is _DONE:
+                    break
+                seq, pages = item
+                parsed = [
+                    DumpPage(pid, ns, title, text, parser.parse(text, 0, skip))
+                    for pid, ns, title, text in pages
+                ]
+                if not self._put(self._result_queue, (seq, parsed), "results"):
+                    return
+        except BaseException as exc:  # pylint: disable=broad-except
+            self._errors.append(exc)
+            self._stop.set()
+        finally:
+            self._put(self._result_queue, _DONE)
+
+    def _run(self):
+        """Start the worker threads and yield pages as they are finished."""
+        self._streams = self._dump.streams
+        self._tasks = queue.Queue()
+        for seq in range(len(self._streams)):
+            self._tasks.put(seq)
+        self._stop = threading.Event()
+        self._lock = threading.Lock()
+        self._errors = []
+        self._running = self._threads
+        self._window = None
+        if self._ordered:
+            self._window = threading.BoundedSemaphore(self._queue_size + self._threads)
+        self._stream_queue = queue.Queue(self._queue_size)
+        if self._parse_threads:
+            self._result_queue = queue.Queue(self._queue_size)
+            finishers = self._parse_threads
+        else:
+            self._result_queue = self._stream_queue
+            finishers = 1
+
+        workers = [
+            threading.Thread(target=self._decompress_worker, daemon=True)
+            for _ in range(self._threads)
+        ]
+        workers += [
+            threading.Thread(target=self._parse_worker, daemon=True)
+            for _ in range(self._parse_threads)
+        ]
+        self._stats._start()
+        for worker in workers:
+            worker.start()
+
+        pending = {}
+        next_seq = 0
+        try:
+            while finishers:
+                item = self._get(self._result_queue)
+                if self._errors:
+                    raise self._errors[0]
+                if item is _DONE:
+                    finishers -= 1
+                    continue
+                seq, pages = item
+                if not self._ordered:
+                    yield from self._wrap(pages)
+                    continue
+                pending[seq] = pages
+                while next_seq in pending:
+                    yield from self._wrap(pending.pop(next_seq))
+                    self._window.release()
+                    next_seq += 1
+        finally:
+            self._stop.set()
+            for worker in workers:
+                worker.join()
+            self._stats._finish()
+
+    def _wrap(self, pages):
+        """Yield *pages* as :class:`DumpPage` tuples."""
+        if self._parse_threads:
+            yield from pages
+        else:
+            for pid, ns, title, text in pages:
+                yield DumpPage(pid, ns, title, text, None)
@@ -0,0 +1,262 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Contains tools for expanding templates offline, against template sources
+stored locally in a dictionary or a directory.
+
+Each template body is parsed once (as it would be transcluded; see the *view*
+argument of :meth:`.Parser.parse`) and its tree is cached. Expanding a
+template substitutes the :class:`.Argument`\\ s in its body with the values
+passed to it, and the result is memoized by the template's title and
+arguments. Parser functions and magic words are not evaluated; they are left
+in the output as they are, along with templates that can't be found.
+"""
+
+import os
+import re
+
+from .nodes import Argument, Template, Text
+from .parser import Parser
+from .utils import parse_anything
+from .wikicode import Wikicode
+
+__all__ = ["ExpansionError", "Expander", "expand"]
+
+
+class ExpansionError(Exception):
+    """Raised when expanding some wikicode would exceed the size limit."""
+
+
+class Expander:
+    """Expands templates in wikicode against a local source of templates.
+
+    *source_provider* can be a mapping or a directory path. Keys are full page
+    titles, like ``"Template:Foo"`` or ``"User:Bar/box"``. Templates can also
+    be stored by their name alone, like ``"Foo"``. A directory must contain
+    one file per page named after it, optionally with a ``.wiki`` extension,
+    with ``/`` replaced by ``%2F``. It can also be a function that takes a
+    full page title and returns the page's source, or ``None`` if it doesn't
+    exist.
+
+    Templates nested more than *max_depth* levels deep, or that transclude
+    themselves, are left unexpanded. If the total size of text produced by
+    templates while expanding some wikicode exceeds *max_size*,
+    :exc:`ExpansionError` is raised.
+
+    An :class:`Expander` keeps its caches between calls to :meth:`expand`,
+    so one should be reused for every page that uses the same templates.
+    """
+
+    def __init__(self, source_provider, max_depth=40, max_size=2 * 1024 * 1024):
+        self._provider = source_provider
+        self.max_depth = max_depth
+        self.max_size = max_size
+        self._parser = Parser(keep_interned=True)
+        self._bodies = {}
+        self._results = {}
+        self._stack = []
+        self._size = 0
+        self._limited = 0
+        self._deepest = 0
+        self._titles = set()
+
+    @staticmethod
+    def _normalize(name):
+        """Return the full page title and bare name of a template, or None."""
+        name = re.sub(r"[\s_]+", " ", name).strip()
+        if name.startswith(":"):
+            title = name[1:].lstrip()
+            return (title[:1].upper() + title[1:], None) if title else None
+        if ":" in name:
+            prefix, rest = name.split(":", 1)
+            prefix, rest = prefix.strip(), rest.strip()
+            if not prefix or not rest:
+                return None
+            if prefix.lower() != "template":
+                prefix = prefix[:1].upper() + prefix[1:]
+                return prefix + ":" + rest[:1].upper() + rest[1:], None
+            name = rest
+        if not name:
+            return None
+        name = name[:1].upper() + name[1:]
+        return "Template:" + name, name
+
+    def _load(self, title, name):
+        """Return the source of the page with the given title, or None."""
+        provider = self._provider
+        if callable(provider):
+            return provider(title)
+        candidates = (title, name) if name else (title,)
+        if isinstance(provider, (str, os.PathLike)):
+            for candidate in candidates:
+                filename = candidate.replace("/", "%2F")
+                for ext in ("", ".wiki"):
+                    path = os.path.join(provider, filename + ext)
+                    if os.path.isfile(path):
+                        with open(path, encoding="utf8") as fp:
+                            return fp.read()
+            return None
+        for candidate in candidates:
+            if candidate in provider:
+                return provider[candidate]
+        return None
+
+    def _get_body(self, title, name):
+        """Return the cached tree of a template's body, or None."""
+        if title not in self._bodies:
+            source = self._load(title, name)
+            if source is not None:
+                source = self._parser.parse(source, view="transcluded")
+            self._bodies[title] = source
+        return self._bodies[title]
+
+    def _find_holes(self, codes, holes):
+        """Find the templates and arguments in some wikicode objects.
+
+        Holes are added to *holes* as ``(node list, index, node)`` tuples. We
+        don't look inside them, since they are expanded on their own.
+        """
+        for code in codes:
+            for i, node in enumerate(code.nodes):
+                if isinstance(node, (Template, Argument)):
+                    holes.append((code.nodes, i, node))
+                else:
+                    self._find_holes(node.__children__(), holes)
+
+    def _render(self, obj, args, depth):
+        """Render a :class:`.Wikicode` or :class:`.Node` with holes expanded.
+
+        The holes are temporarily replaced with :class:`.Text` nodes holding
+        their expansions, so the tree is left unchanged afterwards.
+        """
+        holes = []
+        codes = [obj] if isinstance(obj, Wikicode) else obj.__children__()
+        self._find_holes(codes, holes)
+        if not holes:
+            return str(obj)
+        values = [self._expand_hole(node, args, depth) for _, _, node in holes]
+        for (nodes, i, _), value in zip(holes, values):
+            nodes[i] = Text(value)
+        try:
+            return str(obj)
+        finally:
+            for nodes, i, node in holes:
+                nodes[i] = node
+
+    def _expand_hole(self, node, args, depth):
+        """Return the expansion of a template or argument."""
+        if isinstance(node, Argument):
+            name = self._render(node.name, args, depth).strip()
+            if name in args:
+                return args[name]
+            if node.default is not None:
+                return self._render(node.default, args, depth)
+            return self._render(node, args, depth)
+        return self._expand_template(node, args, depth)
+
+    def _expand_template(self, template, args, depth):
+        """Return the expansion of a template, or its source if we can't."""
+        normalized = self._normalize(self._render(template.name, args, depth))
+        body = self._get_body(*normalized) if normalized else None
+        if body is None:
+            return self._render(template, args, depth)
+        title = normalized[0]
+        if depth >= self.max_depth or title in self._stack:
+            self._limited += 1
+            return self._render(template, args, depth)
+
+        params = {}
+        for param in template.params:
+            value = self._render(param.value, args, depth)
+            if param.showkey:
+                key = self._render(param.name, args, depth).strip()
+                params[key] = value.strip()
+            else:
+                params[str(param.name)] = value
+        key = (title, tuple(sorted(params.items())))
+        cached = self._results.get(key)
+        if cached and self._reusable(cached, depth):
+            result, span, titles = cached
+        else:
+            result, span, titles = self._expand_body(key, body, params, depth)
+        self._deepest = max(self._deepest, depth + span)
+        self._titles |= titles
+
+        self._size += len(result)
+        if self._size > self.max_size:
+            raise ExpansionError(
+                "expansion exceeds the size limit of {} characters".format(
+                    self.max_size
+                )
+            )
+        return result
+
+    def _reusable(self, cached, depth):
+        """Return whether a memoized expansion is valid at this depth.
+
+        It must not reach past the depth limit from here, nor use any of the
+        templates we are currently expanding.
+        """
+        _, span, titles = cached
+        return depth + span < self.max_depth and titles.isdisjoint(self._stack)
+
+    def _expand_body(self, key, body, params, depth):
+        """Expand a template's body, memoizing the result if possible.
+
+        Return a tuple of the result, how many levels deeper than *depth* it
+        expanded templates, and the set of templates it used.
+        """
+        title = key[0]
+        limited, deepest, titles = self._limited, self._deepest, self._titles
+        self._deepest, self._titles = depth, {title}
+        self._stack.append(title)
+        try:
+            result = self._render(body, params, depth + 1)
+            expanded = (result, self._deepest - depth, frozenset(self._titles))
+        finally:
+            self._stack.pop()
+            self._deepest, self._titles = deepest, titles
+        # A result that hit a limit depends on where we expanded it from:
+        if self._limited == limited:
+            self._results[key] = expanded
+        return expanded
+
+    def expand(self, code):
+        """Return a new :class:`.Wikicode` with the templates in *code* expanded.
+
+        *code* may be anything accepted by :func:`.parse_anything`. It is not
+        modified. Arguments outside of templates are replaced with their
+        defaults, if they have any.
+        """
+        code = parse_anything(code)
+        self._size = self._deepest = 0
+        self._titles = set()
+        return self._parser.parse(self._render(code, {}, 0))
+
+
+def expand(code, source_provider, max_depth=40, max_size=2 * 1024 * 1024):
+    """Return a new :class:`.Wikicode` with the templates in *code* expanded.
+
+    This is a shortcut for creating an :class:`Expander` and calling its
+    :meth:`~Expander.expand` method; see its documentation for details. Reuse
+    an :class:`Expander` when expanding several pages to keep its caches.
+    """
+    return Expander(source_provider, max_depth, max_size).expand(code)
@@ -0,0 +1,311 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Contains functions for exporting :class:`.Wikicode` trees as JSON, used by
+:meth:`.Wikicode.to_json` and :meth:`.Wikicode.to_jsonable`.
+
+The output is an object with a schema ``version`` (currently 1) and a list of
+``nodes``. Each node is an object with a ``type`` and the same fields as the
+corresponding :class:`.Node` class, where every :class:`.Wikicode` field is a
+list of nodes, or ``null`` if it is ``None``:
+
+========================  ===================================================
+Type                      Fields
+========================  ===================================================
+``text``                  ``value``
+``template``              ``name``, ``params``
+``argument``              ``name``, ``default``
+``wikilink``              ``title``, ``text``
+``extlink``               ``url``, ``title``, ``brackets``, ``suppress_space``
+``heading``               ``title``, ``level``
+``comment``               ``contents``
+``entity``                ``value``, ``named``, ``hexadecimal``, ``hex_char``
+``tag``                   ``tag``, ``wiki_markup``, ``attributes``,
+                          ``contents``, ``self_closing``, ``invalid``,
+                          ``implicit``, ``padding``, ``closing_tag``,
+                          ``wiki_style_separator``, ``closing_wiki_markup``
+========================  ===================================================
+
+Parameters are objects with ``name``, ``value``, and ``showkey`` fields, and
+attributes have ``name``, ``value``, ``quotes``, ``pad_first``,
+``pad_before_eq``, and ``pad_after_eq``. A tag's ``contents`` is ``null`` if
+it is self-closing, and its ``closing_tag`` is ``null`` unless it appears in
+the text. Nodes of other types are exported as ``{"type": "unknown", "text":
+...}``.
+
+If *spans* is ``True``, nodes, parameters, and attributes also get a ``span``
+field with the ``[start, end]`` offsets of their text in the tree's string.
+Hidden parameter names have no spans, since they don't appear in the text.
+
+The export walks the tree's Python objects, so it isn't free next to parsing:
+on the pages generated by ``scripts/costbench.py``, it takes about 15% as long
+as parsing them with the C tokenizer, and about 25% with spans. Pages made of
+many small nodes cost relatively more, up to half of the parse time with spans.
+"""
+
+import json
+
+from .nodes import (
+    Argument,
+    Comment,
+    ExternalLink,
+    Heading,
+    HTMLEntity,
+    Tag,
+    Template,
+    Text,
+    Wikilink,
+)
+from .utils import iter_layout
+from .wikicode import Wikicode
+
+__all__ = ["SCHEMA_VERSION", "to_json", "to_jsonable"]
+
+SCHEMA_VERSION = 1
+
+# How much output to buffer before writing it to a file:
+_BUFFER_SIZE = 64 * 1024
+
+_encode = json.JSONEncoder(ensure_ascii=False, separators=(",", ":")).encode
+
+
+class _Converter:
+    """Converts nodes to JSON-compatible objects, keeping track of offsets.
+
+    Offsets come from :func:`.utils.iter_layout`: each node's layout is walked
+    in the order of its text, converting the children that appear in it, and
+    the node's fields are then filled in from those conversions. Children that
+    aren't part of the text, like hidden parameter names, are converted
+    without spans, and without walking layouts at all when spans are off.
+    """
+
+    def __init__(self, spans):
+        self.spans = spans
+        self.pos = 0
+        self._converted = {}  # id of visible Wikicode -> its nodes, in text order
+        self._extra_spans = {}  # id of Parameter/Attribute -> its span
+        self._methods = {
+            Template: self._template,
+            Argument: self._argument,
+            Wikilink: self._wikilink,
+            ExternalLink: self._extlink,
+            Heading: self._heading,
+            Comment: self._comment,
+            HTMLEntity: self._entity,
+            Tag: self._tag,
+        }
+
+    def code(self, code):
+        """Convert a :class:`.Wikicode` object (or ``None``)."""
+        if code is None:
+            return None
+        return [self.node(node) for node in code.nodes]
+
+    def hidden(self, code):
+        """Convert a :class:`.Wikicode` object that isn't part of the text."""
+        if code is None:
+            return None
+        pos, spans = self.pos, self.spans
+        self.spans = False
+        try:
+            return self.code(code)
+        finally:
+            self.pos, self.spans = pos, spans
+
+    def node(self, node):
+        """Convert a :class:`.Node`."""
+        start = self.pos
+        if type(node) is Text:  # pylint: disable=unidiomatic-typecheck
+            self.pos += len(node.value)
+            data = {"type": "text", "value": node.value}
+        else:
+            if self.spans:
+                self._walk(iter_layout(node, extras=True))
+            method = self._methods.get(type(node))
+            if method:
+                data = method(node)
+            else:
+                data = {"type": "unknown", "text": str(node)}
+        if self.spans:
+            data["span"] = [start, self.pos]
+        return data
+
+    def _walk(self, parts):
+        """Convert the children in a layout, in the order of the text."""
+        for part in parts:
+            if isinstance(part, int):
+                self.pos += part
+            elif isinstance(part, Wikicode):
+                # A tag's name and closing tag can be the same object:
+                self._converted.setdefault(id(part), []).append(self.code(part))
+            else:
+                start = self.pos
+                self._walk(iter_layout(part))
+                self._extra_spans[id(part)] = [start, self.pos]
+
+    def _field(self, code):
+        """Return the conversion of a child, converting it if it's hidden."""
+        if code is None:
+            return None
+        if not self.spans:
+            return self.code(code)
+        converted = self._converted.get(id(code))
+        if not converted:
+            return self.hidden(code)
+        data = converted.pop(0)
+        if not converted:
+            del self._converted[id(code)]
+        return data
+
+    def _with_span(self, data, extra):
+        """Add the span of a :class:`.Parameter` or :class:`.Attribute`."""
+        span = self._extra_spans.pop(id(extra), None)
+        if self.spans and span is not None:
+            data["span"] = span
+        return data
+
+    def _param(self, param):
+        data = {
+            "name": self._field(param.name),
+            "value": self._field(param.value),
+            "showkey": param.showkey,
+        }
+        return self._with_span(data, param)
+
+    def _template(self, node):
+        return {
+            "type": "template",
+            "name": self._field(node.name),
+            "params": [self._param(param) for param in node.params],
+        }
+
+    def _argument(self, node):
+        return {
+            "type": "argument",
+            "name": self._field(node.name),
+            "default": self._field(node.default),
+        }
+
+    def _wikilink(self, node):
+        return {
+            "type": "wikilink",
+            "title": self._field(node.title),
+            "text": self._field(node.text),
+        }
+
+    def _extlink(self, node):
+        return {
+            "type": "extlink",
+            "url": self._field(node.url),
+            "title": self._field(node.title),
+            "brackets": node.brackets,
+            "suppress_space": node.suppress_space,
+        }
+
+    def _heading(self, node):
+        return {
+            "type": "heading",
+            "title": self._field(node.title),
+            "level": node.level,
+        }
+
+    @staticmethod
+    def _comment(node):
+        return {"type": "comment", "contents": node.contents}
+
+    @staticmethod
+    def _entity(node):
+        return {
+            "type": "entity",
+            "value": node.value,
+            "named": node.named,
+            "hexadecimal": node.hexadecimal,
+            "hex_char": node.hex_char,
+        }
+
+    def _attribute(self, attr):
+        data = {
+            "name": self._field(attr.name),
+            "value": self._field(attr.value),
+            "quotes": attr.quotes,
+            "pad_first": attr.pad_first,
+            "pad_before_eq": attr.pad_before_eq,
+            "pad_after_eq": attr.pad_after_eq,
+        }
+        return self._with_span(data, attr)
+
+    def _tag(self, node):
+        tag = self._field(node.tag)
+        attrs = [self._attribute(attr) for attr in node.attributes]
+        contents = None if node.self_closing else self._field(node.contents)
+        closing = None
+        if not node.wiki_markup and not node.self_closing:
+            closing = self._field(node.closing_tag)
+        return {
+            "type": "tag",
+            "tag": tag,
+            "wiki_markup": node.wiki_markup,
+            "attributes": attrs,
+            "contents": contents,
+            "self_closing": node.self_closing,
+            "invalid": node.invalid,
+            "implicit": node.implicit,
+            "padding": node.padding,
+            "closing_tag": closing,
+            "wiki_style_separator": node.wiki_style_separator,
+            "closing_wiki_markup": node.closing_wiki_markup,
+        }
+
+
+def to_jsonable(code, spans=False):
+    """Return a JSON-compatible object representing a :class:`.Wikicode`.
+
+    The result is made of dicts, lists, strings, integers, booleans, and
+    ``None``, following the schema described in the module documentation.
+    """
+    return {"version": SCHEMA_VERSION, "nodes": _Converter(spans).code(code)}
+
+
+def to_json(code, fp=None, spans=False):
+    """Export a :class:`.Wikicode` as JSON text.
+
+    If *fp* is ``None``, return the JSON as a string. Otherwise, write it to
+    *fp*, a file-like object opened in text mode, and return ``None``. Output
+    is streamed to *fp* one top-level node at a time through a buffer, so
+    exporting a huge page doesn't need memory for all of its JSON at once.
+    """
+    if fp is None:
+        return _encode(to_jsonable(code, spans))
+
+    converter = _Converter(spans)
+    buffer = ['{"version":' + str(SCHEMA_VERSION) + ',"nodes":[']
+    size = 0
+    for i, node in enumerate(code.nodes):
+        chunk = _encode(converter.node(node))
+        buffer.append("," + chunk if i else chunk)
+        size += len(chunk)
+        if size >= _BUFFER_SIZE:
+            fp.write("".join(buffer))
+            buffer = []
+            size = 0
+    buffer.append("]}")
+    fp.write("".join(buffer))
+    return None
@@ -0,0 +1,132 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Contains a function for measuring how much memory a parsed tree uses, used by
+:meth:`.Wikicode.memory_report`.
+
+Sizes come from :func:`sys.getsizeof`, so they include the overhead of each
+Python object but not the memory allocator's own bookkeeping. Each object is
+counted once, even if it is reachable from several places in the tree.
+
+The C tokenizer can also report how much memory it used internally while
+building the tokens for a tree; see :meth:`.Parser.tokenizer_memory`.
+"""
+
+import sys
+
+from .smart_list import SmartList
+from .smart_list.list_proxy import ListProxy
+from .string_mixin import StringMixIn
+from .utils import TrackedList
+
+__all__ = ["memory_report"]
+
+# Objects that get their own entry in the report, by type name:
+_OWNERS = (StringMixIn, SmartList, ListProxy)
+
+# Builtin containers whose contents are followed, counted as part of the
+# object that refers to them:
+_CONTAINERS = (list, TrackedList, tuple, dict, set, frozenset)
+
+# Immutable objects that are shared by the whole interpreter, so not counted:
+_SHARED = (int, float, bool, type(None))
+
+
+def _payload(string):
+    """Return the number of bytes used by a string's characters."""
+    if not string:
+        return 0
+    top = ord(max(string))
+    return len(string) * (1 if top < 0x100 else 2 if top < 0x10000 else 4)
+
+
+def memory_report(code):
+    """Return how much memory a :class:`.Wikicode` object and its children use.
+
+    The result is a dict with these keys:
+
+    - ``"types"``: a dict mapping type names, like ``"Template"``,
+      ``"Wikicode"``, ``"SmartList"``, or ``"ListProxy"``, to dicts with the
+      ``"count"`` of objects of that type and their ``"bytes"``. The bytes of
+      an object include its attribute dict and any lists, tuples, and dicts it
+      owns, like a template's list of parameters, but not strings or other
+      nodes.
+    - ``"strings"``: a dict with the number of distinct string objects
+      (``"count"``) and of ``"references"`` to them, how many of them are
+      ``"shared"`` by more than one place in the tree (like strings interned by
+      the tokenizer) or ``"unique"`` to one place, and their ``"bytes"``, split
+      into the ``"payload_bytes"`` used by their characters and the
+      ``"overhead_bytes"`` of the objects.
+    - ``"total"``: a dict with the ``"count"`` and ``"bytes"`` of all objects.
+    """
+    types = {}
+    strings = {}  # id -> [string, number of references]
+    seen = set()
+    stack = [(code, None)]
+    while stack:
+        obj, owner = stack.pop()
+        if isinstance(obj, str):
+            strings.setdefault(id(obj), [obj, 0])[1] += 1
+            continue
+        kind = type(obj)
+        if kind in _SHARED or id(obj) in seen:
+            continue
+        seen.add(id(obj))
+
+        if issubclass(kind, _OWNERS):
+            owner = types.setdefault(kind.__name__, {"count": 0, "bytes": 0})
+            owner["count"] += 1
+            owner["bytes"] += sys.getsizeof(obj)
+            attrs = getattr(obj, "__dict__", None)
+            if attrs is not None:
+                owner["bytes"] += sys.getsizeof(attrs)
+                stack.extend((value, owner) for value in attrs.values())
+            if isinstance(obj, SmartList):
+                stack.extend((item, owner) for item in list.__iter__(obj))
+            continue
+
+        if owner is not None:
+            owner["bytes"] += sys.getsizeof(obj)
+        if kind is dict:
+            stack.extend((item, owner) for pair in obj.items() for item in pair)
+        elif kind in _CONTAINERS:
+            stack.extend((item, owner) for item in obj)
+
+    shared = sum(1 for _, refs in strings.values() if refs > 1)
+    size = sum(sys.getsizeof(string) for string, _ in strings.values())
+    payload = sum(_payload(string) for string, _ in strings.values())
+    objects = sum(entry["count"] for entry in types.values())
+    return {
+        "types": types,
+        "strings": {
+            "count": len(strings),
+            "references": sum(refs for _, refs in strings.values()),
+            "shared": shared,
+            "unique": len(strings) - shared,
+            "bytes": size,
+            "payload_bytes": payload,
+            "overhead_bytes": size - payload,
+        },
+        "total": {
+            "count": objects + len(strings),
+            "bytes": size + sum(entry["bytes"] for entry in types.values()),
+        },
+    }
@@ -20,7 +20,7 @@
 
 
 from ._base import Node
-from ..utils import parse_anything
+from ..utils import mark_changed, parse_anything
 
 __all__ = ["Argument"]
 
@@ -76,10 +76,12 @@ class Argument(Node):
 
     @name.setter
     def name(self, value):
+        mark_changed()
         self._name = parse_anything(value)
 
     @default.setter
     def default(self, default):
+        mark_changed()
         if default is None:
             self._default = None
         else:
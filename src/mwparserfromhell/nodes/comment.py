@@ -20,6 +20,7 @@
 
 
 from ._base import Node
+from ..utils import mark_changed
 
 __all__ = ["Comment"]
 
@@ -41,4 +42,5 @@ class Comment(Node):
 
     @contents.setter
     def contents(self, value):
+        mark_changed()
         self._contents = str(value)
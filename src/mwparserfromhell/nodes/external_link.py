@@ -20,7 +20,7 @@
 
 
 from ._base import Node
-from ..utils import parse_anything
+from ..utils import mark_changed, parse_anything
 
 __all__ = ["ExternalLink"]
 
@@ -82,6 +82,7 @@ class ExternalLink(Node):
 
     @url.setter
     def url(self, value):
+        mark_changed()
         # pylint: disable=import-outside-toplevel
         from ..parser import contexts
 
@@ -89,8 +90,10 @@ class ExternalLink(Node):
 
     @title.setter
     def title(self, value):
+        mark_changed()
         self._title = None if value is None else parse_anything(value)
 
     @brackets.setter
     def brackets(self, value):
+        mark_changed()
         self._brackets = bool(value)
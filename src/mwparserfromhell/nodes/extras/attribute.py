@@ -20,7 +20,7 @@
 
 
 from ...string_mixin import StringMixIn
-from ...utils import parse_anything
+from ...utils import mark_changed, parse_anything
 
 __all__ = ["Attribute"]
 
@@ -124,10 +124,12 @@ class Attribute(StringMixIn):
 
     @name.setter
     def name(self, value):
+        mark_changed()
         self._name = parse_anything(value)
 
     @value.setter
     def value(self, newval):
+        mark_changed()
         if newval is None:
             self._value = None
         else:
@@ -139,6 +141,7 @@ class Attribute(StringMixIn):
 
     @quotes.setter
     def quotes(self, value):
+        mark_changed()
         value = self.coerce_quotes(value)
         if not value and self._value_needs_quotes(self.value):
             raise ValueError("attribute value requires quotes")
@@ -146,12 +149,15 @@ class Attribute(StringMixIn):
 
     @pad_first.setter
     def pad_first(self, value):
+        mark_changed()
         self._set_padding("_pad_first", value)
 
     @pad_before_eq.setter
     def pad_before_eq(self, value):
+        mark_changed()
         self._set_padding("_pad_before_eq", value)
 
     @pad_after_eq.setter
     def pad_after_eq(self, value):
+        mark_changed()
         self._set_padding("_pad_after_eq", value)
@@ -21,7 +21,7 @@
 import re
 
 from ...string_mixin import StringMixIn
-from ...utils import parse_anything
+from ...utils import mark_changed, parse_anything
 
 __all__ = ["Parameter"]
 
@@ -68,14 +68,17 @@ class Parameter(StringMixIn):
 
     @name.setter
     def name(self, newval):
+        mark_changed()
         self._name = parse_anything(newval)
 
     @value.setter
     def value(self, newval):
+        mark_changed()
         self._value = parse_anything(newval)
 
     @showkey.setter
     def showkey(self, newval):
+        mark_changed()
         newval = bool(newval)
         if not newval and not self.can_hide_key(self.name):
             raise ValueError("parameter key {!r} cannot be hidden".format(self.name))
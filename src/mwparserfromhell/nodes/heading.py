@@ -20,7 +20,7 @@
 
 
 from ._base import Node
-from ..utils import parse_anything
+from ..utils import mark_changed, parse_anything
 
 __all__ = ["Heading"]
 
@@ -59,10 +59,12 @@ class Heading(Node):
 
     @title.setter
     def title(self, value):
+        mark_changed()
         self._title = parse_anything(value)
 
     @level.setter
     def level(self, value):
+        mark_changed()
         value = int(value)
         if value < 1 or value > 6:
             raise ValueError(value)
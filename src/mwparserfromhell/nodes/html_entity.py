@@ -18,9 +18,8 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
-import html.entities as htmlentities
-
 from ._base import Node
+from ..utils import mark_changed
 
 __all__ = ["HTMLEntity"]
 
@@ -93,6 +92,7 @@ class HTMLEntity(Node):
 
     @value.setter
     def value(self, newval):
+        mark_changed()
         newval = str(newval)
         try:
             int(newval)
@@ -100,7 +100,9 @@ class HTMLEntity(Node):
             try:
                 intval = int(newval, 16)
             except ValueError:
-                if newval not in htmlentities.entitydefs:
+                from html.entities import entitydefs
+
+                if newval not in entitydefs:
                     raise ValueError(
                         "entity value {!r} is not a valid name".format(newval)
                     ) from None
@@ -124,8 +126,11 @@ class HTMLEntity(Node):
 
     @named.setter
     def named(self, newval):
+        mark_changed()
         newval = bool(newval)
-        if newval and self.value not in htmlentities.entitydefs:
+        from html.entities import entitydefs
+
+        if newval and self.value not in entitydefs:
             raise ValueError("entity value {!r} is not a valid name".format(self.value))
         if not newval:
             try:
@@ -139,6 +144,7 @@ class HTMLEntity(Node):
 
     @hexadecimal.setter
     def hexadecimal(self, newval):
+        mark_changed()
         newval = bool(newval)
         if newval and self.named:
             raise ValueError("a named entity cannot be hexadecimal")
@@ -146,6 +152,7 @@ class HTMLEntity(Node):
 
     @hex_char.setter
     def hex_char(self, newval):
+        mark_changed()
         newval = str(newval)
         if newval not in ("x", "X"):
             raise ValueError(newval)
@@ -154,7 +161,9 @@ class HTMLEntity(Node):
     def normalize(self):
         """Return the unicode character represented by the HTML entity."""
         if self.named:
-            return chr(htmlentities.name2codepoint[self.value])
+            from html.entities import name2codepoint
+
+            return chr(name2codepoint[self.value])
         if self.hexadecimal:
             return chr(int(self.value, 16))
         return chr(int(self.value))
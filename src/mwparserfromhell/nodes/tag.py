@@ -22,7 +22,7 @@
 from ._base import Node
 from .extras import Attribute
 from ..definitions import is_visible
-from ..utils import parse_anything
+from ..utils import TrackedList, mark_changed, parse_anything
 
 __all__ = ["Tag"]
 
@@ -47,7 +47,7 @@ class Tag(Node):
         super().__init__()
         self.tag = tag
         self.contents = contents
-        self._attrs = attrs if attrs else []
+        self._attrs = attrs if attrs else TrackedList()
         self._closing_wiki_markup = None
         self.wiki_markup = wiki_markup
         self.self_closing = self_closing
@@ -217,32 +217,39 @@ class Tag(Node):
 
     @tag.setter
     def tag(self, value):
+        mark_changed()
         self._tag = self._closing_tag = parse_anything(value)
 
     @contents.setter
     def contents(self, value):
+        mark_changed()
         self._contents = parse_anything(value)
 
     @wiki_markup.setter
     def wiki_markup(self, value):
+        mark_changed()
         self._wiki_markup = str(value) if value else None
         if not value or not self.closing_wiki_markup:
             self._closing_wiki_markup = self._wiki_markup
 
     @self_closing.setter
     def self_closing(self, value):
+        mark_changed()
         self._self_closing = bool(value)
 
     @invalid.setter
     def invalid(self, value):
+        mark_changed()
         self._invalid = bool(value)
 
     @implicit.setter
     def implicit(self, value):
+        mark_changed()
         self._implicit = bool(value)
 
     @padding.setter
     def padding(self, value):
+        mark_changed()
         if not value:
             self._padding = ""
         else:
@@ -253,14 +260,17 @@ class Tag(Node):
 
     @closing_tag.setter
     def closing_tag(self, value):
+        mark_changed()
         self._closing_tag = parse_anything(value)
 
     @wiki_style_separator.setter
     def wiki_style_separator(self, value):
+        mark_changed()
         self._wiki_style_separator = str(value) if value else None
 
     @closing_wiki_markup.setter
     def closing_wiki_markup(self, value):
+        mark_changed()
         self._closing_wiki_markup = str(value) if value else None
 
     def has(self, name):
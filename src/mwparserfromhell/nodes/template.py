@@ -25,7 +25,7 @@ from ._base import Node
 from .html_entity import HTMLEntity
 from .text import Text
 from .extras import Parameter
-from ..utils import parse_anything
+from ..utils import TrackedList, mark_changed, parse_anything
 
 __all__ = ["Template"]
 
@@ -43,7 +43,7 @@ class Template(Node):
         if params:
             self._params = params
         else:
-            self._params = []
+            self._params = TrackedList()
 
     def __str__(self):
         if self.params:
@@ -195,6 +195,7 @@ class Template(Node):
 
     @name.setter
     def name(self, value):
+        mark_changed()
         self._name = parse_anything(value)
 
     def has(self, name, ignore_empty=False):
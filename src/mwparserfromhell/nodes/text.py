@@ -20,6 +20,7 @@
 
 
 from ._base import Node
+from ..utils import mark_changed
 
 __all__ = ["Text"]
 
@@ -47,4 +48,5 @@ class Text(Node):
 
     @value.setter
     def value(self, newval):
+        mark_changed()
         self._value = str(newval)
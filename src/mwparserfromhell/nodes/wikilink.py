@@ -20,7 +20,7 @@
 
 
 from ._base import Node
-from ..utils import parse_anything
+from ..utils import mark_changed, parse_anything
 
 __all__ = ["Wikilink"]
 
@@ -69,10 +69,12 @@ class Wikilink(Node):
 
     @title.setter
     def title(self, value):
+        mark_changed()
         self._title = parse_anything(value)
 
     @text.setter
     def text(self, value):
+        mark_changed()
         if value is None:
             self._text = None
         else:
@@ -26,6 +26,7 @@ together into one interface.
 
 from .builder import Builder
 from .errors import ParserError
+from .timings import ParseTimings, get_timings_hook, set_timings_hook, timed_parse
 
 try:
     from ._tokenizer import CTokenizer
@@ -37,7 +38,14 @@ except ImportError:
     CTokenizer = None
     use_c = False
 
-__all__ = ["use_c", "Parser", "ParserError"]
+__all__ = [
+    "use_c",
+    "Parser",
+    "ParserError",
+    "ParseTimings",
+    "get_timings_hook",
+    "set_timings_hook",
+]
 
 
 class Parser:
@@ -54,18 +62,36 @@ class Parser:
     general, there is no need to do this because parsing should be done through
     :func:`mwparserfromhell.parse`, which creates a new :class:`.Parser` object
     as necessary.
+
+    Short strings in the tree, like tag names and template names, are shared
+    between identical occurrences within a page. If *keep_interned* is
+    ``True``, they are also shared between every page parsed by this parser,
+    which saves memory when keeping many trees around.
+
+    :attr:`last_timings` holds the :class:`.ParseTimings` of the last call to
+    :meth:`parse` that was timed, or ``None``.
     """
 
-    def __init__(self):
+    def __init__(self, keep_interned=False):
         if use_c and CTokenizer:
-            self._tokenizer = CTokenizer()
+            self._tokenizer = CTokenizer(keep_interned=keep_interned)
         else:
             from .tokenizer import Tokenizer
 
-            self._tokenizer = Tokenizer()
+            self._tokenizer = Tokenizer(keep_interned=keep_interned)
         self._builder = Builder()
-
-    def parse(self, text, context=0, skip_style_tags=False):
+        self.last_timings = None
+
+    def parse(
+        self,
+        text,
+        context=0,
+        skip_style_tags=False,
+        drop_comments=False,
+        view=None,
+        timings=False,
+        max_parse_depth=None,
+    ):
         """Parse *text*, returning a :class:`.Wikicode` object tree.
 
         If given, *context* will be passed as a starting context to the parser.
@@ -78,9 +104,87 @@ class Parser:
         If *skip_style_tags* is ``True``, then ``''`` and ``'''`` will not be
         parsed, but instead will be treated as plain text.
 
+        If *drop_comments* is ``True``, then HTML comments will be left out of
+        the tree entirely, as if they had been removed after parsing. This is
+        faster than parsing them and removing each :class:`.Comment` node.
+
+        If *view* is ``"page"``, then ``<includeonly>`` sections will be left
+        out, as when viewing the page directly. If it is ``"transcluded"``,
+        then ``<noinclude>`` sections will be left out, and if there are any
+        ``<onlyinclude>`` sections, only they will be kept, as when
+        transcluding the page as a template. Either way, the tags themselves
+        are removed before tokenizing, so the skipped text costs almost
+        nothing to parse.
+
+        If *max_parse_depth* is given, templates, arguments, and wikilinks
+        nested more deeply than that are kept as plain text instead of being
+        parsed. For example, with ``max_parse_depth=1``, the templates at the
+        top level are split into parameters, but a template in one of their
+        values is just text. Nested constructs are still matched for their
+        closing delimiters, so they don't break the ones around them, unlike
+        when the parser gives up on text that is nested too deeply. This makes
+        parsing much faster when only the outer structure is needed.
+
+        If *timings* is ``True``, or a hook was installed with
+        :func:`.set_timings_hook`, the time spent tokenizing and building the
+        tree is measured and stored in :attr:`last_timings` as a
+        :class:`.ParseTimings` object.
+
         If there is an internal error while parsing, :exc:`.ParserError` will
         be raised.
         """
-        tokens = self._tokenizer.tokenize(text, context, skip_style_tags)
+        if timings or get_timings_hook():
+            code, self.last_timings = timed_parse(
+                self._tokenizer,
+                self._builder,
+                text,
+                context,
+                skip_style_tags,
+                drop_comments,
+                view,
+                max_parse_depth,
+            )
+            return code
+        tokens = self._tokenizer.tokenize(
+            text, context, skip_style_tags, drop_comments, view, max_parse_depth
+        )
         code = self._builder.build(tokens)
         return code
+
+    def tokenizer_memory(self):
+        """Return the peak memory used inside the tokenizer by the last parse.
+
+        The result is a dict mapping ``"stacks"`` (token stacks),
+        ``"textbuffers"``, ``"routes"`` (the memo of failed routes), and
+        ``"total"`` to numbers of bytes, not counting the tokens themselves.
+        Only the C tokenizer tracks this, so the result is ``None`` when using
+        the Python tokenizer.
+        """
+        if CTokenizer and isinstance(self._tokenizer, CTokenizer):
+            return self._tokenizer.memory_stats()
+        return None
+
+    def parse_revision(self, prev_text, prev_tree, new_text, skip_style_tags=False):
+        """Parse *new_text*, a new revision of *prev_text*, incrementally.
+
+        *prev_tree* should be the tree previously returned by this method for
+        *prev_text*. Only the region of *new_text* around the edit is
+        retokenized and rebuilt; the top-level nodes of *prev_tree* before and
+        after it are reused in the new tree, so *prev_tree* must not have been
+        modified, and modifying either tree afterwards may affect the other.
+        The result is always the same as :meth:`parse` would give, and can be
+        passed back as *prev_tree* when parsing the next revision.
+
+        If *prev_tree* is ``None`` or was not produced by this method (or was
+        produced from different text or options), *new_text* is parsed in full.
+        """
+        from .revision import parse_revision
+
+        return parse_revision(
+            self._tokenizer,
+            self._builder,
+            prev_text,
+            prev_tree,
+            new_text,
+            skip_style_tags,
+        )
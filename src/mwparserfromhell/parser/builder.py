@@ -34,6 +34,7 @@ from ..nodes import (
 )
 from ..nodes.extras import Attribute, Parameter
 from ..smart_list import SmartList
+from ..utils import TrackedList
 from ..wikicode import Wikicode
 
 __all__ = ["Builder"]
@@ -109,7 +110,7 @@ class Builder:
     @_add_handler(tokens.TemplateOpen)
     def _handle_template(self, token):
         """Handle a case where a template is at the head of the tokens."""
-        params = []
+        params = TrackedList()
         default = 1
         self._push()
         while self._tokens:
@@ -271,7 +272,7 @@ class Builder:
     def _handle_tag(self, token):
         """Handle a case where a tag is at the head of the tokens."""
         close_tokens = (tokens.TagCloseSelfclose, tokens.TagCloseClose)
-        implicit, attrs, contents, closing_tag = False, [], None, None
+        implicit, attrs, contents, closing_tag = False, TrackedList(), None, None
         wiki_markup, invalid = token.wiki_markup, token.invalid or False
         wiki_style_separator, closing_wiki_markup = None, wiki_markup
         self._push()
@@ -38,9 +38,80 @@ SOFTWARE.
 #    define uint64_t unsigned PY_LONG_LONG
 #endif
 
-#define malloc  PyObject_Malloc // XXX: yuck
-#define realloc PyObject_Realloc
-#define free    PyObject_Free
+#if PY_VERSION_HEX < 0x03070000
+#    define PyTraceMalloc_Track   _PyTraceMalloc_Track
+#    define PyTraceMalloc_Untrack _PyTraceMalloc_Untrack
+#endif
+
+/* Memory allocation
+
+   The tokenizer's own structures are allocated with the system allocator and
+   reported to tracemalloc in a separate domain, so they can be told apart from
+   Python objects with tracemalloc.DomainFilter(True, TRACEMALLOC_DOMAIN). */
+
+#define TRACEMALLOC_DOMAIN 0x6d77706e /* "mwpn" */
+
+static inline void *
+tokenizer_malloc(size_t size)
+{
+    void *ptr = malloc(size);
+
+    if (ptr) {
+        PyTraceMalloc_Track(TRACEMALLOC_DOMAIN, (uintptr_t) ptr, size);
+    }
+    return ptr;
+}
+
+static inline void *
+tokenizer_calloc(size_t count, size_t size)
+{
+    void *ptr = calloc(count, size);
+
+    if (ptr) {
+        PyTraceMalloc_Track(TRACEMALLOC_DOMAIN, (uintptr_t) ptr, count * size);
+    }
+    return ptr;
+}
+
+/* The old block is untracked only once realloc() has succeeded, since it is
+   still ours (and still tracked with its size) if realloc() fails. GCC 12
+   takes the saved address for a use of the freed pointer, so its
+   -Wuse-after-free warning is silenced here. */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wuse-after-free"
+#endif
+static inline void *
+tokenizer_realloc(void *ptr, size_t size)
+{
+    uintptr_t old = (uintptr_t) ptr;
+    void *new = realloc(ptr, size);
+
+    if (new) {
+        if (old) {
+            PyTraceMalloc_Untrack(TRACEMALLOC_DOMAIN, old);
+        }
+        PyTraceMalloc_Track(TRACEMALLOC_DOMAIN, (uintptr_t) new, size);
+    }
+    return new;
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#    pragma GCC diagnostic pop
+#endif
+
+static inline void
+tokenizer_free(void *ptr)
+{
+    if (ptr) {
+        PyTraceMalloc_Untrack(TRACEMALLOC_DOMAIN, (uintptr_t) ptr);
+    }
+    free(ptr);
+}
+
+#define malloc  tokenizer_malloc
+#define calloc  tokenizer_calloc
+#define realloc tokenizer_realloc
+#define free    tokenizer_free
 
 /* Unicode support macros */
 
@@ -60,19 +131,46 @@ SOFTWARE.
 
 /* Shared globals */
 
-extern char **entitydefs;
-
 extern PyObject *NOARGS;
-extern PyObject *definitions;
 
 /* Structs */
 
+/* Bytes used by one kind of internal structure, reported by memory_stats() */
+struct MemoryCounter {
+    Py_ssize_t current;           /* bytes in use now */
+    Py_ssize_t peak;              /* most bytes in use at once */
+    struct MemoryCounter *parent; /* counter that this one adds to, or NULL */
+};
+typedef struct MemoryCounter MemoryCounter;
+
+typedef struct {
+    MemoryCounter total;       /* all of the counters below */
+    MemoryCounter stacks;      /* stack frames and their token lists */
+    MemoryCounter textbuffers; /* textbuffers */
+    MemoryCounter routes;      /* nodes of the bad_routes tree */
+} MemoryStats;
+
+/*
+    Add delta bytes to a memory counter and its parents, updating their peaks.
+*/
+static inline void
+memory_add(MemoryCounter *counter, Py_ssize_t delta)
+{
+    for (; counter; counter = counter->parent) {
+        counter->current += delta;
+        if (counter->current > counter->peak) {
+            counter->peak = counter->current;
+        }
+    }
+}
+
 typedef struct {
     Py_ssize_t capacity;
     Py_ssize_t length;
     PyObject *object;
     int kind;
     void *data;
+    MemoryCounter *memory; /* counter for this buffer's bytes, or NULL */
 } Textbuffer;
 
 typedef struct {
@@ -86,6 +184,7 @@ struct Stack {
     Textbuffer *textbuffer;
     StackIdent ident;
     struct Stack *next;
+    Py_ssize_t memory; /* bytes counted for this stack in memory.stacks */
 };
 typedef struct Stack Stack;
 
@@ -110,8 +209,21 @@ typedef struct {
     Py_ssize_t head;        /* current position in text */
     int global;             /* global context */
     int depth;              /* stack recursion depth */
+    int construct_depth;    /* number of templates, etc. being parsed */
     int route_state;        /* whether a BadRoute has been triggered */
     uint64_t route_context; /* context when the last BadRoute was triggered */
     avl_tree *bad_routes;   /* stack idents for routes known to fail */
+    Py_ssize_t route_max;   /* furthest head of a route known to fail */
     int skip_style_tags;    /* temp fix for the sometimes broken tag parser */
+    int drop_comments;      /* whether to leave comments out of the tokens */
+    Py_ssize_t max_read;    /* furthest position read from the text */
+    Py_ssize_t start;       /* position tokenizing started at */
+    PyObject *checkpoints;  /* list of line starts in the root stack, or NULL */
+    PyObject *stops;        /* list of checkpoints to stop at, or NULL */
+    Py_ssize_t next_stop;   /* index of the next stop to check */
+    int stopped;            /* whether we stopped at one of the stops */
+    PyObject *interned;     /* dict of short strings shared between tokens */
+    int keep_interned;      /* whether to keep interned between calls */
+    int max_parse_depth;    /* deepest construct to parse, or -1 */
+    MemoryStats memory;     /* bytes used by the structures above */
 } Tokenizer;
@@ -0,0 +1,329 @@
+/*
+Copyright (C) 2012-2016 Ben Kurtovic <ben.kurtovic@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "cost.h"
+#include "tok_parse.h"
+
+typedef struct {
+    int kind; /* A PyUnicode kind, or 0 for bytes */
+    const void *data;
+    Py_ssize_t length;
+} CostInput;
+
+/* An opener's index, and the number of markers up to and including it */
+typedef struct {
+    Py_ssize_t index;
+    Py_ssize_t markers;
+} Opener;
+
+typedef struct {
+    Opener *items;
+    Py_ssize_t size;
+    Py_ssize_t capacity;
+} OpenerStack;
+
+/* The features counted by scan(), in the order of costs.CostFeatures */
+typedef struct {
+    Py_ssize_t length;
+    Py_ssize_t markers;
+    Py_ssize_t templates;
+    Py_ssize_t links;
+    Py_ssize_t tags;
+    Py_ssize_t apostrophes;
+    Py_ssize_t table_markers;
+    Py_ssize_t unclosed;
+    Py_ssize_t unclosed_span;
+    Py_ssize_t unclosed_tag_span;
+    Py_ssize_t unclosed_markers;
+    int failed;
+} CostFeatures;
+
+/*
+    Return the code point (or byte) at the given index of the input.
+*/
+static inline Py_UCS4
+read_char(const CostInput *input, Py_ssize_t index)
+{
+    if (input->kind == 0) {
+        return ((const unsigned char *) input->data)[index];
+    }
+    return PyUnicode_READ(input->kind, input->data, index);
+}
+
+/*
+    Push the index of an opening "{{" or "[[" run, tag, or table onto a stack.
+*/
+static int
+push_opener(OpenerStack *stack, Py_ssize_t index, Py_ssize_t markers)
+{
+    if (stack->size == stack->capacity) {
+        Py_ssize_t capacity = stack->capacity ? stack->capacity * 2 : 16;
+        Opener *items = realloc(stack->items, capacity * sizeof(Opener));
+
+        if (!items) {
+            return -1;
+        }
+        stack->items = items;
+        stack->capacity = capacity;
+    }
+    stack->items[stack->size].index = index;
+    stack->items[stack->size++].markers = markers;
+    return 0;
+}
+
+/*
+    Close the openers matched by a run of closing delimiters: each pair closes
+    one opening run, like the "}}}}" that ends "{{a|{{b}}}}".
+*/
+static inline void
+pop_openers(OpenerStack *stack, Py_ssize_t run)
+{
+    Py_ssize_t count = run / 2;
+
+    stack->size -= count < stack->size ? count : stack->size;
+}
+
+/*
+    Count the openers left on a stack, which the tokenizer will try to close
+    until the end of the text before giving up on them, adding the number of
+    characters it will read to the given span, and the number of markers to
+    unclosed_markers.
+*/
+static void
+count_unclosed(const OpenerStack *stack,
+               Py_ssize_t length,
+               CostFeatures *features,
+               Py_ssize_t *span)
+{
+    Py_ssize_t i;
+
+    features->unclosed += stack->size;
+    for (i = 0; i < stack->size; i++) {
+        *span += length - stack->items[i].index;
+        features->unclosed_markers += features->markers - stack->items[i].markers;
+    }
+}
+
+/*
+    Return whether the tag name at the given index is one that is usually left
+    unclosed, like "br" or "li", so it shouldn't be counted as an opener.
+*/
+static int
+is_single_name(const CostInput *input, Py_ssize_t index)
+{
+    static const char *names[] = {
+        "br", "wbr", "hr", "meta", "link", "img", "li", "dt", "dd", "th", "td", "tr"};
+    char name[8];
+    Py_ssize_t i, length = 0;
+    Py_UCS4 c;
+
+    while (index + length < input->length) {
+        c = read_char(input, index + length);
+        if (!((c | 0x20) >= 'a' && (c | 0x20) <= 'z')) {
+            break;
+        }
+        if (length == 4) {
+            return 0;
+        }
+        name[length++] = (char) (c | 0x20);
+    }
+    name[length] = '\0';
+    for (i = 0; i < (Py_ssize_t) (sizeof(names) / sizeof(names[0])); i++) {
+        if (!strcmp(name, names[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+    Count the features of the input in a single pass. Runs of the same marker
+    are handled together: "{{" and "[[" runs are matched with "}}" and "]]"
+    runs using stacks, as are tags and tables, and runs of two or more
+    apostrophes are counted once. This doesn't touch any Python objects, so it
+    runs without the GIL.
+*/
+static void
+scan(const CostInput *input, CostFeatures *features)
+{
+    OpenerStack braces = {0}, brackets = {0}, tags = {0}, tables = {0};
+    Py_ssize_t i = 0, run;
+    Py_UCS4 c, next;
+    int line_start = 1, in_tag = 0;
+
+    features->length = input->length;
+    while (i < input->length) {
+        c = read_char(input, i);
+        if (!is_marker(c)) {
+            line_start = 0;
+            i++;
+            continue;
+        }
+        run = 1;
+        while (i + run < input->length && read_char(input, i + run) == c) {
+            run++;
+        }
+        next = i + run < input->length ? read_char(input, i + run) : 0;
+        features->markers += run;
+        switch (c) {
+        case '{':
+            if (run >= 2) {
+                features->templates++;
+                if (push_opener(&braces, i, features->markers)) {
+                    goto fail;
+                }
+            } else if (line_start && next == '|') {
+                features->table_markers++;
+                if (push_opener(&tables, i, features->markers)) {
+                    goto fail;
+                }
+            }
+            break;
+        case '[':
+            if (run >= 2) {
+                features->links++;
+                if (push_opener(&brackets, i, features->markers)) {
+                    goto fail;
+                }
+            }
+            break;
+        case '}':
+            pop_openers(&braces, run);
+            break;
+        case ']':
+            pop_openers(&brackets, run);
+            break;
+        case '\'':
+            if (run >= 2) {
+                features->apostrophes++;
+            }
+            break;
+        case '|':
+            if (line_start && run == 1 && next == '}' && tables.size) {
+                tables.size--;
+            }
+            /* Fall through */
+        case '!':
+            features->table_markers += line_start + (run >= 2);
+            break;
+        case '<':
+            if (run == 1 && next == '/') {
+                if (tags.size) {
+                    tags.size--;
+                }
+                in_tag = 0;
+            } else if (run == 1 && (next | 0x20) >= 'a' && (next | 0x20) <= 'z') {
+                features->tags++;
+                if (!is_single_name(input, i + 1)) {
+                    if (push_opener(&tags, i, features->markers)) {
+                        goto fail;
+                    }
+                    in_tag = 1;
+                }
+            }
+            break;
+        case '/':
+            if (next == '>' && in_tag && tags.size) {
+                tags.size--;
+                in_tag = 0;
+            }
+            break;
+        case '>':
+            in_tag = 0;
+            break;
+        }
+        line_start = c == '\n';
+        i += run;
+    }
+
+    count_unclosed(&braces, input->length, features, &features->unclosed_span);
+    count_unclosed(&brackets, input->length, features, &features->unclosed_span);
+    count_unclosed(&tags, input->length, features, &features->unclosed_tag_span);
+    count_unclosed(&tables, input->length, features, &features->unclosed_tag_span);
+    goto done;
+
+fail:
+    features->failed = 1;
+done:
+    free(braces.items);
+    free(brackets.items);
+    free(tags.items);
+    free(tables.items);
+}
+
+/*
+    Count the features of a str or bytes-like object that make it expensive
+    to tokenize, returning them as a tuple of integers.
+*/
+PyObject *
+cost_scan(PyObject *self, PyObject *args)
+{
+    PyObject *text;
+    Py_buffer buffer = {0};
+    CostInput input;
+    CostFeatures features = {0};
+    int have_buffer = 0;
+
+    if (!PyArg_ParseTuple(args, "O", &text)) {
+        return NULL;
+    }
+    if (PyUnicode_Check(text)) {
+        if (PyUnicode_READY(text) < 0) {
+            return NULL;
+        }
+        input.kind = PyUnicode_KIND(text);
+        input.data = PyUnicode_DATA(text);
+        input.length = PyUnicode_GET_LENGTH(text);
+    } else {
+        if (PyObject_GetBuffer(text, &buffer, PyBUF_SIMPLE)) {
+            return NULL;
+        }
+        have_buffer = 1;
+        input.kind = 0;
+        input.data = buffer.buf;
+        input.length = buffer.len;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    scan(&input, &features);
+    Py_END_ALLOW_THREADS
+
+    if (have_buffer) {
+        PyBuffer_Release(&buffer);
+    }
+    if (features.failed) {
+        return PyErr_NoMemory();
+    }
+    return Py_BuildValue("(nnnnnnnnnnn)",
+                         features.length,
+                         features.markers,
+                         features.templates,
+                         features.links,
+                         features.tags,
+                         features.apostrophes,
+                         features.table_markers,
+                         features.unclosed,
+                         features.unclosed_span,
+                         features.unclosed_tag_span,
+                         features.unclosed_markers);
+}
@@ -28,6 +28,7 @@ SOFTWARE.
 
 /* Functions */
 
+int is_entity(const char *);
 int is_parsable(PyObject *);
 int is_single(PyObject *);
 int is_single_only(PyObject *);
@@ -0,0 +1,372 @@
+/*
+Copyright (C) 2012-2016 Ben Kurtovic <ben.kurtovic@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "microbench.h"
+
+#ifdef MWP_MICROBENCH
+
+#    include "definitions.h"
+#    include "textbuffer.h"
+#    include "tok_parse.h"
+#    include "tok_support.h"
+
+#    define RESET_INTERVAL 4096
+#    define NUM_ROUTES     1024
+
+/* Results are written here so the compiler can't optimize the loops away. */
+static volatile Py_ssize_t sink;
+
+static const char *SAMPLE = "{{cite web|url=http://example.com/|title=Foo ''bar''}} "
+                            "[[Baz|qux]] <ref name=\"a\">x</ref> &amp; == H ==\n";
+
+/*
+    Set up a zeroed tokenizer whose input is the given string, without going
+    through the Python type.
+*/
+static void
+init_tokenizer(Tokenizer *self, PyObject *text)
+{
+    memset(self, 0, sizeof(Tokenizer));
+    self->text.object = text;
+    self->text.kind = PyUnicode_KIND(text);
+    self->text.data = PyUnicode_DATA(text);
+    self->text.length = PyUnicode_GET_LENGTH(text);
+    self->route_max = -1;
+}
+
+/*
+    Write n code points to a textbuffer, resetting it every RESET_INTERVAL.
+*/
+static int
+bench_textbuffer_write(Py_ssize_t n, TokenizerInput *input)
+{
+    Textbuffer *buffer = Textbuffer_new(input, NULL);
+    Py_ssize_t i;
+
+    if (!buffer) {
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        if ((i % RESET_INTERVAL == 0 && Textbuffer_reset(buffer)) ||
+            Textbuffer_write(buffer, 'a' + i % 26)) {
+            Textbuffer_dealloc(buffer);
+            return -1;
+        }
+    }
+    sink = buffer->length;
+    Textbuffer_dealloc(buffer);
+    return 0;
+}
+
+/*
+    Concatenate an eight-character textbuffer onto another n times, resetting
+    the destination every RESET_INTERVAL / 8 times.
+*/
+static int
+bench_textbuffer_concat(Py_ssize_t n, TokenizerInput *input)
+{
+    Textbuffer *src = Textbuffer_new(input, NULL), *dst = Textbuffer_new(input, NULL);
+    Py_ssize_t i;
+    int ok = src && dst;
+
+    for (i = 0; ok && i < 8; i++) {
+        ok = !Textbuffer_write(src, 'a' + i);
+    }
+    for (i = 0; ok && i < n; i++) {
+        ok = !(i % (RESET_INTERVAL / 8) == 0 && Textbuffer_reset(dst)) &&
+             !Textbuffer_concat(dst, src);
+    }
+    if (dst) {
+        sink = dst->length;
+        Textbuffer_dealloc(dst);
+    }
+    if (src) {
+        Textbuffer_dealloc(src);
+    }
+    return ok ? 0 : -1;
+}
+
+/*
+    Render a sixteen-character textbuffer as a string n times.
+*/
+static int
+bench_textbuffer_render(Py_ssize_t n, TokenizerInput *input)
+{
+    Textbuffer *buffer = Textbuffer_new(input, NULL);
+    PyObject *text;
+    Py_ssize_t i;
+
+    if (!buffer) {
+        return -1;
+    }
+    for (i = 0; i < 16; i++) {
+        if (Textbuffer_write(buffer, 'a' + i)) {
+            Textbuffer_dealloc(buffer);
+            return -1;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        if (!(text = Textbuffer_render(buffer))) {
+            Textbuffer_dealloc(buffer);
+            return -1;
+        }
+        Py_DECREF(text);
+    }
+    Textbuffer_dealloc(buffer);
+    return 0;
+}
+
+/*
+    Push an empty token stack and pop it again n times.
+*/
+static int
+bench_push_pop(Py_ssize_t n, TokenizerInput *input)
+{
+    Tokenizer tokenizer, *self = &tokenizer;
+    PyObject *stack;
+    Py_ssize_t i;
+
+    init_tokenizer(self, input->object);
+    for (i = 0; i < n; i++) {
+        self->head = i;
+        if (Tokenizer_push(self, 0)) {
+            return -1;
+        }
+        if (!(stack = Tokenizer_pop(self))) {
+            Tokenizer_delete_top_of_stack(self);
+            return -1;
+        }
+        Py_DECREF(stack);
+    }
+    return 0;
+}
+
+/*
+    Return a scrambled head position for the given route number, so that bad
+    routes aren't inserted in order.
+*/
+static Py_ssize_t
+route_head(Py_ssize_t i)
+{
+    return (Py_ssize_t) (((uint32_t) i * 2654435761u) >> 4);
+}
+
+/*
+    Memoize n bad routes, then free them.
+*/
+static int
+bench_route_insert(Py_ssize_t n, TokenizerInput *input)
+{
+    Tokenizer tokenizer, *self = &tokenizer;
+    Py_ssize_t i;
+
+    init_tokenizer(self, input->object);
+    if (Tokenizer_push(self, 0)) {
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        self->topstack->ident.head = route_head(i);
+        Tokenizer_memoize_bad_route(self);
+    }
+    Tokenizer_delete_top_of_stack(self);
+    Tokenizer_free_bad_route_tree(self);
+    return 0;
+}
+
+/*
+    Memoize NUM_ROUTES bad routes, then check n routes against them, half of
+    which are bad.
+*/
+static int
+bench_route_lookup(Py_ssize_t n, TokenizerInput *input)
+{
+    Tokenizer tokenizer, *self = &tokenizer;
+    Py_ssize_t i, found = 0;
+
+    init_tokenizer(self, input->object);
+    if (Tokenizer_push(self, 0)) {
+        return -1;
+    }
+    for (i = 0; i < NUM_ROUTES; i += 2) {
+        self->topstack->ident.head = route_head(i);
+        Tokenizer_memoize_bad_route(self);
+    }
+    Tokenizer_delete_top_of_stack(self);
+    for (i = 0; i < n; i++) {
+        self->head = route_head(i % NUM_ROUTES);
+        if (Tokenizer_check_route(self, 0) < 0) {
+            found++;
+            RESET_ROUTE();
+        }
+    }
+    sink = found;
+    Tokenizer_free_bad_route_tree(self);
+    return 0;
+}
+
+/*
+    Check whether n characters of sample wikicode are markers.
+*/
+static int
+bench_is_marker(Py_ssize_t n, TokenizerInput *input)
+{
+    Py_ssize_t i, found = 0, length = input->length;
+
+    for (i = 0; i < n; i++) {
+        found += is_marker(PyUnicode_READ(input->kind, input->data, i % length));
+    }
+    sink = found;
+    return 0;
+}
+
+/*
+    Look up n entity names, some of which are invalid.
+*/
+static int
+bench_entity_lookup(Py_ssize_t n, TokenizerInput *input)
+{
+    static const char *names[] = {
+        "amp", "nbsp", "mdash", "hellip", "zwnj", "quot", "eacute", "foobar"};
+    Py_ssize_t i, found = 0;
+
+    for (i = 0; i < n; i++) {
+        found += is_entity(names[i % 8]);
+    }
+    sink = found;
+    return 0;
+}
+
+/*
+    Classify n tag names and URI schemes with the functions in definitions.c.
+*/
+static int
+bench_definitions(Py_ssize_t n, TokenizerInput *input)
+{
+    static const char *names[] = {"ref", "br", "div", "nowiki", "table", "http"};
+    PyObject *objects[6];
+    Py_ssize_t i, found = 0;
+    int j;
+
+    for (j = 0; j < 6; j++) {
+        if (!(objects[j] = PyUnicode_FromString(names[j]))) {
+            while (--j >= 0) {
+                Py_DECREF(objects[j]);
+            }
+            return -1;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        PyObject *name = objects[i % 6];
+
+        found += is_parsable(name) + is_single(name) + is_single_only(name) +
+                 is_scheme(name, i & 1);
+    }
+    sink = found;
+    for (j = 0; j < 6; j++) {
+        Py_DECREF(objects[j]);
+    }
+    return 0;
+}
+
+typedef struct {
+    const char *name;
+    int (*func)(Py_ssize_t, TokenizerInput *);
+} Benchmark;
+
+static const Benchmark BENCHMARKS[] = {
+    {"textbuffer_write", bench_textbuffer_write},
+    {"textbuffer_concat", bench_textbuffer_concat},
+    {"textbuffer_render", bench_textbuffer_render},
+    {"push_pop", bench_push_pop},
+    {"route_insert", bench_route_insert},
+    {"route_lookup", bench_route_lookup},
+    {"is_marker", bench_is_marker},
+    {"entity_lookup", bench_entity_lookup},
+    {"definitions", bench_definitions},
+    {NULL, NULL},
+};
+
+/*
+    Return a tuple of the names of the available microbenchmarks.
+*/
+PyObject *
+microbench_names(PyObject *self, PyObject *args)
+{
+    PyObject *names, *name;
+    Py_ssize_t i, count = 0;
+
+    while (BENCHMARKS[count].name) {
+        count++;
+    }
+    if (!(names = PyTuple_New(count))) {
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        if (!(name = PyUnicode_FromString(BENCHMARKS[i].name))) {
+            Py_DECREF(names);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(names, i, name);
+    }
+    return names;
+}
+
+/*
+    Run the named microbenchmark for the given number of iterations.
+*/
+PyObject *
+microbench_run(PyObject *self, PyObject *args)
+{
+    const char *name;
+    Py_ssize_t n, i;
+    PyObject *sample;
+    TokenizerInput input;
+    int result;
+
+    if (!PyArg_ParseTuple(args, "sn", &name, &n)) {
+        return NULL;
+    }
+    for (i = 0; BENCHMARKS[i].name; i++) {
+        if (!strcmp(BENCHMARKS[i].name, name)) {
+            break;
+        }
+    }
+    if (!BENCHMARKS[i].name) {
+        PyErr_Format(PyExc_ValueError, "unknown microbenchmark: %s", name);
+        return NULL;
+    }
+    if (!(sample = PyUnicode_FromString(SAMPLE))) {
+        return NULL;
+    }
+    input.object = sample;
+    input.kind = PyUnicode_KIND(sample);
+    input.data = PyUnicode_DATA(sample);
+    input.length = PyUnicode_GET_LENGTH(sample);
+    result = BENCHMARKS[i].func(n, &input);
+    Py_DECREF(sample);
+    if (result) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+#endif
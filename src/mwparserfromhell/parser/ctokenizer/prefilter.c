@@ -0,0 +1,358 @@
+/*
+Copyright (C) 2012-2016 Ben Kurtovic <ben.kurtovic@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "prefilter.h"
+
+/*
+    A trie is a flat array of 32-bit integers built by prefilters.py. Each node
+    is its slot (the pattern number if a name ends there, or -1), its number of
+    children, and then a (label, offset) pair for each child, sorted by label.
+    The root node is at offset 0.
+*/
+typedef struct {
+    const int32_t *nodes;
+    Py_ssize_t size;
+} Trie;
+
+typedef struct {
+    int kind; /* A PyUnicode kind, or 0 for bytes */
+    const void *data;
+    Py_ssize_t length;
+} ScanInput;
+
+typedef struct {
+    Py_ssize_t offset;
+    int kind;
+    int32_t slot;
+} Hit;
+
+typedef struct {
+    Hit *hits;
+    Py_ssize_t count;
+    Py_ssize_t capacity;
+    int find_all;
+    int failed;
+} ScanResult;
+
+/*
+    Return the code point (or byte) at the given index of the input.
+*/
+static inline Py_UCS4
+read_char(const ScanInput *input, Py_ssize_t index)
+{
+    if (input->kind == 0) {
+        return ((const unsigned char *) input->data)[index];
+    }
+    return PyUnicode_READ(input->kind, input->data, index);
+}
+
+/*
+    Return whether the character can surround a name, or separate its words.
+*/
+static inline int
+is_space(Py_UCS4 c)
+{
+    return c == ' ' || c == '_' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/*
+    Return the index of the first non-space character at or after index.
+*/
+static Py_ssize_t
+skip_spaces(const ScanInput *input, Py_ssize_t index)
+{
+    while (index < input->length && is_space(read_char(input, index))) {
+        index++;
+    }
+    return index;
+}
+
+/*
+    Return whether a name can end at the given index: it must be followed by
+    optional spaces and then the end of the input or a character that can't
+    be part of a name.
+*/
+static int
+is_name_end(const ScanInput *input, Py_ssize_t index)
+{
+    Py_UCS4 c;
+
+    index = skip_spaces(input, index);
+    if (index >= input->length) {
+        return 1;
+    }
+    c = read_char(input, index);
+    return c == '|' || c == '}' || c == ']' || c == '#' || c == '<' || c == '{';
+}
+
+/*
+    Return the offset of the child of a trie node with the given label, or -1.
+*/
+static int32_t
+find_child(const Trie *trie, int32_t node, Py_UCS4 label)
+{
+    Py_ssize_t low = 0, high, mid;
+    const int32_t *pairs;
+
+    if (node < 0 || node + 2 > trie->size) {
+        return -1;
+    }
+    high = trie->nodes[node + 1];
+    if (high < 0 || node + 2 + 2 * high > trie->size) {
+        return -1;
+    }
+    pairs = trie->nodes + node + 2;
+    while (low < high) {
+        mid = (low + high) / 2;
+        if ((Py_UCS4) pairs[2 * mid] < label) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < trie->nodes[node + 1] && (Py_UCS4) pairs[2 * low] == label) {
+        return pairs[2 * low + 1];
+    }
+    return -1;
+}
+
+/*
+    Match a name in the trie starting at the given index. Runs of spaces and
+    underscores in the input match a single space in the trie. Return the slot
+    of the matching name, or -1.
+*/
+static int32_t
+match_name(const Trie *trie, const ScanInput *input, Py_ssize_t index)
+{
+    int32_t node = 0, slot;
+    Py_UCS4 c;
+
+    if (trie->size < 2) {
+        return -1;
+    }
+    while (1) {
+        slot = trie->nodes[node];
+        if (slot >= 0 && is_name_end(input, index)) {
+            return slot;
+        }
+        if (index >= input->length) {
+            return -1;
+        }
+        c = read_char(input, index);
+        if (c == ' ' || c == '_') {
+            while (index < input->length &&
+                   ((c = read_char(input, index)) == ' ' || c == '_')) {
+                index++;
+            }
+            c = ' ';
+        } else {
+            index++;
+        }
+        node = find_child(trie, node, c);
+        if (node < 0 || node + 2 > trie->size) {
+            return -1;
+        }
+    }
+}
+
+/*
+    Skip a "Template:" prefix (in any case, with optional spaces around the
+    colon) at the given index, returning the index after it.
+*/
+static Py_ssize_t
+skip_template_prefix(const ScanInput *input, Py_ssize_t index)
+{
+    static const char *prefix = "template";
+    Py_ssize_t i;
+
+    if (index + 8 >= input->length) {
+        return index;
+    }
+    for (i = 0; i < 8; i++) {
+        Py_UCS4 c = read_char(input, index + i);
+
+        if ((c | 0x20) != (Py_UCS4) prefix[i]) {
+            return index;
+        }
+    }
+    i = skip_spaces(input, index + 8);
+    if (i < input->length && read_char(input, i) == ':') {
+        return skip_spaces(input, i + 1);
+    }
+    return index;
+}
+
+/*
+    Record a hit, growing the array of hits if necessary.
+*/
+static int
+add_hit(ScanResult *result, Py_ssize_t offset, int kind, int32_t slot)
+{
+    if (result->count == result->capacity) {
+        Py_ssize_t capacity = result->capacity ? result->capacity * 2 : 16;
+        Hit *hits = realloc(result->hits, capacity * sizeof(Hit));
+
+        if (!hits) {
+            result->failed = 1;
+            return -1;
+        }
+        result->hits = hits;
+        result->capacity = capacity;
+    }
+    result->hits[result->count].offset = offset;
+    result->hits[result->count].kind = kind;
+    result->hits[result->count].slot = slot;
+    result->count++;
+    return 0;
+}
+
+/*
+    Scan the input for "{{" and "[[" followed by a name in the corresponding
+    trie. This doesn't touch any Python objects, so it runs without the GIL.
+*/
+static void
+scan(const ScanInput *input,
+     const Trie *templates,
+     const Trie *links,
+     ScanResult *result)
+{
+    Py_ssize_t i, start;
+    Py_UCS4 c;
+    int32_t slot;
+
+    for (i = 0; i + 1 < input->length; i++) {
+        c = read_char(input, i);
+        if ((c != '{' && c != '[') || read_char(input, i + 1) != c) {
+            continue;
+        }
+        start = skip_spaces(input, i + 2);
+        if (c == '{') {
+            start = skip_template_prefix(input, start);
+            slot = match_name(templates, input, start);
+        } else {
+            if (start < input->length && read_char(input, start) == ':') {
+                start = skip_spaces(input, start + 1);
+            }
+            slot = match_name(links, input, start);
+        }
+        if (slot >= 0) {
+            int kind = c == '{' ? PREFILTER_TEMPLATE : PREFILTER_LINK;
+
+            if (add_hit(result, i, kind, slot) || !result->find_all) {
+                return;
+            }
+        }
+    }
+}
+
+/*
+    Convert a hit into a Python tuple of (offset, kind, slot).
+*/
+static PyObject *
+build_hit(const Hit *hit)
+{
+    return Py_BuildValue("(nii)", hit->offset, hit->kind, (int) hit->slot);
+}
+
+/*
+    Scan a str or bytes-like object with the given template and link tries,
+    which are bytes-like objects of native 32-bit integers. If find_all is
+    true, return a list of (offset, kind, slot) tuples for every hit;
+    otherwise, return the first hit or None.
+*/
+PyObject *
+prefilter_scan(PyObject *self, PyObject *args)
+{
+    PyObject *text, *output = NULL;
+    Py_buffer tbuf, lbuf, ibuf = {0};
+    ScanInput input;
+    ScanResult result = {0};
+    Trie templates, links;
+    int find_all, have_ibuf = 0;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTuple(args, "Oy*y*p", &text, &tbuf, &lbuf, &find_all)) {
+        return NULL;
+    }
+    if (PyUnicode_Check(text)) {
+        if (PyUnicode_READY(text) < 0) {
+            goto done;
+        }
+        input.kind = PyUnicode_KIND(text);
+        input.data = PyUnicode_DATA(text);
+        input.length = PyUnicode_GET_LENGTH(text);
+    } else {
+        if (PyObject_GetBuffer(text, &ibuf, PyBUF_SIMPLE)) {
+            goto done;
+        }
+        have_ibuf = 1;
+        input.kind = 0;
+        input.data = ibuf.buf;
+        input.length = ibuf.len;
+    }
+    templates.nodes = tbuf.buf;
+    templates.size = tbuf.len / (Py_ssize_t) sizeof(int32_t);
+    links.nodes = lbuf.buf;
+    links.size = lbuf.len / (Py_ssize_t) sizeof(int32_t);
+    result.find_all = find_all;
+
+    Py_BEGIN_ALLOW_THREADS
+    scan(&input, &templates, &links, &result);
+    Py_END_ALLOW_THREADS
+
+    if (result.failed) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    if (!find_all) {
+        if (result.count) {
+            output = build_hit(&result.hits[0]);
+        } else {
+            output = Py_None;
+            Py_INCREF(output);
+        }
+        goto done;
+    }
+    output = PyList_New(result.count);
+    if (!output) {
+        goto done;
+    }
+    for (i = 0; i < result.count; i++) {
+        PyObject *hit = build_hit(&result.hits[i]);
+
+        if (!hit) {
+            Py_CLEAR(output);
+            goto done;
+        }
+        PyList_SET_ITEM(output, i, hit);
+    }
+
+done:
+    free(result.hits);
+    if (have_ibuf) {
+        PyBuffer_Release(&ibuf);
+    }
+    PyBuffer_Release(&tbuf);
+    PyBuffer_Release(&lbuf);
+    return output;
+}
@@ -0,0 +1,61 @@
+/*
+Copyright (C) 2012-2016 Ben Kurtovic <ben.kurtovic@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+/*
+    Static probe points for tracing the tokenizer with tools like perf and
+    bpftrace, under the provider name "mwparserfromhell". They compile to a
+    single no-op instruction each, so they cost nothing until a tracer attaches.
+    They are only available when <sys/sdt.h> (from SystemTap) is installed at
+    build time, and can be disabled by defining MWP_NO_PROBES.
+
+    tokenize__start(length)      a page of the given length starts tokenizing
+    tokenize__done(length, ok)   it finished, successfully or not
+    route__fail(head, context)   a route failed at the given head position
+    stack__push(head, depth)     a new token stack was pushed
+    stack__pop(head, depth)      the top token stack was popped
+*/
+
+#if defined(__has_include) && !defined(MWP_NO_PROBES)
+#    if __has_include(<sys/sdt.h>)
+#        include <sys/sdt.h>
+#        define PROBE_TOKENIZE_START(length)                                         \
+            DTRACE_PROBE1(mwparserfromhell, tokenize__start, length)
+#        define PROBE_TOKENIZE_DONE(length, ok)                                      \
+            DTRACE_PROBE2(mwparserfromhell, tokenize__done, length, ok)
+#        define PROBE_ROUTE_FAIL(head, context)                                      \
+            DTRACE_PROBE2(mwparserfromhell, route__fail, head, context)
+#        define PROBE_STACK_PUSH(head, depth)                                        \
+            DTRACE_PROBE2(mwparserfromhell, stack__push, head, depth)
+#        define PROBE_STACK_POP(head, depth)                                         \
+            DTRACE_PROBE2(mwparserfromhell, stack__pop, head, depth)
+#    endif
+#endif
+
+#ifndef PROBE_TOKENIZE_START
+#    define PROBE_TOKENIZE_START(length)
+#    define PROBE_TOKENIZE_DONE(length, ok)
+#    define PROBE_ROUTE_FAIL(head, context)
+#    define PROBE_STACK_PUSH(head, depth)
+#    define PROBE_STACK_POP(head, depth)
+#endif
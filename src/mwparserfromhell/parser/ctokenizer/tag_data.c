@@ -24,61 +24,36 @@ SOFTWARE.
 #include "contexts.h"
 
 /*
-    Initialize a new TagData object.
+    Initialize a TagData object for a new open tag.
 */
-TagData *
-TagData_new(TokenizerInput *text)
+void
+TagData_init(TagData *self)
 {
-#define ALLOC_BUFFER(name)                                                             \
-    name = Textbuffer_new(text);                                                       \
-    if (!name) {                                                                       \
-        TagData_dealloc(self);                                                         \
-        return NULL;                                                                   \
-    }
-
-    TagData *self = malloc(sizeof(TagData));
-    if (!self) {
-        PyErr_NoMemory();
-        return NULL;
-    }
     self->context = TAG_NAME;
-    ALLOC_BUFFER(self->pad_first)
-    ALLOC_BUFFER(self->pad_before_eq)
-    ALLOC_BUFFER(self->pad_after_eq)
+    TagData_reset_padding(self);
     self->quoter = 0;
     self->reset = 0;
-    return self;
-
-#undef ALLOC_BUFFER
 }
 
 /*
-    Deallocate the given TagData object.
+    Clear the padding recorded by the given TagData object.
 */
 void
-TagData_dealloc(TagData *self)
+TagData_reset_padding(TagData *self)
 {
-    if (self->pad_first) {
-        Textbuffer_dealloc(self->pad_first);
-    }
-    if (self->pad_before_eq) {
-        Textbuffer_dealloc(self->pad_before_eq);
-    }
-    if (self->pad_after_eq) {
-        Textbuffer_dealloc(self->pad_after_eq);
-    }
-    free(self);
+    self->pad_first.start = self->pad_first.end = 0;
+    self->pad_before_eq.start = self->pad_before_eq.end = 0;
+    self->pad_after_eq.start = self->pad_after_eq.end = 0;
 }
 
 /*
-    Clear the internal buffers of the given TagData object.
+    Add the character at the given index of the input to some padding.
 */
-int
-TagData_reset_buffers(TagData *self)
+void
+Padding_extend(Padding *self, Py_ssize_t index)
 {
-    if (Textbuffer_reset(self->pad_first) || Textbuffer_reset(self->pad_before_eq) ||
-        Textbuffer_reset(self->pad_after_eq)) {
-        return -1;
+    if (self->start == self->end) {
+        self->start = index;
     }
-    return 0;
+    self->end = index + 1;
 }
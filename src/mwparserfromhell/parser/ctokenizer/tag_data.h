@@ -23,21 +23,27 @@ SOFTWARE.
 #pragma once
 
 #include "common.h"
-#include "textbuffer.h"
 
 /* Structs */
 
+/* Padding is recorded as a range of offsets into the input, since it is always
+   a contiguous run of whitespace. */
+typedef struct {
+    Py_ssize_t start;
+    Py_ssize_t end;
+} Padding;
+
 typedef struct {
     uint64_t context;
-    Textbuffer *pad_first;
-    Textbuffer *pad_before_eq;
-    Textbuffer *pad_after_eq;
+    Padding pad_first;
+    Padding pad_before_eq;
+    Padding pad_after_eq;
     Py_UCS4 quoter;
     Py_ssize_t reset;
 } TagData;
 
 /* Functions */
 
-TagData *TagData_new(TokenizerInput *);
-void TagData_dealloc(TagData *);
-int TagData_reset_buffers(TagData *);
+void TagData_init(TagData *);
+void TagData_reset_padding(TagData *);
+void Padding_extend(Padding *, Py_ssize_t);
@@ -41,6 +41,7 @@ internal_alloc(Textbuffer *self, Py_UCS4 maxchar)
     }
     self->kind = PyUnicode_KIND(self->object);
     self->data = PyUnicode_DATA(self->object);
+    memory_add(self->memory, self->capacity * self->kind);
 
     return 0;
 }
@@ -51,6 +52,7 @@ internal_alloc(Textbuffer *self, Py_UCS4 maxchar)
 static void
 internal_dealloc(Textbuffer *self)
 {
+    memory_add(self->memory, -self->capacity * self->kind);
     Py_DECREF(self->object);
 }
 
@@ -73,15 +75,17 @@ internal_resize(Textbuffer *self, Py_ssize_t new_cap)
     self->object = newobj;
     self->data = newdata;
 
+    memory_add(self->memory, (new_cap - self->capacity) * self->kind);
     self->capacity = new_cap;
     return 0;
 }
 
 /*
-    Create a new textbuffer object.
+    Create a new textbuffer object. Its bytes are added to the given memory
+    counter, which can be NULL.
 */
 Textbuffer *
-Textbuffer_new(TokenizerInput *text)
+Textbuffer_new(TokenizerInput *text, MemoryCounter *memory)
 {
     Textbuffer *self = malloc(sizeof(Textbuffer));
     Py_UCS4 maxchar = 0;
@@ -91,9 +95,11 @@ Textbuffer_new(TokenizerInput *text)
     if (!self) {
         goto fail_nomem;
     }
+    self->memory = memory;
     if (internal_alloc(self, maxchar) < 0) {
         goto fail_dealloc;
     }
+    memory_add(memory, sizeof(Textbuffer));
     return self;
 
 fail_dealloc:
@@ -110,6 +116,7 @@ void
 Textbuffer_dealloc(Textbuffer *self)
 {
     internal_dealloc(self);
+    memory_add(self->memory, -(Py_ssize_t) sizeof(Textbuffer));
     free(self);
 }
 
@@ -147,6 +154,42 @@ Textbuffer_write(Textbuffer *self, Py_UCS4 code)
     return 0;
 }
 
+/*
+    Write the contents of a Python Unicode object to the given textbuffer. The
+    object can't use a wider kind than the textbuffer.
+*/
+int
+Textbuffer_write_string(Textbuffer *self, PyObject *text)
+{
+    Py_ssize_t i, length = PyUnicode_GET_LENGTH(text);
+    Py_ssize_t newlen = self->length + length;
+    int kind = PyUnicode_KIND(text);
+    const void *data = PyUnicode_DATA(text);
+
+    if (newlen > self->capacity) {
+        if (internal_resize(self, newlen + CONCAT_EXTRA) < 0) {
+            return -1;
+        }
+    }
+
+    assert(kind <= self->kind);
+    if (kind == self->kind) {
+        memcpy(((Py_UCS1 *) self->data) + self->kind * self->length,
+               data,
+               length * kind);
+    } else {
+        for (i = 0; i < length; i++) {
+            PyUnicode_WRITE(self->kind,
+                            self->data,
+                            self->length + i,
+                            PyUnicode_READ(kind, data, i));
+        }
+    }
+
+    self->length = newlen;
+    return 0;
+}
+
 /*
     Read a Unicode codepoint from the given index of the given textbuffer.
 
@@ -26,10 +26,11 @@ SOFTWARE.
 
 /* Functions */
 
-Textbuffer *Textbuffer_new(TokenizerInput *);
+Textbuffer *Textbuffer_new(TokenizerInput *, MemoryCounter *);
 void Textbuffer_dealloc(Textbuffer *);
 int Textbuffer_reset(Textbuffer *);
 int Textbuffer_write(Textbuffer *, Py_UCS4);
+int Textbuffer_write_string(Textbuffer *, PyObject *);
 Py_UCS4 Textbuffer_read(Textbuffer *, Py_ssize_t);
 PyObject *Textbuffer_render(Textbuffer *);
 int Textbuffer_concat(Textbuffer *, Textbuffer *);
@@ -24,8 +24,10 @@ SOFTWARE.
 #include "contexts.h"
 #include "definitions.h"
 #include "tag_data.h"
+#include "textbuffer.h"
 #include "tok_support.h"
 #include "tokens.h"
+#include "views.h"
 
 #define DIGITS          "0123456789"
 #define HEXDIGITS       "0123456789abcdefABCDEF"
@@ -34,6 +36,7 @@ SOFTWARE.
 
 #define MAX_BRACES      255
 #define MAX_ENTITY_SIZE 8
+#define RAW_NESTING_SIZE 64
 
 typedef struct {
     PyObject *title;
@@ -51,7 +54,7 @@ static int Tokenizer_parse_tag(Tokenizer *);
 /*
     Determine whether the given code point is a marker.
 */
-static int
+int
 is_marker(Py_UCS4 this)
 {
     int i;
@@ -88,7 +91,7 @@ strip_tag_name(PyObject *token, int take_attr)
     PyObject *text, *rstripped, *lowered;
 
     if (take_attr) {
-        text = PyObject_GetAttrString(token, "text");
+        text = get_token_attr(token, KEY_TEXT);
         if (!text) {
             return NULL;
         }
@@ -119,7 +122,9 @@ Tokenizer_parse_template(Tokenizer *self, int has_content)
         context |= LC_HAS_TEMPLATE;
     }
 
+    self->construct_depth++;
     template = Tokenizer_parse(self, context, 1);
+    self->construct_depth--;
     if (BAD_ROUTE) {
         self->head = reset;
         return 0;
@@ -151,7 +156,9 @@ Tokenizer_parse_argument(Tokenizer *self)
     PyObject *argument;
     Py_ssize_t reset = self->head;
 
+    self->construct_depth++;
     argument = Tokenizer_parse(self, LC_ARGUMENT_NAME, 1);
+    self->construct_depth--;
     if (BAD_ROUTE) {
         self->head = reset;
         return 0;
@@ -257,6 +264,127 @@ Tokenizer_parse_template_or_argument(Tokenizer *self)
     return 0;
 }
 
+/*
+    Return the index just past the end of the construct whose opening delimiters
+    are at the given index, matching runs of delimiters like MediaWiki does: a
+    run of closing delimiters closes the innermost open run, up to "most" of
+    them at a time. Comments and <nowiki> sections are skipped, but nothing
+    else is parsed. Return -1 if the construct is never closed, or -2 with an
+    exception set if memory runs out. Open runs are kept on the stack up to a
+    depth of RAW_NESTING_SIZE, and on the heap beyond that.
+*/
+static Py_ssize_t
+find_construct_end(TokenizerInput *text,
+                   Py_ssize_t index,
+                   Py_UCS4 open,
+                   Py_UCS4 close,
+                   int most)
+{
+    Py_ssize_t local[RAW_NESTING_SIZE], *stack = local, *grown;
+    Py_ssize_t count = 0, capacity = RAW_NESTING_SIZE, end = -1;
+    Py_ssize_t run, used, size;
+    Py_UCS4 this;
+
+    while (index < text->length) {
+        this = PyUnicode_READ(text->kind, text->data, index);
+        if (this == open || this == close) {
+            for (run = 1; index + run < text->length; run++) {
+                if (PyUnicode_READ(text->kind, text->data, index + run) != this) {
+                    break;
+                }
+            }
+            if (this == open && run >= 2) {
+                if (count == capacity) {
+                    grown = realloc(stack == local ? NULL : stack,
+                                    2 * capacity * sizeof(Py_ssize_t));
+                    if (!grown) {
+                        PyErr_NoMemory();
+                        end = -2;
+                        goto done;
+                    }
+                    if (stack == local) {
+                        memcpy(grown, local, sizeof(local));
+                    }
+                    stack = grown;
+                    capacity *= 2;
+                }
+                stack[count++] = run;
+            } else if (this == close) {
+                used = 0;
+                while (run - used >= 2 && count) {
+                    size = 2;
+                    if (most >= 3 && stack[count - 1] >= 3 && run - used >= 3) {
+                        size = 3;
+                    }
+                    stack[count - 1] -= size;
+                    used += size;
+                    if (stack[count - 1] < 2) {
+                        count--;
+                    }
+                    if (!count) {
+                        end = index + used;
+                        goto done;
+                    }
+                }
+            }
+            index += run;
+        } else if (this == '<' && match_ascii(text->object, index, "<!--", 0)) {
+            index = find_ascii(text->object, index + 4, "-->", 0);
+            if (index < 0) {
+                goto done;
+            }
+            index += 3;
+        } else if (this == '<' && match_ascii(text->object, index, "<nowiki>", 1)) {
+            run = find_ascii(text->object, index + 8, "</nowiki>", 1);
+            index = run < 0 ? index + 8 : run + 9;
+        } else {
+            index++;
+        }
+    }
+
+done:
+    if (stack != local) {
+        free(stack);
+    }
+    return end;
+}
+
+/*
+    Emit the template, argument, or wikilink at the head of the string as text,
+    without parsing it, because it is nested deeper than max_parse_depth. If it
+    is never closed, only its opening delimiters are emitted.
+*/
+static int
+Tokenizer_emit_raw_construct(Tokenizer *self, Py_UCS4 open, Py_UCS4 close, int most)
+{
+    Py_ssize_t end = find_construct_end(&self->text, self->head, open, close, most);
+
+    if (end == -2) {
+        return -1;
+    }
+    if (end < 0) {
+        while (Tokenizer_read(self, 1) == open) {
+            if (Tokenizer_emit_char(self, open)) {
+                return -1;
+            }
+            self->head++;
+        }
+        return Tokenizer_emit_char(self, open);
+    }
+    for (; self->head < end - 1; self->head++) {
+        if (Tokenizer_emit_char(self, Tokenizer_read(self, 0))) {
+            return -1;
+        }
+    }
+    if (Tokenizer_emit_char(self, close)) {
+        return -1;
+    }
+    if (open == '{' && self->topstack->context & LC_FAIL_NEXT) {
+        self->topstack->context ^= LC_FAIL_NEXT;
+    }
+    return 0;
+}
+
 /*
     Handle a template parameter at the head of the string.
 */
@@ -382,7 +510,7 @@ static int
 Tokenizer_parse_wikilink(Tokenizer *self)
 {
     Py_ssize_t reset;
-    PyObject *extlink, *wikilink, *kwargs;
+    PyObject *extlink, *wikilink;
 
     reset = self->head + 1;
     self->head += 2;
@@ -392,7 +520,9 @@ Tokenizer_parse_wikilink(Tokenizer *self)
         RESET_ROUTE();
         self->head = reset + 1;
         // Otherwise, actually parse it as a wikilink:
+        self->construct_depth++;
         wikilink = Tokenizer_parse(self, LC_WIKILINK_TITLE, 1);
+        self->construct_depth--;
         if (BAD_ROUTE) {
             RESET_ROUTE();
             self->head = reset;
@@ -435,13 +565,7 @@ Tokenizer_parse_wikilink(Tokenizer *self)
         Py_DECREF(extlink);
         return -1;
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        Py_DECREF(extlink);
-        return -1;
-    }
-    PyDict_SetItemString(kwargs, "brackets", Py_True);
-    if (Tokenizer_emit_kwargs(self, ExternalLinkOpen, kwargs)) {
+    if (Tokenizer_emit_attrs(self, ExternalLinkOpen, 1, KEY_BRACKETS, Py_True)) {
         Py_DECREF(extlink);
         return -1;
     }
@@ -505,7 +629,7 @@ Tokenizer_parse_bracketed_uri_scheme(Tokenizer *self)
         }
         self->head += 2;
     } else {
-        buffer = Textbuffer_new(&self->text);
+        buffer = Textbuffer_new(&self->text, &self->memory.textbuffers);
         if (!buffer) {
             return -1;
         }
@@ -568,7 +692,7 @@ static int
 Tokenizer_parse_free_uri_scheme(Tokenizer *self)
 {
     static const char *valid = URISCHEME;
-    Textbuffer *scheme_buffer = Textbuffer_new(&self->text);
+    Textbuffer *scheme_buffer = Textbuffer_new(&self->text, &self->memory.textbuffers);
     PyObject *scheme;
     Py_UCS4 ch;
     Py_ssize_t i;
@@ -742,12 +866,11 @@ Tokenizer_really_parse_external_link(Tokenizer *self, int brackets, Textbuffer *
                     }
                     self->head++;
                 } else {
-                    PyObject *kwargs = PyDict_New();
-                    if (!kwargs) {
-                        return NULL;
-                    }
-                    PyDict_SetItemString(kwargs, "suppress_space", Py_True);
-                    if (Tokenizer_emit_kwargs(self, ExternalLinkSeparator, kwargs)) {
+                    if (Tokenizer_emit_attrs(self,
+                                             ExternalLinkSeparator,
+                                             1,
+                                             KEY_SUPPRESS_SPACE,
+                                             Py_True)) {
                         return NULL;
                     }
                 }
@@ -783,7 +906,7 @@ Tokenizer_really_parse_external_link(Tokenizer *self, int brackets, Textbuffer *
 static int
 Tokenizer_remove_uri_scheme_from_textbuffer(Tokenizer *self, PyObject *link)
 {
-    PyObject *text = PyObject_GetAttrString(PyList_GET_ITEM(link, 0), "text"), *split,
+    PyObject *text = get_token_attr(PyList_GET_ITEM(link, 0), KEY_TEXT), *split,
              *scheme;
     Py_ssize_t length;
 
@@ -817,13 +940,13 @@ Tokenizer_parse_external_link(Tokenizer *self, int brackets)
     } while (0)
 
     Py_ssize_t reset = self->head;
-    PyObject *link, *kwargs;
+    PyObject *link;
     Textbuffer *extra;
 
     if (self->topstack->context & AGG_NO_EXT_LINKS || !(Tokenizer_CAN_RECURSE(self))) {
         NOT_A_LINK;
     }
-    extra = Textbuffer_new(&self->text);
+    extra = Textbuffer_new(&self->text, &self->memory.textbuffers);
     if (!extra) {
         return -1;
     }
@@ -846,14 +969,8 @@ Tokenizer_parse_external_link(Tokenizer *self, int brackets)
             return -1;
         }
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        Textbuffer_dealloc(extra);
-        Py_DECREF(link);
-        return -1;
-    }
-    PyDict_SetItemString(kwargs, "brackets", brackets ? Py_True : Py_False);
-    if (Tokenizer_emit_kwargs(self, ExternalLinkOpen, kwargs)) {
+    if (Tokenizer_emit_attrs(
+            self, ExternalLinkOpen, 1, KEY_BRACKETS, brackets ? Py_True : Py_False)) {
         Textbuffer_dealloc(extra);
         Py_DECREF(link);
         return -1;
@@ -882,9 +999,9 @@ static int
 Tokenizer_parse_heading(Tokenizer *self)
 {
     Py_ssize_t reset = self->head;
-    int best = 1, i, context, diff;
+    int best = 1, i, context, diff, retval;
     HeadingData *heading;
-    PyObject *level, *kwargs;
+    PyObject *level;
 
     self->global |= GL_HEADING;
     self->head += 1;
@@ -914,16 +1031,9 @@ Tokenizer_parse_heading(Tokenizer *self)
         free(heading);
         return -1;
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        Py_DECREF(level);
-        Py_DECREF(heading->title);
-        free(heading);
-        return -1;
-    }
-    PyDict_SetItemString(kwargs, "level", level);
+    retval = Tokenizer_emit_attrs(self, HeadingStart, 1, KEY_LEVEL, level);
     Py_DECREF(level);
-    if (Tokenizer_emit_kwargs(self, HeadingStart, kwargs)) {
+    if (retval) {
         Py_DECREF(heading->title);
         free(heading);
         return -1;
@@ -1023,10 +1133,10 @@ Tokenizer_handle_heading_end(Tokenizer *self)
 static int
 Tokenizer_really_parse_entity(Tokenizer *self)
 {
-    PyObject *kwargs, *charobj, *textobj;
+    PyObject *charobj, *textobj;
     Py_UCS4 this;
-    int numeric, hexadecimal, i, j, zeroes, test;
-    char *valid, *text, *buffer, *def;
+    int numeric, hexadecimal, i, j, zeroes, test, retval;
+    char *valid, *text, *buffer;
 
 #define FAIL_ROUTE_AND_EXIT()                                                          \
     do {                                                                               \
@@ -1057,17 +1167,12 @@ Tokenizer_really_parse_entity(Tokenizer *self)
         }
         if (this == 'x' || this == 'X') {
             hexadecimal = 1;
-            kwargs = PyDict_New();
-            if (!kwargs) {
-                return -1;
-            }
             if (!(charobj = PyUnicode_FROM_SINGLE(this))) {
-                Py_DECREF(kwargs);
                 return -1;
             }
-            PyDict_SetItemString(kwargs, "char", charobj);
+            retval = Tokenizer_emit_attrs(self, HTMLEntityHex, 1, KEY_CHAR, charobj);
             Py_DECREF(charobj);
-            if (Tokenizer_emit_kwargs(self, HTMLEntityHex, kwargs)) {
+            if (retval) {
                 return -1;
             }
             self->head++;
@@ -1129,18 +1234,8 @@ Tokenizer_really_parse_entity(Tokenizer *self)
         if (test < 1 || test > 0x10FFFF) {
             FAIL_ROUTE_AND_EXIT();
         }
-    } else {
-        i = 0;
-        while (1) {
-            def = entitydefs[i];
-            if (!def) { // We've reached the end of the defs without finding it
-                FAIL_ROUTE_AND_EXIT();
-            }
-            if (strcmp(text, def) == 0) {
-                break;
-            }
-            i++;
-        }
+    } else if (!is_entity(text)) {
+        FAIL_ROUTE_AND_EXIT();
     }
     if (zeroes) {
         buffer = calloc(strlen(text) + zeroes + 1, sizeof(char));
@@ -1162,14 +1257,9 @@ Tokenizer_really_parse_entity(Tokenizer *self)
         return -1;
     }
     free(text);
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        Py_DECREF(textobj);
-        return -1;
-    }
-    PyDict_SetItemString(kwargs, "text", textobj);
+    retval = Tokenizer_emit_attrs(self, Text, 1, KEY_TEXT, textobj);
     Py_DECREF(textobj);
-    if (Tokenizer_emit_kwargs(self, Text, kwargs)) {
+    if (retval) {
         return -1;
     }
     if (Tokenizer_emit(self, HTMLEntityEnd)) {
@@ -1218,43 +1308,49 @@ Tokenizer_parse_entity(Tokenizer *self)
 }
 
 /*
-    Parse an HTML comment at the head of the wikicode string.
+    Parse an HTML comment at the head of the wikicode string. If comments are
+    being dropped, skip over it without emitting anything.
 */
 static int
 Tokenizer_parse_comment(Tokenizer *self)
 {
     Py_ssize_t reset = self->head + 3;
+    int drop = self->drop_comments;
     PyObject *comment;
     Py_UCS4 this;
 
     self->head += 4;
-    if (Tokenizer_push(self, 0)) {
+    if (!drop && Tokenizer_push(self, 0)) {
         return -1;
     }
     while (1) {
         this = Tokenizer_read(self, 0);
         if (!this) {
-            comment = Tokenizer_pop(self);
-            Py_XDECREF(comment);
+            if (!drop) {
+                comment = Tokenizer_pop(self);
+                Py_XDECREF(comment);
+            }
             self->head = reset;
             return Tokenizer_emit_text(self, "<!--");
         }
         if (this == '-' && Tokenizer_read(self, 1) == this &&
             Tokenizer_read(self, 2) == '>') {
-            if (Tokenizer_emit_first(self, CommentStart)) {
-                return -1;
-            }
-            if (Tokenizer_emit(self, CommentEnd)) {
-                return -1;
-            }
-            comment = Tokenizer_pop(self);
-            if (!comment) {
-                return -1;
-            }
-            if (Tokenizer_emit_all(self, comment)) {
-                return -1;
+            if (!drop) {
+                if (Tokenizer_emit_first(self, CommentStart)) {
+                    return -1;
+                }
+                if (Tokenizer_emit(self, CommentEnd)) {
+                    return -1;
+                }
+                comment = Tokenizer_pop(self);
+                if (!comment) {
+                    return -1;
+                }
+                if (Tokenizer_emit_all(self, comment)) {
+                    return -1;
+                }
+                Py_DECREF(comment);
             }
-            Py_DECREF(comment);
             self->head += 2;
             if (self->topstack->context & LC_FAIL_NEXT) {
                 /* _verify_safe() sets this flag while parsing a template or
@@ -1264,77 +1360,91 @@ Tokenizer_parse_comment(Tokenizer *self)
             }
             return 0;
         }
-        if (Tokenizer_emit_char(self, this)) {
+        if (!drop && Tokenizer_emit_char(self, this)) {
             return -1;
         }
         self->head++;
     }
 }
 
+/*
+    Render some padding of a tag attribute.
+*/
+static PyObject *
+Tokenizer_render_padding(Tokenizer *self, Padding *padding)
+{
+    return Tokenizer_render_slice(self, padding->start, padding->end);
+}
+
 /*
     Write a pending tag attribute from data to the stack.
+
+    The attribute's tokens are on their own stack, with its quoted value (if
+    any) on another stack above it. Both are popped and written to the tag's
+    stack after TagAttrStart and TagAttrQuote tokens, so neither token has to
+    be inserted at the front of a stack.
 */
 static int
 Tokenizer_push_tag_buffer(Tokenizer *self, TagData *data)
 {
-    PyObject *tokens, *kwargs, *tmp, *pad_first, *pad_before_eq, *pad_after_eq;
+    PyObject *attr, *value = NULL, *pad_first, *pad_before_eq, *pad_after_eq, *quoter;
+    int retval;
 
     if (data->context & TAG_QUOTED) {
-        kwargs = PyDict_New();
-        if (!kwargs) {
-            return -1;
-        }
-        tmp = PyUnicode_FROM_SINGLE(data->quoter);
-        if (!tmp) {
-            return -1;
-        }
-        PyDict_SetItemString(kwargs, "char", tmp);
-        Py_DECREF(tmp);
-        if (Tokenizer_emit_first_kwargs(self, TagAttrQuote, kwargs)) {
+        value = Tokenizer_pop(self);
+        if (!value) {
             return -1;
         }
-        tokens = Tokenizer_pop(self);
-        if (!tokens) {
-            return -1;
-        }
-        if (Tokenizer_emit_all(self, tokens)) {
-            Py_DECREF(tokens);
-            return -1;
-        }
-        Py_DECREF(tokens);
     }
-    pad_first = Textbuffer_render(data->pad_first);
-    pad_before_eq = Textbuffer_render(data->pad_before_eq);
-    pad_after_eq = Textbuffer_render(data->pad_after_eq);
-    if (!pad_first || !pad_before_eq || !pad_after_eq) {
-        return -1;
+    attr = Tokenizer_pop(self);
+    if (!attr) {
+        goto fail_value;
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        return -1;
-    }
-    PyDict_SetItemString(kwargs, "pad_first", pad_first);
-    PyDict_SetItemString(kwargs, "pad_before_eq", pad_before_eq);
-    PyDict_SetItemString(kwargs, "pad_after_eq", pad_after_eq);
+    pad_first = Tokenizer_render_padding(self, &data->pad_first);
+    pad_before_eq = Tokenizer_render_padding(self, &data->pad_before_eq);
+    pad_after_eq = Tokenizer_render_padding(self, &data->pad_after_eq);
+    if (!pad_first || !pad_before_eq || !pad_after_eq) {
+        Py_XDECREF(pad_first);
+        Py_XDECREF(pad_before_eq);
+        Py_XDECREF(pad_after_eq);
+        goto fail_attr;
+    }
+    retval = Tokenizer_emit_attrs(self,
+                                  TagAttrStart,
+                                  3,
+                                  KEY_PAD_FIRST,
+                                  pad_first,
+                                  KEY_PAD_BEFORE_EQ,
+                                  pad_before_eq,
+                                  KEY_PAD_AFTER_EQ,
+                                  pad_after_eq);
     Py_DECREF(pad_first);
     Py_DECREF(pad_before_eq);
     Py_DECREF(pad_after_eq);
-    if (Tokenizer_emit_first_kwargs(self, TagAttrStart, kwargs)) {
-        return -1;
-    }
-    tokens = Tokenizer_pop(self);
-    if (!tokens) {
-        return -1;
-    }
-    if (Tokenizer_emit_all(self, tokens)) {
-        Py_DECREF(tokens);
-        return -1;
+    if (retval || Tokenizer_emit_all(self, attr)) {
+        goto fail_attr;
     }
-    Py_DECREF(tokens);
-    if (TagData_reset_buffers(data)) {
-        return -1;
+    Py_DECREF(attr);
+    if (value) {
+        quoter = PyUnicode_FROM_SINGLE(data->quoter);
+        if (!quoter) {
+            goto fail_value;
+        }
+        retval = Tokenizer_emit_attrs(self, TagAttrQuote, 1, KEY_CHAR, quoter);
+        Py_DECREF(quoter);
+        if (retval || Tokenizer_emit_all(self, value)) {
+            goto fail_value;
+        }
+        Py_DECREF(value);
     }
+    TagData_reset_padding(data);
     return 0;
+
+fail_attr:
+    Py_DECREF(attr);
+fail_value:
+    Py_XDECREF(value);
+    return -1;
 }
 
 /*
@@ -1356,18 +1466,16 @@ Tokenizer_handle_tag_space(Tokenizer *self, TagData *data, Py_UCS4 text)
         data->context = TAG_ATTR_READY;
     } else if (ctx & TAG_ATTR_NAME) {
         data->context |= TAG_NOTE_EQUALS;
-        if (Textbuffer_write(data->pad_before_eq, text)) {
-            return -1;
-        }
+        Padding_extend(&data->pad_before_eq, self->head);
     }
     if (ctx & TAG_QUOTED && !(ctx & TAG_NOTE_SPACE)) {
         if (Tokenizer_emit_char(self, text)) {
             return -1;
         }
     } else if (data->context & TAG_ATTR_READY) {
-        return Textbuffer_write(data->pad_first, text);
+        Padding_extend(&data->pad_first, self->head);
     } else if (data->context & TAG_ATTR_VALUE) {
-        return Textbuffer_write(data->pad_after_eq, text);
+        Padding_extend(&data->pad_after_eq, self->head);
     }
     return 0;
 }
@@ -1482,25 +1590,21 @@ Tokenizer_handle_tag_data(Tokenizer *self, TagData *data, Py_UCS4 chunk)
 static int
 Tokenizer_handle_tag_close_open(Tokenizer *self, TagData *data, PyObject *cls)
 {
-    PyObject *padding, *kwargs;
+    PyObject *padding;
+    int retval;
 
     if (data->context & (TAG_ATTR_NAME | TAG_ATTR_VALUE)) {
         if (Tokenizer_push_tag_buffer(self, data)) {
             return -1;
         }
     }
-    padding = Textbuffer_render(data->pad_first);
+    padding = Tokenizer_render_padding(self, &data->pad_first);
     if (!padding) {
         return -1;
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        Py_DECREF(padding);
-        return -1;
-    }
-    PyDict_SetItemString(kwargs, "padding", padding);
+    retval = Tokenizer_emit_attrs(self, cls, 1, KEY_PADDING, padding);
     Py_DECREF(padding);
-    if (Tokenizer_emit_kwargs(self, cls, kwargs)) {
+    if (retval) {
         return -1;
     }
     self->head++;
@@ -1598,7 +1702,7 @@ Tokenizer_handle_blacklisted_tag(Tokenizer *self)
         } else if (this == '<' && next == '/') {
             self->head += 2;
             reset = self->head - 1;
-            buffer = Textbuffer_new(&self->text);
+            buffer = Textbuffer_new(&self->text, &self->memory.textbuffers);
             if (!buffer) {
                 return NULL;
             }
@@ -1664,26 +1768,22 @@ Tokenizer_handle_blacklisted_tag(Tokenizer *self)
 static PyObject *
 Tokenizer_handle_single_only_tag_end(Tokenizer *self)
 {
-    PyObject *top, *padding, *kwargs;
+    PyObject *top, *padding;
+    int retval;
 
     top = PyObject_CallMethod(self->topstack->stack, "pop", NULL);
     if (!top) {
         return NULL;
     }
-    padding = PyObject_GetAttrString(top, "padding");
+    padding = get_token_attr(top, KEY_PADDING);
     Py_DECREF(top);
     if (!padding) {
         return NULL;
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        Py_DECREF(padding);
-        return NULL;
-    }
-    PyDict_SetItemString(kwargs, "padding", padding);
-    PyDict_SetItemString(kwargs, "implicit", Py_True);
+    retval = Tokenizer_emit_attrs(
+        self, TagCloseSelfclose, 2, KEY_PADDING, padding, KEY_IMPLICIT, Py_True);
     Py_DECREF(padding);
-    if (Tokenizer_emit_kwargs(self, TagCloseSelfclose, kwargs)) {
+    if (retval) {
         return NULL;
     }
     self->head--; // Offset displacement done by handle_tag_close_open
@@ -1696,7 +1796,7 @@ Tokenizer_handle_single_only_tag_end(Tokenizer *self)
 static PyObject *
 Tokenizer_handle_single_tag_end(Tokenizer *self)
 {
-    PyObject *token = 0, *padding, *kwargs;
+    PyObject *token = 0, *padding;
     Py_ssize_t len, index;
     int depth = 1, is_instance;
 
@@ -1731,20 +1831,13 @@ Tokenizer_handle_single_tag_end(Tokenizer *self)
     if (!token || depth > 0) {
         return NULL;
     }
-    padding = PyObject_GetAttrString(token, "padding");
+    padding = get_token_attr(token, KEY_PADDING);
     if (!padding) {
         return NULL;
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        Py_DECREF(padding);
-        return NULL;
-    }
-    PyDict_SetItemString(kwargs, "padding", padding);
-    PyDict_SetItemString(kwargs, "implicit", Py_True);
+    token = make_token(
+        TagCloseSelfclose, 2, KEY_PADDING, padding, KEY_IMPLICIT, Py_True);
     Py_DECREF(padding);
-    token = PyObject_Call(TagCloseSelfclose, NOARGS, kwargs);
-    Py_DECREF(kwargs);
     if (!token) {
         return NULL;
     }
@@ -1761,23 +1854,19 @@ Tokenizer_handle_single_tag_end(Tokenizer *self)
 static PyObject *
 Tokenizer_really_parse_tag(Tokenizer *self)
 {
-    TagData *data = TagData_new(&self->text);
+    TagData tag_data, *data = &tag_data;
     PyObject *token, *text, *trash;
     Py_UCS4 this, next;
     int can_exit;
 
-    if (!data) {
-        return NULL;
-    }
+    TagData_init(data);
     if (Tokenizer_check_route(self, LC_TAG_OPEN) < 0) {
         return NULL;
     }
     if (Tokenizer_push(self, LC_TAG_OPEN)) {
-        TagData_dealloc(data);
         return NULL;
     }
     if (Tokenizer_emit(self, TagOpenOpen)) {
-        TagData_dealloc(data);
         return NULL;
     }
     while (1) {
@@ -1799,17 +1888,14 @@ Tokenizer_really_parse_tag(Tokenizer *self)
                 trash = Tokenizer_pop(self);
                 Py_XDECREF(trash);
             }
-            TagData_dealloc(data);
             return Tokenizer_fail_route(self);
         } else if (this == '>' && can_exit) {
             if (Tokenizer_handle_tag_close_open(self, data, TagCloseOpen)) {
-                TagData_dealloc(data);
                 return NULL;
             }
-            TagData_dealloc(data);
             self->topstack->context = LC_TAG_BODY;
             token = PyList_GET_ITEM(self->topstack->stack, 1);
-            text = PyObject_GetAttrString(token, "text");
+            text = get_token_attr(token, KEY_TEXT);
             if (!text) {
                 return NULL;
             }
@@ -1825,14 +1911,11 @@ Tokenizer_really_parse_tag(Tokenizer *self)
             return Tokenizer_handle_blacklisted_tag(self);
         } else if (this == '/' && next == '>' && can_exit) {
             if (Tokenizer_handle_tag_close_open(self, data, TagCloseSelfclose)) {
-                TagData_dealloc(data);
                 return NULL;
             }
-            TagData_dealloc(data);
             return Tokenizer_pop(self);
         } else {
             if (Tokenizer_handle_tag_data(self, data, this) || BAD_ROUTE) {
-                TagData_dealloc(data);
                 return NULL;
             }
         }
@@ -1852,7 +1935,7 @@ Tokenizer_handle_invalid_tag_start(Tokenizer *self)
     Py_UCS4 this;
 
     self->head += 2;
-    buf = Textbuffer_new(&self->text);
+    buf = Textbuffer_new(&self->text, &self->memory.textbuffers);
     if (!buf) {
         return -1;
     }
@@ -1885,7 +1968,7 @@ Tokenizer_handle_invalid_tag_start(Tokenizer *self)
         return -1;
     }
     // Set invalid=True flag of TagOpenOpen
-    if (PyObject_SetAttrString(PyList_GET_ITEM(tag, 0), "invalid", Py_True)) {
+    if (PyDict_SetItem(PyList_GET_ITEM(tag, 0), KEY_INVALID, Py_True)) {
         return -1;
     }
     if (Tokenizer_emit_all(self, tag)) {
@@ -1929,23 +2012,10 @@ Tokenizer_parse_tag(Tokenizer *self)
 static int
 Tokenizer_emit_style_tag(Tokenizer *self,
                          const char *tag,
-                         const char *ticks,
+                         PyObject *markup,
                          PyObject *body)
 {
-    PyObject *markup, *kwargs;
-
-    markup = PyUnicode_FromString(ticks);
-    if (!markup) {
-        return -1;
-    }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        Py_DECREF(markup);
-        return -1;
-    }
-    PyDict_SetItemString(kwargs, "wiki_markup", markup);
-    Py_DECREF(markup);
-    if (Tokenizer_emit_kwargs(self, TagOpenOpen, kwargs)) {
+    if (Tokenizer_emit_attrs(self, TagOpenOpen, 1, KEY_WIKI_MARKUP, markup)) {
         return -1;
     }
     if (Tokenizer_emit_text(self, tag)) {
@@ -1999,7 +2069,7 @@ Tokenizer_parse_italics(Tokenizer *self)
     if (!stack) {
         return -1;
     }
-    return Tokenizer_emit_style_tag(self, "i", "''", stack);
+    return Tokenizer_emit_style_tag(self, "i", MARKUP_ITALICS, stack);
 }
 
 /*
@@ -2030,7 +2100,7 @@ Tokenizer_parse_bold(Tokenizer *self)
     if (!stack) {
         return -1;
     }
-    return Tokenizer_emit_style_tag(self, "b", "'''", stack);
+    return Tokenizer_emit_style_tag(self, "b", MARKUP_BOLD, stack);
 }
 
 /*
@@ -2063,7 +2133,7 @@ Tokenizer_parse_italics_and_bold(Tokenizer *self)
             if (Tokenizer_emit_text(self, "'''")) {
                 return -1;
             }
-            return Tokenizer_emit_style_tag(self, "i", "''", stack);
+            return Tokenizer_emit_style_tag(self, "i", MARKUP_ITALICS, stack);
         }
         if (!stack2) {
             return -1;
@@ -2071,7 +2141,7 @@ Tokenizer_parse_italics_and_bold(Tokenizer *self)
         if (Tokenizer_push(self, 0)) {
             return -1;
         }
-        if (Tokenizer_emit_style_tag(self, "i", "''", stack)) {
+        if (Tokenizer_emit_style_tag(self, "i", MARKUP_ITALICS, stack)) {
             return -1;
         }
         if (Tokenizer_emit_all(self, stack2)) {
@@ -2082,7 +2152,7 @@ Tokenizer_parse_italics_and_bold(Tokenizer *self)
         if (!stack2) {
             return -1;
         }
-        return Tokenizer_emit_style_tag(self, "b", "'''", stack2);
+        return Tokenizer_emit_style_tag(self, "b", MARKUP_BOLD, stack2);
     }
     if (!stack) {
         return -1;
@@ -2095,7 +2165,7 @@ Tokenizer_parse_italics_and_bold(Tokenizer *self)
         if (Tokenizer_emit_text(self, "''")) {
             return -1;
         }
-        return Tokenizer_emit_style_tag(self, "b", "'''", stack);
+        return Tokenizer_emit_style_tag(self, "b", MARKUP_BOLD, stack);
     }
     if (!stack2) {
         return -1;
@@ -2103,7 +2173,7 @@ Tokenizer_parse_italics_and_bold(Tokenizer *self)
     if (Tokenizer_push(self, 0)) {
         return -1;
     }
-    if (Tokenizer_emit_style_tag(self, "b", "'''", stack)) {
+    if (Tokenizer_emit_style_tag(self, "b", MARKUP_BOLD, stack)) {
         return -1;
     }
     if (Tokenizer_emit_all(self, stack2)) {
@@ -2114,7 +2184,7 @@ Tokenizer_parse_italics_and_bold(Tokenizer *self)
     if (!stack2) {
         return -1;
     }
-    return Tokenizer_emit_style_tag(self, "i", "''", stack2);
+    return Tokenizer_emit_style_tag(self, "i", MARKUP_ITALICS, stack2);
 }
 
 /*
@@ -2193,23 +2263,19 @@ Tokenizer_parse_style(Tokenizer *self)
 static int
 Tokenizer_handle_list_marker(Tokenizer *self)
 {
-    PyObject *kwargs, *markup;
+    PyObject *markup;
     Py_UCS4 code = Tokenizer_read(self, 0);
+    int retval;
 
     if (code == ';') {
         self->topstack->context |= LC_DLTERM;
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        return -1;
-    }
     if (!(markup = PyUnicode_FROM_SINGLE(code))) {
-        Py_DECREF(kwargs);
         return -1;
     }
-    PyDict_SetItemString(kwargs, "wiki_markup", markup);
+    retval = Tokenizer_emit_attrs(self, TagOpenOpen, 1, KEY_WIKI_MARKUP, markup);
     Py_DECREF(markup);
-    if (Tokenizer_emit_kwargs(self, TagOpenOpen, kwargs)) {
+    if (retval) {
         return -1;
     }
     if (Tokenizer_emit_text(self, GET_HTML_TAG(code))) {
@@ -2248,9 +2314,9 @@ Tokenizer_handle_list(Tokenizer *self)
 static int
 Tokenizer_handle_hr(Tokenizer *self)
 {
-    PyObject *markup, *kwargs;
-    Textbuffer *buffer = Textbuffer_new(&self->text);
-    int i;
+    PyObject *markup;
+    Textbuffer *buffer = Textbuffer_new(&self->text, &self->memory.textbuffers);
+    int i, retval;
 
     if (!buffer) {
         return -1;
@@ -2272,13 +2338,9 @@ Tokenizer_handle_hr(Tokenizer *self)
     if (!markup) {
         return -1;
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        return -1;
-    }
-    PyDict_SetItemString(kwargs, "wiki_markup", markup);
+    retval = Tokenizer_emit_attrs(self, TagOpenOpen, 1, KEY_WIKI_MARKUP, markup);
     Py_DECREF(markup);
-    if (Tokenizer_emit_kwargs(self, TagOpenOpen, kwargs)) {
+    if (retval) {
         return -1;
     }
     if (Tokenizer_emit_text(self, "hr")) {
@@ -2304,33 +2366,24 @@ Tokenizer_handle_dl_term(Tokenizer *self)
 }
 
 /*
-    Emit a table tag.
+    Emit a table tag. The markup is one of the MARKUP_* constants, and
+    close_open_markup may be NULL. Steals references to style, padding, and
+    contents.
 */
 static int
 Tokenizer_emit_table_tag(Tokenizer *self,
-                         const char *open_open_markup,
+                         PyObject *open_open_markup,
                          const char *tag,
                          PyObject *style,
                          PyObject *padding,
-                         const char *close_open_markup,
+                         PyObject *close_open_markup,
                          PyObject *contents,
-                         const char *open_close_markup)
+                         PyObject *open_close_markup)
 {
-    PyObject *open_open_kwargs, *open_open_markup_unicode, *close_open_kwargs,
-        *close_open_markup_unicode, *open_close_kwargs, *open_close_markup_unicode;
+    int retval;
 
-    open_open_kwargs = PyDict_New();
-    if (!open_open_kwargs) {
-        goto fail_decref_all;
-    }
-    open_open_markup_unicode = PyUnicode_FromString(open_open_markup);
-    if (!open_open_markup_unicode) {
-        Py_DECREF(open_open_kwargs);
-        goto fail_decref_all;
-    }
-    PyDict_SetItemString(open_open_kwargs, "wiki_markup", open_open_markup_unicode);
-    Py_DECREF(open_open_markup_unicode);
-    if (Tokenizer_emit_kwargs(self, TagOpenOpen, open_open_kwargs)) {
+    if (Tokenizer_emit_attrs(
+            self, TagOpenOpen, 1, KEY_WIKI_MARKUP, open_open_markup)) {
         goto fail_decref_all;
     }
     if (Tokenizer_emit_text(self, tag)) {
@@ -2344,23 +2397,19 @@ Tokenizer_emit_table_tag(Tokenizer *self,
         Py_DECREF(style);
     }
 
-    close_open_kwargs = PyDict_New();
-    if (!close_open_kwargs) {
-        goto fail_decref_padding_contents;
-    }
-    if (close_open_markup && strlen(close_open_markup) != 0) {
-        close_open_markup_unicode = PyUnicode_FromString(close_open_markup);
-        if (!close_open_markup_unicode) {
-            Py_DECREF(close_open_kwargs);
-            goto fail_decref_padding_contents;
-        }
-        PyDict_SetItemString(
-            close_open_kwargs, "wiki_markup", close_open_markup_unicode);
-        Py_DECREF(close_open_markup_unicode);
+    if (close_open_markup) {
+        retval = Tokenizer_emit_attrs(self,
+                                      TagCloseOpen,
+                                      2,
+                                      KEY_WIKI_MARKUP,
+                                      close_open_markup,
+                                      KEY_PADDING,
+                                      padding);
+    } else {
+        retval = Tokenizer_emit_attrs(self, TagCloseOpen, 1, KEY_PADDING, padding);
     }
-    PyDict_SetItemString(close_open_kwargs, "padding", padding);
     Py_DECREF(padding);
-    if (Tokenizer_emit_kwargs(self, TagCloseOpen, close_open_kwargs)) {
+    if (retval) {
         goto fail_decref_contents;
     }
 
@@ -2371,18 +2420,8 @@ Tokenizer_emit_table_tag(Tokenizer *self,
         Py_DECREF(contents);
     }
 
-    open_close_kwargs = PyDict_New();
-    if (!open_close_kwargs) {
-        return -1;
-    }
-    open_close_markup_unicode = PyUnicode_FromString(open_close_markup);
-    if (!open_close_markup_unicode) {
-        Py_DECREF(open_close_kwargs);
-        return -1;
-    }
-    PyDict_SetItemString(open_close_kwargs, "wiki_markup", open_close_markup_unicode);
-    Py_DECREF(open_close_markup_unicode);
-    if (Tokenizer_emit_kwargs(self, TagOpenClose, open_close_kwargs)) {
+    if (Tokenizer_emit_attrs(
+            self, TagOpenClose, 1, KEY_WIKI_MARKUP, open_close_markup)) {
         return -1;
     }
     if (Tokenizer_emit_text(self, tag)) {
@@ -2395,10 +2434,9 @@ Tokenizer_emit_table_tag(Tokenizer *self,
 
 fail_decref_all:
     Py_XDECREF(style);
-fail_decref_padding_contents:
     Py_DECREF(padding);
 fail_decref_contents:
-    Py_DECREF(contents);
+    Py_XDECREF(contents);
     return -1;
 }
 
@@ -2408,14 +2446,12 @@ fail_decref_contents:
 static PyObject *
 Tokenizer_handle_table_style(Tokenizer *self, Py_UCS4 end_token)
 {
-    TagData *data = TagData_new(&self->text);
-    PyObject *padding, *trash;
+    TagData tag_data, *data = &tag_data;
+    PyObject *trash;
     Py_UCS4 this;
     int can_exit;
 
-    if (!data) {
-        return NULL;
-    }
+    TagData_init(data);
     data->context = TAG_ATTR_READY;
 
     while (1) {
@@ -2424,19 +2460,14 @@ Tokenizer_handle_table_style(Tokenizer *self, Py_UCS4 end_token)
         if (this == end_token && can_exit) {
             if (data->context & (TAG_ATTR_NAME | TAG_ATTR_VALUE)) {
                 if (Tokenizer_push_tag_buffer(self, data)) {
-                    TagData_dealloc(data);
                     return NULL;
                 }
             }
             if (Py_UNICODE_ISSPACE(this)) {
-                Textbuffer_write(data->pad_first, this);
+                Padding_extend(&data->pad_first, self->head);
             }
-            padding = Textbuffer_render(data->pad_first);
-            TagData_dealloc(data);
-            if (!padding) {
-                return NULL;
-            }
-            return padding;
+            return Tokenizer_render_slice(
+                self, data->pad_first.start, data->pad_first.end);
         } else if (!this || this == end_token) {
             if (self->topstack->context & LC_TAG_ATTR) {
                 if (data->context & TAG_QUOTED) {
@@ -2451,11 +2482,9 @@ Tokenizer_handle_table_style(Tokenizer *self, Py_UCS4 end_token)
                 trash = Tokenizer_pop(self);
                 Py_XDECREF(trash);
             }
-            TagData_dealloc(data);
             return Tokenizer_fail_route(self);
         } else {
             if (Tokenizer_handle_tag_data(self, data, this) || BAD_ROUTE) {
-                TagData_dealloc(data);
                 return NULL;
             }
         }
@@ -2524,8 +2553,14 @@ Tokenizer_parse_table(Tokenizer *self)
         return -1;
     }
 
-    if (Tokenizer_emit_table_tag(
-            self, "{|", "table", style, padding, NULL, table, "|}")) {
+    if (Tokenizer_emit_table_tag(self,
+                                 MARKUP_TABLE_OPEN,
+                                 "table",
+                                 style,
+                                 padding,
+                                 NULL,
+                                 table,
+                                 MARKUP_TABLE_CLOSE)) {
         return -1;
     }
     // Offset displacement done by _parse()
@@ -2578,7 +2613,8 @@ Tokenizer_handle_table_row(Tokenizer *self)
         return -1;
     }
 
-    if (Tokenizer_emit_table_tag(self, "|-", "tr", style, padding, NULL, row, "")) {
+    if (Tokenizer_emit_table_tag(
+            self, MARKUP_TABLE_ROW, "tr", style, padding, NULL, row, EMPTY)) {
         return -1;
     }
     // Offset displacement done by _parse()
@@ -2592,21 +2628,20 @@ Tokenizer_handle_table_row(Tokenizer *self)
 */
 static int
 Tokenizer_handle_table_cell(Tokenizer *self,
-                            const char *markup,
+                            PyObject *markup,
                             const char *tag,
                             uint64_t line_context)
 {
     uint64_t old_context = self->topstack->context;
     uint64_t cell_context;
     Py_ssize_t reset;
-    PyObject *padding, *cell, *style = NULL;
-    const char *close_open_markup = NULL;
+    PyObject *padding, *cell, *style = NULL, *close_open_markup = NULL;
 
-    self->head += strlen(markup);
+    self->head += PyUnicode_GET_LENGTH(markup);
     reset = self->head;
 
     if (!Tokenizer_CAN_RECURSE(self)) {
-        if (Tokenizer_emit_text(self, markup)) {
+        if (Tokenizer_emit_text(self, PyUnicode_AsUTF8(markup))) {
             return -1;
         }
         self->head--;
@@ -2650,18 +2685,15 @@ Tokenizer_handle_table_cell(Tokenizer *self,
         cell_context = self->topstack->context;
         self->topstack->context = old_context;
     } else {
-        padding = PyUnicode_FromString("");
-        if (!padding) {
-            Py_DECREF(cell);
-            return -1;
-        }
+        padding = EMPTY;
+        Py_INCREF(padding);
     }
 
     if (style) {
-        close_open_markup = "|";
+        close_open_markup = MARKUP_TABLE_CELL;
     }
     if (Tokenizer_emit_table_tag(
-            self, markup, tag, style, padding, close_open_markup, cell, "")) {
+            self, markup, tag, style, padding, close_open_markup, cell, EMPTY)) {
         return -1;
     }
     // Keep header/cell line contexts
@@ -2717,7 +2749,7 @@ Tokenizer_handle_end(Tokenizer *self, uint64_t context)
     if (context & AGG_FAIL) {
         if (context & LC_TAG_BODY) {
             token = PyList_GET_ITEM(self->topstack->stack, 1);
-            text = PyObject_GetAttrString(token, "text");
+            text = get_token_attr(token, KEY_TEXT);
             if (!text) {
                 return NULL;
             }
@@ -2869,6 +2901,14 @@ Tokenizer_parse(Tokenizer *self, uint64_t context, int push)
         }
     }
     while (1) {
+        if (self->checkpoints && self->depth == 1) {
+            switch (Tokenizer_checkpoint(self)) {
+            case -1:
+                return NULL;
+            case 1:
+                return Tokenizer_pop(self);
+            }
+        }
         this = Tokenizer_read(self, 0);
         this_context = self->topstack->context;
         if (this_context & AGG_UNSAFE) {
@@ -2896,7 +2936,11 @@ Tokenizer_parse(Tokenizer *self, uint64_t context, int push)
         next = Tokenizer_read(self, 1);
         last = Tokenizer_read_backwards(self, 1);
         if (this == next && next == '{') {
-            if (Tokenizer_CAN_RECURSE(self)) {
+            if (Tokenizer_IS_SHALLOW(self)) {
+                if (Tokenizer_emit_raw_construct(self, '{', '}', 3)) {
+                    return NULL;
+                }
+            } else if (Tokenizer_CAN_RECURSE(self)) {
                 if (Tokenizer_parse_template_or_argument(self)) {
                     return NULL;
                 }
@@ -2934,11 +2978,15 @@ Tokenizer_parse(Tokenizer *self, uint64_t context, int push)
             // if (this_context & LC_WIKILINK_TEXT) {
             //     return Tokenizer_fail_route(self);
             // }
-            if (!(this_context & AGG_NO_WIKILINKS)) {
-                if (Tokenizer_parse_wikilink(self)) {
+            if (this_context & AGG_NO_WIKILINKS) {
+                if (Tokenizer_emit_char(self, this)) {
                     return NULL;
                 }
-            } else if (Tokenizer_emit_char(self, this)) {
+            } else if (Tokenizer_IS_SHALLOW(self)) {
+                if (Tokenizer_emit_raw_construct(self, '[', ']', 2)) {
+                    return NULL;
+                }
+            } else if (Tokenizer_parse_wikilink(self)) {
                 return NULL;
             }
         } else if (this == '|' && this_context & LC_WIKILINK_TITLE) {
@@ -3037,22 +3085,28 @@ Tokenizer_parse(Tokenizer *self, uint64_t context, int push)
             if (this == '|' && next == '|' && this_context & LC_TABLE_TD_LINE) {
                 if (this_context & LC_TABLE_CELL_OPEN) {
                     return Tokenizer_handle_table_cell_end(self, 0);
-                } else if (Tokenizer_handle_table_cell(
-                               self, "||", "td", LC_TABLE_TD_LINE)) {
+                } else if (Tokenizer_handle_table_cell(self,
+                                                       MARKUP_TABLE_CELL_INLINE,
+                                                       "td",
+                                                       LC_TABLE_TD_LINE)) {
                     return NULL;
                 }
             } else if (this == '|' && next == '|' && this_context & LC_TABLE_TH_LINE) {
                 if (this_context & LC_TABLE_CELL_OPEN) {
                     return Tokenizer_handle_table_cell_end(self, 0);
-                } else if (Tokenizer_handle_table_cell(
-                               self, "||", "th", LC_TABLE_TH_LINE)) {
+                } else if (Tokenizer_handle_table_cell(self,
+                                                       MARKUP_TABLE_CELL_INLINE,
+                                                       "th",
+                                                       LC_TABLE_TH_LINE)) {
                     return NULL;
                 }
             } else if (this == '!' && next == '!' && this_context & LC_TABLE_TH_LINE) {
                 if (this_context & LC_TABLE_CELL_OPEN) {
                     return Tokenizer_handle_table_cell_end(self, 0);
-                } else if (Tokenizer_handle_table_cell(
-                               self, "!!", "th", LC_TABLE_TH_LINE)) {
+                } else if (Tokenizer_handle_table_cell(self,
+                                                       MARKUP_TABLE_HEADER_INLINE,
+                                                       "th",
+                                                       LC_TABLE_TH_LINE)) {
                     return NULL;
                 }
             } else if (this == '|' && this_context & LC_TABLE_CELL_STYLE) {
@@ -3087,14 +3141,14 @@ Tokenizer_parse(Tokenizer *self, uint64_t context, int push)
                     if (this_context & LC_TABLE_CELL_OPEN) {
                         return Tokenizer_handle_table_cell_end(self, 0);
                     } else if (Tokenizer_handle_table_cell(
-                                   self, "|", "td", LC_TABLE_TD_LINE)) {
+                                   self, MARKUP_TABLE_CELL, "td", LC_TABLE_TD_LINE)) {
                         return NULL;
                     }
                 } else if (this == '!') {
                     if (this_context & LC_TABLE_CELL_OPEN) {
                         return Tokenizer_handle_table_cell_end(self, 0);
                     } else if (Tokenizer_handle_table_cell(
-                                   self, "!", "th", LC_TABLE_TH_LINE)) {
+                                   self, MARKUP_TABLE_HEADER, "th", LC_TABLE_TH_LINE)) {
                         return NULL;
                     }
                 } else if (Tokenizer_emit_char(self, this)) {
@@ -33,4 +33,5 @@ static const Py_UCS4 MARKERS[] = {
 
 /* Functions */
 
+int is_marker(Py_UCS4);
 PyObject *Tokenizer_parse(Tokenizer *, uint64_t, int);
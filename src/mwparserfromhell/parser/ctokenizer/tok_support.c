@@ -21,9 +21,24 @@ SOFTWARE.
 */
 
 #include "tok_support.h"
+#include "probes.h"
 #include "textbuffer.h"
 #include "tokens.h"
 
+/*
+    Update the bytes counted for a stack frame and its token list. Lists only
+    grow while tokenizing, so this is called when frames are pushed and popped.
+*/
+static void
+count_stack_memory(Tokenizer *self, Stack *stack)
+{
+    Py_ssize_t size = sizeof(Stack) + sizeof(PyListObject) +
+                      ((PyListObject *) stack->stack)->allocated * sizeof(PyObject *);
+
+    memory_add(&self->memory.stacks, size - stack->memory);
+    stack->memory = size;
+}
+
 /*
     Add a new token stack, context, and textbuffer to the list.
 */
@@ -36,9 +51,14 @@ Tokenizer_push(Tokenizer *self, uint64_t context)
         PyErr_NoMemory();
         return -1;
     }
+    if (self->topstack) {
+        count_stack_memory(self, self->topstack);
+    }
     top->stack = PyList_New(0);
+    top->memory = 0;
+    count_stack_memory(self, top);
     top->context = context;
-    top->textbuffer = Textbuffer_new(&self->text);
+    top->textbuffer = Textbuffer_new(&self->text, &self->memory.textbuffers);
     if (!top->textbuffer) {
         return -1;
     }
@@ -47,34 +67,68 @@ Tokenizer_push(Tokenizer *self, uint64_t context)
     top->next = self->topstack;
     self->topstack = top;
     self->depth++;
+    PROBE_STACK_PUSH(self->head, self->depth);
     return 0;
 }
 
+/*
+    Render a textbuffer as a Python Unicode object, like Textbuffer_render().
+
+    Short strings are interned in the tokenizer's table, so identical ones
+    share the same object.
+*/
+PyObject *
+Tokenizer_render(Tokenizer *self, Textbuffer *buffer)
+{
+    PyObject *text, *shared;
+
+    text = Textbuffer_render(buffer);
+    if (!text || !self->interned || buffer->length > MAX_INTERN_LENGTH) {
+        return text;
+    }
+    shared = PyDict_SetDefault(self->interned, text, text);
+    Py_XINCREF(shared);
+    Py_DECREF(text);
+    return shared;
+}
+
+/*
+    Render the input text between two indices as a Python Unicode object,
+    interning it like Tokenizer_render().
+*/
+PyObject *
+Tokenizer_render_slice(Tokenizer *self, Py_ssize_t start, Py_ssize_t end)
+{
+    PyObject *text, *shared;
+
+    text = PyUnicode_Substring(self->text.object, start, end);
+    if (!text || !self->interned || end - start > MAX_INTERN_LENGTH) {
+        return text;
+    }
+    shared = PyDict_SetDefault(self->interned, text, text);
+    Py_XINCREF(shared);
+    Py_DECREF(text);
+    return shared;
+}
+
 /*
     Push the textbuffer onto the stack as a Text node and clear it.
 */
 int
 Tokenizer_push_textbuffer(Tokenizer *self)
 {
-    PyObject *text, *kwargs, *token;
+    PyObject *text, *token;
     Textbuffer *buffer = self->topstack->textbuffer;
 
     if (buffer->length == 0) {
         return 0;
     }
-    text = Textbuffer_render(buffer);
+    text = Tokenizer_render(self, buffer);
     if (!text) {
         return -1;
     }
-    kwargs = PyDict_New();
-    if (!kwargs) {
-        Py_DECREF(text);
-        return -1;
-    }
-    PyDict_SetItemString(kwargs, "text", text);
+    token = make_token(Text, 1, KEY_TEXT, text);
     Py_DECREF(text);
-    token = PyObject_Call(Text, NOARGS, kwargs);
-    Py_DECREF(kwargs);
     if (!token) {
         return -1;
     }
@@ -97,11 +151,14 @@ Tokenizer_delete_top_of_stack(Tokenizer *self)
 {
     Stack *top = self->topstack;
 
+    count_stack_memory(self, top);
+    memory_add(&self->memory.stacks, -top->memory);
     Py_DECREF(top->stack);
     Textbuffer_dealloc(top->textbuffer);
     self->topstack = top->next;
     free(top);
     self->depth--;
+    PROBE_STACK_POP(self->head, self->depth);
 }
 
 /*
@@ -170,10 +227,15 @@ void
 Tokenizer_memoize_bad_route(Tokenizer *self)
 {
     route_tree_node *node = malloc(sizeof(route_tree_node));
+    if (self->topstack->ident.head > self->route_max) {
+        self->route_max = self->topstack->ident.head;
+    }
     if (node) {
         node->id = self->topstack->ident;
         if (avl_tree_insert(&self->bad_routes, &node->node, compare_nodes)) {
             free(node);
+        } else {
+            memory_add(&self->memory.routes, sizeof(route_tree_node));
         }
     }
 }
@@ -190,6 +252,7 @@ Tokenizer_fail_route(Tokenizer *self)
     uint64_t context = self->topstack->context;
     PyObject *stack;
 
+    PROBE_ROUTE_FAIL(self->head, context);
     Tokenizer_memoize_bad_route(self);
     stack = Tokenizer_pop(self);
     Py_XDECREF(stack);
@@ -239,6 +302,7 @@ Tokenizer_free_bad_route_tree(Tokenizer *self)
         cur = avl_tree_next_in_postorder(cur, parent);
     }
     self->bad_routes = NULL;
+    memory_add(&self->memory.routes, -self->memory.routes.current);
 }
 
 /*
@@ -266,34 +330,22 @@ Tokenizer_emit_token(Tokenizer *self, PyObject *token, int first)
 }
 
 /*
-    Write a token to the current token stack, with kwargs. Steals a reference
-    to kwargs.
+    Write a new token object to the current token stack, stealing a reference
+    to it. If the token is NULL because creating it failed, just return -1, so
+    this can be called with the result of make_token() directly.
 */
 int
-Tokenizer_emit_token_kwargs(Tokenizer *self,
-                            PyObject *token,
-                            PyObject *kwargs,
-                            int first)
+Tokenizer_emit_new_token(Tokenizer *self, PyObject *token)
 {
-    PyObject *instance;
-
-    if (Tokenizer_push_textbuffer(self)) {
-        Py_DECREF(kwargs);
-        return -1;
-    }
-    instance = PyObject_Call(token, NOARGS, kwargs);
-    if (!instance) {
-        Py_DECREF(kwargs);
+    if (!token) {
         return -1;
     }
-    if (first ? PyList_Insert(self->topstack->stack, 0, instance)
-              : PyList_Append(self->topstack->stack, instance)) {
-        Py_DECREF(instance);
-        Py_DECREF(kwargs);
+    if (Tokenizer_push_textbuffer(self) ||
+        PyList_Append(self->topstack->stack, token)) {
+        Py_DECREF(token);
         return -1;
     }
-    Py_DECREF(instance);
-    Py_DECREF(kwargs);
+    Py_DECREF(token);
     return 0;
 }
 
@@ -337,12 +389,17 @@ Tokenizer_emit_textbuffer(Tokenizer *self, Textbuffer *buffer)
 
 /*
     Write a series of tokens to the current stack at once.
+
+    If the first token is Text, the contents of the textbuffer are merged into
+    it: its text is written to the end of the textbuffer, which is then
+    rendered once, instead of rendering the textbuffer and concatenating the
+    two strings.
 */
 int
 Tokenizer_emit_all(Tokenizer *self, PyObject *tokenlist)
 {
     int pushed = 0;
-    PyObject *stack, *token, *left, *right, *text;
+    PyObject *stack, *token, *text;
     Textbuffer *buffer;
     Py_ssize_t size;
 
@@ -357,21 +414,20 @@ Tokenizer_emit_all(Tokenizer *self, PyObject *tokenlist)
             if (buffer->length == 0) {
                 break;
             }
-            left = Textbuffer_render(buffer);
-            if (!left) {
+            text = get_token_attr(token, KEY_TEXT);
+            if (!text) {
                 return -1;
             }
-            right = PyObject_GetAttrString(token, "text");
-            if (!right) {
+            if (Textbuffer_write_string(buffer, text)) {
+                Py_DECREF(text);
                 return -1;
             }
-            text = PyUnicode_Concat(left, right);
-            Py_DECREF(left);
-            Py_DECREF(right);
+            Py_DECREF(text);
+            text = Tokenizer_render(self, buffer);
             if (!text) {
                 return -1;
             }
-            if (PyObject_SetAttrString(token, "text", text)) {
+            if (PyDict_SetItem(token, KEY_TEXT, text)) {
                 Py_DECREF(text);
                 return -1;
             }
@@ -441,6 +497,9 @@ Tokenizer_read(Tokenizer *self, Py_ssize_t delta)
 {
     Py_ssize_t index = self->head + delta;
 
+    if (index > self->max_read) {
+        self->max_read = index;
+    }
     if (index >= self->text.length) {
         return '\0';
     }
@@ -461,3 +520,107 @@ Tokenizer_read_backwards(Tokenizer *self, Py_ssize_t delta)
     index = self->head - delta;
     return read_codepoint(&self->text, index);
 }
+
+/*
+    Return whether the root stack's state matches the given stop.
+
+    A stop is a tuple of (position, context, global context, textbuffer
+    length, source), where the first textbuffer length characters of source
+    must equal the textbuffer's contents.
+*/
+static int
+Tokenizer_matches_stop(Tokenizer *self, PyObject *stop)
+{
+    Textbuffer *buffer = self->topstack->textbuffer;
+    PyObject *pending;
+    unsigned long long context;
+    int global, result;
+    Py_ssize_t position, length;
+    PyObject *source;
+
+    if (!PyArg_ParseTuple(
+            stop, "nKinO", &position, &context, &global, &length, &source)) {
+        return -1;
+    }
+    if (context != self->topstack->context || global != self->global ||
+        length != buffer->length) {
+        return 0;
+    }
+    if (length == 0) {
+        return 1;
+    }
+    pending = Textbuffer_render(buffer);
+    if (!pending) {
+        return -1;
+    }
+    result = PyUnicode_Tailmatch(source, pending, 0, length, -1);
+    Py_DECREF(pending);
+    return result;
+}
+
+/*
+    Record a checkpoint if the head is at the start of a line in the root
+    stack, and check whether we have reached one of the stops. Positions where
+    routes ahead are already known to fail are skipped, since what follows
+    depends on more than the checkpoint's state.
+
+    Return 1 if tokenizing should stop here (the textbuffer is discarded), 0 if
+    it should continue, and -1 on error.
+*/
+int
+Tokenizer_checkpoint(Tokenizer *self)
+{
+    Textbuffer *buffer = self->topstack->textbuffer;
+    PyObject *checkpoint, *stop;
+    Py_ssize_t nstops, position;
+    int result;
+
+    if (self->head <= self->start || self->head > self->text.length ||
+        self->route_max >= self->head ||
+        Tokenizer_read_backwards(self, 1) != '\n') {
+        return 0;
+    }
+    checkpoint = Py_BuildValue("(nnKinn)",
+                               self->head,
+                               PyList_GET_SIZE(self->topstack->stack),
+                               (unsigned long long) self->topstack->context,
+                               self->global,
+                               buffer->length,
+                               self->max_read);
+    if (!checkpoint) {
+        return -1;
+    }
+    result = PyList_Append(self->checkpoints, checkpoint);
+    Py_DECREF(checkpoint);
+    if (result < 0 || !self->stops) {
+        return result;
+    }
+
+    nstops = PyList_GET_SIZE(self->stops);
+    while (self->next_stop < nstops) {
+        stop = PyList_GET_ITEM(self->stops, self->next_stop);
+        if (!PyTuple_Check(stop) || PyTuple_GET_SIZE(stop) < 1) {
+            PyErr_SetString(PyExc_TypeError, "stops must be a list of tuples");
+            return -1;
+        }
+        position = PyLong_AsSsize_t(PyTuple_GET_ITEM(stop, 0));
+        if (position == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        if (position > self->head) {
+            return 0;
+        }
+        self->next_stop++;
+        if (position == self->head) {
+            result = Tokenizer_matches_stop(self, stop);
+            if (result == 1) {
+                self->stopped = 1;
+                if (Textbuffer_reset(buffer)) {
+                    return -1;
+                }
+            }
+            return result;
+        }
+    }
+    return 0;
+}
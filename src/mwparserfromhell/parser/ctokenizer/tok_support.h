@@ -28,6 +28,8 @@ SOFTWARE.
 
 int Tokenizer_push(Tokenizer *, uint64_t);
 int Tokenizer_push_textbuffer(Tokenizer *);
+PyObject *Tokenizer_render(Tokenizer *, Textbuffer *);
+PyObject *Tokenizer_render_slice(Tokenizer *, Py_ssize_t, Py_ssize_t);
 void Tokenizer_delete_top_of_stack(Tokenizer *);
 PyObject *Tokenizer_pop(Tokenizer *);
 PyObject *Tokenizer_pop_keeping_context(Tokenizer *);
@@ -37,7 +39,7 @@ int Tokenizer_check_route(Tokenizer *, uint64_t);
 void Tokenizer_free_bad_route_tree(Tokenizer *);
 
 int Tokenizer_emit_token(Tokenizer *, PyObject *, int);
-int Tokenizer_emit_token_kwargs(Tokenizer *, PyObject *, PyObject *, int);
+int Tokenizer_emit_new_token(Tokenizer *, PyObject *);
 int Tokenizer_emit_char(Tokenizer *, Py_UCS4);
 int Tokenizer_emit_text(Tokenizer *, const char *);
 int Tokenizer_emit_textbuffer(Tokenizer *, Textbuffer *);
@@ -47,17 +49,21 @@ int Tokenizer_emit_text_then_stack(Tokenizer *, const char *);
 Py_UCS4 Tokenizer_read(Tokenizer *, Py_ssize_t);
 Py_UCS4 Tokenizer_read_backwards(Tokenizer *, Py_ssize_t);
 
+int Tokenizer_checkpoint(Tokenizer *);
+
 /* Macros */
 
 #define MAX_DEPTH                   40
+#define MAX_INTERN_LENGTH           64
+#define MAX_INTERN_ENTRIES          65536
 #define Tokenizer_CAN_RECURSE(self) (self->depth < MAX_DEPTH)
+#define Tokenizer_IS_SHALLOW(self)                                                     \
+    (self->max_parse_depth >= 0 && self->construct_depth >= self->max_parse_depth)
 #define Tokenizer_IS_CURRENT_STACK(self, id)                                           \
     (self->topstack->ident.head == (id).head &&                                        \
      self->topstack->ident.context == (id).context)
 
 #define Tokenizer_emit(self, token)       Tokenizer_emit_token(self, token, 0)
 #define Tokenizer_emit_first(self, token) Tokenizer_emit_token(self, token, 1)
-#define Tokenizer_emit_kwargs(self, token, kwargs)                                     \
-    Tokenizer_emit_token_kwargs(self, token, kwargs, 0)
-#define Tokenizer_emit_first_kwargs(self, token, kwargs)                               \
-    Tokenizer_emit_token_kwargs(self, token, kwargs, 1)
+#define Tokenizer_emit_attrs(self, token, ...)                                         \
+    Tokenizer_emit_new_token(self, make_token(token, __VA_ARGS__))
@@ -21,25 +21,25 @@ SOFTWARE.
 */
 
 #include "tokenizer.h"
+#include "probes.h"
 #include "tok_parse.h"
 #include "tok_support.h"
 #include "tokens.h"
+#include "views.h"
 
 /* Globals */
 
 int route_state;
 uint64_t route_context;
 
-char **entitydefs;
-
 PyObject *NOARGS;
-PyObject *definitions;
 
 static PyObject *ParserError;
 
 /* Forward declarations */
 
 static int load_exceptions(void);
+static int load_tokens(void);
 
 /*
     Create a new tokenizer object.
@@ -68,6 +68,7 @@ Tokenizer_dealloc(Tokenizer *self)
 {
     Stack *this = self->topstack, *next;
     dealloc_tokenizer_text(&self->text);
+    Py_XDECREF(self->interned);
 
     while (this) {
         Py_DECREF(this->stack);
@@ -92,23 +93,51 @@ init_tokenizer_text(TokenizerInput *text)
     text->data = NULL;
 }
 
+/*
+    Clear the tokenizer's memory counters before tokenizing.
+*/
+static void
+reset_memory_stats(MemoryStats *memory)
+{
+    memset(memory, 0, sizeof(MemoryStats));
+    memory->stacks.parent = &memory->total;
+    memory->textbuffers.parent = &memory->total;
+    memory->routes.parent = &memory->total;
+}
+
 /*
     Initialize a new tokenizer instance by setting instance attributes.
+
+    If keep_interned is true, the table of interned strings is kept between
+    calls to tokenize(), so strings are shared between the tokens of every
+    page parsed with the same tokenizer.
 */
 static int
 Tokenizer_init(Tokenizer *self, PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {NULL};
+    static char *kwlist[] = {"keep_interned", NULL};
+    int keep_interned = 0;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &keep_interned)) {
+        return -1;
+    }
+    if (!Text && load_tokens() < 0) {
         return -1;
     }
     init_tokenizer_text(&self->text);
     self->topstack = NULL;
-    self->head = self->global = self->depth = 0;
+    self->head = self->global = self->depth = self->construct_depth = 0;
+    self->max_parse_depth = -1;
     self->route_context = self->route_state = 0;
     self->bad_routes = NULL;
-    self->skip_style_tags = 0;
+    self->skip_style_tags = self->drop_comments = 0;
+    self->max_read = self->start = self->next_stop = 0;
+    self->route_max = -1;
+    self->checkpoints = self->stops = NULL;
+    self->stopped = 0;
+    Py_CLEAR(self->interned);
+    self->keep_interned = keep_interned;
+    reset_memory_stats(&self->memory);
     return 0;
 }
 
@@ -131,46 +160,38 @@ load_tokenizer_text(TokenizerInput *text, PyObject *input)
 }
 
 /*
-    Build a list of tokens from a string of wikicode and return it.
+    Prepare the table of interned strings before tokenizing.
 */
-static PyObject *
-Tokenizer_tokenize(Tokenizer *self, PyObject *args)
+static int
+start_interning(Tokenizer *self)
 {
-    PyObject *input, *tokens;
-    unsigned long long context = 0;
-    int skip_style_tags = 0;
-
-    if (PyArg_ParseTuple(args, "U|Kp", &input, &context, &skip_style_tags)) {
-        Py_INCREF(input);
-        if (load_tokenizer_text(&self->text, input)) {
-            return NULL;
-        }
-    } else {
-        const char *encoded;
-        Py_ssize_t size;
-
-        /* Failed to parse a Unicode object; try a string instead. */
-        PyErr_Clear();
-        if (!PyArg_ParseTuple(
-                args, "s#|Kp", &encoded, &size, &context, &skip_style_tags)) {
-            return NULL;
-        }
-        if (!(input = PyUnicode_FromStringAndSize(encoded, size))) {
-            return NULL;
-        }
-        if (load_tokenizer_text(&self->text, input)) {
-            return NULL;
-        }
+    if (self->interned && PyDict_GET_SIZE(self->interned) >= MAX_INTERN_ENTRIES) {
+        PyDict_Clear(self->interned);
     }
+    if (!self->interned && !(self->interned = PyDict_New())) {
+        return -1;
+    }
+    return 0;
+}
 
-    self->head = self->global = self->depth = 0;
-    self->skip_style_tags = skip_style_tags;
-    self->bad_routes = NULL;
-
-    tokens = Tokenizer_parse(self, context, 1);
-
-    Tokenizer_free_bad_route_tree(self);
+/*
+    Release the table of interned strings after tokenizing, unless we keep it.
+*/
+static void
+finish_interning(Tokenizer *self)
+{
+    if (!self->keep_interned) {
+        Py_CLEAR(self->interned);
+    }
+}
 
+/*
+    Check the result of a call to Tokenizer_parse() from the top level,
+    setting an exception if it failed or left the tokenizer in a bad state.
+*/
+static PyObject *
+check_tokens(Tokenizer *self, PyObject *tokens)
+{
     if (!tokens || self->topstack) {
         Py_XDECREF(tokens);
         if (PyErr_Occurred()) {
@@ -193,46 +214,239 @@ Tokenizer_tokenize(Tokenizer *self, PyObject *args)
     return tokens;
 }
 
+/*
+    Convert the max_parse_depth argument of tokenize() into an int, which is -1
+    if it is None. Return 0 on success and -1 (with an exception set) if it is
+    invalid.
+*/
 static int
-load_entities(void)
+get_max_parse_depth(PyObject *value, int *depth)
 {
-    PyObject *tempmod, *defmap, *deflist;
-    unsigned numdefs, i;
-    PyObject *string;
+    long result;
 
-    tempmod = PyImport_ImportModule("html.entities");
-    if (!tempmod) {
-        return -1;
+    if (!value || value == Py_None) {
+        *depth = -1;
+        return 0;
     }
-    defmap = PyObject_GetAttrString(tempmod, "entitydefs");
-    if (!defmap) {
+    result = PyLong_AsLong(value);
+    if (result == -1 && PyErr_Occurred()) {
         return -1;
     }
-    Py_DECREF(tempmod);
-    deflist = PyDict_Keys(defmap);
-    if (!deflist) {
-        return -1;
-    }
-    Py_DECREF(defmap);
-    numdefs = (unsigned) PyList_GET_SIZE(deflist);
-    entitydefs = calloc(numdefs + 1, sizeof(char *));
-    if (!entitydefs) {
+    if (result < 0) {
+        PyErr_SetString(PyExc_ValueError, "max_parse_depth must be at least 0");
         return -1;
     }
-    for (i = 0; i < numdefs; i++) {
-        string = PyUnicode_AsASCIIString(PyList_GET_ITEM(deflist, i));
-        if (!string) {
-            return -1;
+    *depth = result > INT_MAX ? INT_MAX : (int) result;
+    return 0;
+}
+
+/*
+    Build a list of tokens from a string of wikicode and return it.
+*/
+static PyObject *
+Tokenizer_tokenize(Tokenizer *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"text",
+                             "context",
+                             "skip_style_tags",
+                             "drop_comments",
+                             "view",
+                             "max_parse_depth",
+                             NULL};
+    PyObject *input, *selected, *tokens, *max_parse_depth = NULL;
+    unsigned long long context = 0;
+    int skip_style_tags = 0, drop_comments = 0, view;
+    const char *view_name = NULL;
+
+    if (PyArg_ParseTupleAndKeywords(args,
+                                    kwds,
+                                    "U|KppzO",
+                                    kwlist,
+                                    &input,
+                                    &context,
+                                    &skip_style_tags,
+                                    &drop_comments,
+                                    &view_name,
+                                    &max_parse_depth)) {
+        Py_INCREF(input);
+    } else {
+        const char *encoded;
+        Py_ssize_t size;
+
+        /* Failed to parse a Unicode object; try a string instead. */
+        PyErr_Clear();
+        if (!PyArg_ParseTupleAndKeywords(args,
+                                         kwds,
+                                         "s#|KppzO",
+                                         kwlist,
+                                         &encoded,
+                                         &size,
+                                         &context,
+                                         &skip_style_tags,
+                                         &drop_comments,
+                                         &view_name,
+                                         &max_parse_depth)) {
+            return NULL;
         }
-        entitydefs[i] = PyBytes_AsString(string);
-        if (!entitydefs[i]) {
-            return -1;
+        if (!(input = PyUnicode_FromStringAndSize(encoded, size))) {
+            return NULL;
         }
     }
-    Py_DECREF(deflist);
-    return 0;
+    if (get_view(view_name, &view) ||
+        get_max_parse_depth(max_parse_depth, &self->max_parse_depth)) {
+        Py_DECREF(input);
+        return NULL;
+    }
+    selected = select_view(input, view);
+    Py_DECREF(input);
+    if (!selected) {
+        return NULL;
+    }
+    if (load_tokenizer_text(&self->text, selected)) {
+        return NULL;
+    }
+
+    self->head = self->global = self->depth = self->construct_depth = 0;
+    self->skip_style_tags = skip_style_tags;
+    self->drop_comments = drop_comments;
+    self->bad_routes = NULL;
+    reset_memory_stats(&self->memory);
+    if (start_interning(self)) {
+        return NULL;
+    }
+
+    PROBE_TOKENIZE_START(self->text.length);
+    tokens = Tokenizer_parse(self, context, 1);
+    PROBE_TOKENIZE_DONE(self->text.length, tokens != NULL);
+
+    Tokenizer_free_bad_route_tree(self);
+    finish_interning(self);
+    return check_tokens(self, tokens);
+}
+
+/*
+    Build a list of tokens like tokenize(), and record checkpoints.
+
+    A checkpoint is recorded whenever the root stack reaches the start of a
+    line, as a tuple of (position, number of tokens in the root stack, context,
+    global context, textbuffer length, furthest position read so far).
+
+    If resume is given, it is a tuple of (position, context, global context,
+    textbuffer contents) to start tokenizing from. If stops is given, it is a
+    list of tuples of (position, context, global context, textbuffer length,
+    source) sorted by position; we stop when the root stack reaches one of
+    these positions in the same state, discarding the textbuffer.
+
+    Return a tuple of (tokens, checkpoints, whether we stopped).
+*/
+static PyObject *
+Tokenizer_tokenize_checkpointed(Tokenizer *self, PyObject *args)
+{
+    PyObject *input, *tokens, *checkpoints;
+    PyObject *resume = Py_None, *stops = Py_None, *pending = NULL;
+    unsigned long long context = 0;
+    int skip_style_tags = 0, global = 0;
+    Py_ssize_t start = 0, i, length;
+
+    if (!PyArg_ParseTuple(
+            args, "U|pOO", &input, &skip_style_tags, &resume, &stops)) {
+        return NULL;
+    }
+    if (resume != Py_None &&
+        !PyArg_ParseTuple(
+            resume, "nKiU", &start, &context, &global, &pending)) {
+        return NULL;
+    }
+    if (stops != Py_None && !PyList_Check(stops)) {
+        PyErr_SetString(PyExc_TypeError, "stops must be a list or None");
+        return NULL;
+    }
+    Py_INCREF(input);
+    if (load_tokenizer_text(&self->text, input)) {
+        return NULL;
+    }
+    if (start < 0 || start > self->text.length) {
+        PyErr_SetString(PyExc_ValueError, "resume position out of range");
+        return NULL;
+    }
+
+    self->head = start;
+    self->global = global;
+    self->depth = self->construct_depth = 0;
+    self->max_parse_depth = -1;
+    self->skip_style_tags = skip_style_tags;
+    self->drop_comments = 0;
+    self->bad_routes = NULL;
+    self->route_max = self->max_read = -1;
+    self->start = start;
+    self->next_stop = 0;
+    self->stopped = 0;
+    reset_memory_stats(&self->memory);
+    if (start_interning(self)) {
+        return NULL;
+    }
+    if (!(checkpoints = PyList_New(0))) {
+        finish_interning(self);
+        return NULL;
+    }
+
+    if (Tokenizer_push(self, context)) {
+        finish_interning(self);
+        Py_DECREF(checkpoints);
+        return NULL;
+    }
+    if (pending) {
+        length = PyUnicode_GET_LENGTH(pending);
+        for (i = 0; i < length; i++) {
+            if (Textbuffer_write(self->topstack->textbuffer,
+                                 PyUnicode_READ_CHAR(pending, i))) {
+                Tokenizer_delete_top_of_stack(self);
+                finish_interning(self);
+                Py_DECREF(checkpoints);
+                return NULL;
+            }
+        }
+    }
+    self->checkpoints = checkpoints;
+    self->stops = stops == Py_None ? NULL : stops;
+
+    PROBE_TOKENIZE_START(self->text.length);
+    tokens = Tokenizer_parse(self, context, 0);
+    PROBE_TOKENIZE_DONE(self->text.length, tokens != NULL);
+
+    self->checkpoints = self->stops = NULL;
+    Tokenizer_free_bad_route_tree(self);
+    finish_interning(self);
+    if (!(tokens = check_tokens(self, tokens))) {
+        Py_DECREF(checkpoints);
+        return NULL;
+    }
+    return Py_BuildValue(
+        "(NNO)", tokens, checkpoints, self->stopped ? Py_True : Py_False);
+}
+
+/*
+    Return the peak number of bytes used by the tokenizer's internal structures
+    during the last call to tokenize() or tokenize_checkpointed(), as a dict.
+*/
+static PyObject *
+Tokenizer_memory_stats(Tokenizer *self, PyObject *args)
+{
+    return Py_BuildValue("{s:n,s:n,s:n,s:n}",
+                         "stacks",
+                         self->memory.stacks.peak,
+                         "textbuffers",
+                         self->memory.textbuffers.peak,
+                         "routes",
+                         self->memory.routes.peak,
+                         "total",
+                         self->memory.total.peak);
 }
 
+/*
+    Load the token classes from mwparserfromhell.parser.tokens. This is done
+    when the first tokenizer is created instead of when the module is imported.
+*/
 static int
 load_tokens(void)
 {
@@ -241,7 +455,9 @@ load_tokens(void)
              *fromlist = PyList_New(1), *modname = PyUnicode_FromString("tokens");
     char *name = "mwparserfromhell.parser";
 
-    if (!fromlist || !modname) {
+    if (!fromlist || !modname || load_token_constants() < 0) {
+        Py_XDECREF(fromlist);
+        Py_XDECREF(modname);
         return -1;
     }
     PyList_SET_ITEM(fromlist, 0, modname);
@@ -257,28 +473,6 @@ load_tokens(void)
     return 0;
 }
 
-static int
-load_defs(void)
-{
-    PyObject *tempmod;
-    PyObject *globals = PyEval_GetGlobals(), *locals = PyEval_GetLocals(),
-             *fromlist = PyList_New(1), *modname = PyUnicode_FromString("definitions");
-    char *name = "mwparserfromhell";
-
-    if (!fromlist || !modname) {
-        return -1;
-    }
-    PyList_SET_ITEM(fromlist, 0, modname);
-    tempmod = PyImport_ImportModuleLevel(name, globals, locals, fromlist, 0);
-    Py_DECREF(fromlist);
-    if (!tempmod) {
-        return -1;
-    }
-    definitions = PyObject_GetAttrString(tempmod, "definitions");
-    Py_DECREF(tempmod);
-    return 0;
-}
-
 static int
 load_exceptions(void)
 {
@@ -306,7 +500,7 @@ load_exceptions(void)
 PyMODINIT_FUNC
 PyInit__tokenizer(void)
 {
-    PyObject *module;
+    PyObject *module, *domain;
 
     TokenizerType.tp_new = PyType_GenericNew;
     if (PyType_Ready(&TokenizerType) < 0) {
@@ -320,8 +514,14 @@ PyInit__tokenizer(void)
     PyModule_AddObject(module, "CTokenizer", (PyObject *) &TokenizerType);
     Py_INCREF(Py_True);
     PyDict_SetItemString(TokenizerType.tp_dict, "USES_C", Py_True);
+    domain = PyLong_FromLong(TRACEMALLOC_DOMAIN);
+    if (!domain) {
+        return NULL;
+    }
+    PyDict_SetItemString(TokenizerType.tp_dict, "TRACEMALLOC_DOMAIN", domain);
+    Py_DECREF(domain);
     NOARGS = PyTuple_New(0);
-    if (!NOARGS || load_entities() || load_tokens() || load_defs()) {
+    if (!NOARGS) {
         return NULL;
     }
     return module;
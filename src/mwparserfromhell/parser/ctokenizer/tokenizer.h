@@ -23,6 +23,9 @@ SOFTWARE.
 #pragma once
 
 #include "common.h"
+#include "cost.h"
+#include "microbench.h"
+#include "prefilter.h"
 #include "textbuffer.h"
 
 /* Functions */
@@ -30,7 +33,9 @@ SOFTWARE.
 static PyObject *Tokenizer_new(PyTypeObject *, PyObject *, PyObject *);
 static void Tokenizer_dealloc(Tokenizer *);
 static int Tokenizer_init(Tokenizer *, PyObject *, PyObject *);
-static PyObject *Tokenizer_tokenize(Tokenizer *, PyObject *);
+static PyObject *Tokenizer_tokenize(Tokenizer *, PyObject *, PyObject *);
+static PyObject *Tokenizer_tokenize_checkpointed(Tokenizer *, PyObject *);
+static PyObject *Tokenizer_memory_stats(Tokenizer *, PyObject *);
 
 /* Structs */
 
@@ -38,9 +43,21 @@ static PyMethodDef Tokenizer_methods[] = {
     {
         "tokenize",
         (PyCFunction) Tokenizer_tokenize,
-        METH_VARARGS,
+        METH_VARARGS | METH_KEYWORDS,
         "Build a list of tokens from a string of wikicode and return it.",
     },
+    {
+        "tokenize_checkpointed",
+        (PyCFunction) Tokenizer_tokenize_checkpointed,
+        METH_VARARGS,
+        "Build a list of tokens like tokenize(), and record checkpoints.",
+    },
+    {
+        "memory_stats",
+        (PyCFunction) Tokenizer_memory_stats,
+        METH_NOARGS,
+        "Return the peak memory used by the last call to tokenize(), in bytes.",
+    },
     {NULL},
 };
 
@@ -89,12 +106,42 @@ static PyTypeObject TokenizerType = {
     Tokenizer_new,                                         /* tp_new */
 };
 
+static PyMethodDef module_methods[] = {
+    {
+        "_cost_scan",
+        (PyCFunction) cost_scan,
+        METH_VARARGS,
+        "Count the features of some text that make it expensive to tokenize.",
+    },
+    {
+        "_prefilter_scan",
+        (PyCFunction) prefilter_scan,
+        METH_VARARGS,
+        "Find the templates and links in some text whose names are in a trie.",
+    },
+#ifdef MWP_MICROBENCH
+    {
+        "_microbench_names",
+        (PyCFunction) microbench_names,
+        METH_NOARGS,
+        "Return the names of the available microbenchmarks.",
+    },
+    {
+        "_microbench",
+        (PyCFunction) microbench_run,
+        METH_VARARGS,
+        "Run a microbenchmark for a number of iterations.",
+    },
+#endif
+    {NULL},
+};
+
 static PyModuleDef module_def = {
     PyModuleDef_HEAD_INIT,
     "_tokenizer",
     "Creates a list of tokens from a string of wikicode.",
     -1,
-    NULL,
+    module_methods,
     NULL,
     NULL,
     NULL,
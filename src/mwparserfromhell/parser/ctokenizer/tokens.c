@@ -22,6 +22,8 @@ SOFTWARE.
 
 #include "tokens.h"
 
+#include <stdarg.h>
+
 /* Globals */
 
 PyObject *Text;
@@ -62,6 +64,71 @@ PyObject *TagCloseSelfclose;
 PyObject *TagOpenClose;
 PyObject *TagCloseClose;
 
+PyObject *KEY_TEXT;
+PyObject *KEY_WIKI_MARKUP;
+PyObject *KEY_PADDING;
+PyObject *KEY_CHAR;
+PyObject *KEY_BRACKETS;
+PyObject *KEY_SUPPRESS_SPACE;
+PyObject *KEY_LEVEL;
+PyObject *KEY_IMPLICIT;
+PyObject *KEY_INVALID;
+PyObject *KEY_PAD_FIRST;
+PyObject *KEY_PAD_BEFORE_EQ;
+PyObject *KEY_PAD_AFTER_EQ;
+
+PyObject *EMPTY;
+PyObject *MARKUP_ITALICS;
+PyObject *MARKUP_BOLD;
+PyObject *MARKUP_TABLE_OPEN;
+PyObject *MARKUP_TABLE_CLOSE;
+PyObject *MARKUP_TABLE_ROW;
+PyObject *MARKUP_TABLE_CELL;
+PyObject *MARKUP_TABLE_CELL_INLINE;
+PyObject *MARKUP_TABLE_HEADER;
+PyObject *MARKUP_TABLE_HEADER_INLINE;
+
+/*
+    Create the attribute names and constant values used by tokens, so that
+    emitting a token doesn't have to create any strings. Attribute names are
+    interned, so dict lookups with them compare by identity.
+*/
+int
+load_token_constants(void)
+{
+#define LOAD(name, value)                                                              \
+    if (!name && !(name = PyUnicode_InternFromString(value))) {                        \
+        return -1;                                                                     \
+    }
+
+    LOAD(KEY_TEXT, "text")
+    LOAD(KEY_WIKI_MARKUP, "wiki_markup")
+    LOAD(KEY_PADDING, "padding")
+    LOAD(KEY_CHAR, "char")
+    LOAD(KEY_BRACKETS, "brackets")
+    LOAD(KEY_SUPPRESS_SPACE, "suppress_space")
+    LOAD(KEY_LEVEL, "level")
+    LOAD(KEY_IMPLICIT, "implicit")
+    LOAD(KEY_INVALID, "invalid")
+    LOAD(KEY_PAD_FIRST, "pad_first")
+    LOAD(KEY_PAD_BEFORE_EQ, "pad_before_eq")
+    LOAD(KEY_PAD_AFTER_EQ, "pad_after_eq")
+
+    LOAD(EMPTY, "")
+    LOAD(MARKUP_ITALICS, "''")
+    LOAD(MARKUP_BOLD, "'''")
+    LOAD(MARKUP_TABLE_OPEN, "{|")
+    LOAD(MARKUP_TABLE_CLOSE, "|}")
+    LOAD(MARKUP_TABLE_ROW, "|-")
+    LOAD(MARKUP_TABLE_CELL, "|")
+    LOAD(MARKUP_TABLE_CELL_INLINE, "||")
+    LOAD(MARKUP_TABLE_HEADER, "!")
+    LOAD(MARKUP_TABLE_HEADER_INLINE, "!!")
+    return 0;
+
+#undef LOAD
+}
+
 /*
     Load individual tokens into globals from the given Python module object.
 */
@@ -107,3 +174,55 @@ load_tokens_from_module(PyObject *module)
     TagOpenClose = PyObject_GetAttrString(module, "TagOpenClose");
     TagCloseClose = PyObject_GetAttrString(module, "TagCloseClose");
 }
+
+/*
+    Create a token of the given class, with some attributes. The class is
+    followed by the number of attributes, and then a key and a value for each
+    one, as borrowed references.
+
+    Tokens are dicts, so this sets the attributes directly instead of passing
+    them to the class as keyword arguments, which would need a dict of its own.
+*/
+PyObject *
+make_token(PyObject *cls, int count, ...)
+{
+    PyObject *token, *key, *value;
+    va_list args;
+    int i;
+
+    token = PyObject_Call(cls, NOARGS, NULL);
+    if (!token) {
+        return NULL;
+    }
+    va_start(args, count);
+    for (i = 0; i < count; i++) {
+        key = va_arg(args, PyObject *);
+        value = va_arg(args, PyObject *);
+        if (PyDict_SetItem(token, key, value)) {
+            va_end(args);
+            Py_DECREF(token);
+            return NULL;
+        }
+    }
+    va_end(args);
+    return token;
+}
+
+/*
+    Return an attribute of a token as a new reference, or None if it isn't set,
+    like Token.__getattr__() but without calling into Python.
+*/
+PyObject *
+get_token_attr(PyObject *token, PyObject *key)
+{
+    PyObject *value = PyDict_GetItemWithError(token, key);
+
+    if (!value) {
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+        value = Py_None;
+    }
+    Py_INCREF(value);
+    return value;
+}
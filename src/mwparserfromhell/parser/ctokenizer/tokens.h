@@ -64,6 +64,35 @@ extern PyObject *TagCloseSelfclose;
 extern PyObject *TagOpenClose;
 extern PyObject *TagCloseClose;
 
+/* Attribute names of tokens, and constant values used by them */
+
+extern PyObject *KEY_TEXT;
+extern PyObject *KEY_WIKI_MARKUP;
+extern PyObject *KEY_PADDING;
+extern PyObject *KEY_CHAR;
+extern PyObject *KEY_BRACKETS;
+extern PyObject *KEY_SUPPRESS_SPACE;
+extern PyObject *KEY_LEVEL;
+extern PyObject *KEY_IMPLICIT;
+extern PyObject *KEY_INVALID;
+extern PyObject *KEY_PAD_FIRST;
+extern PyObject *KEY_PAD_BEFORE_EQ;
+extern PyObject *KEY_PAD_AFTER_EQ;
+
+extern PyObject *EMPTY;
+extern PyObject *MARKUP_ITALICS;
+extern PyObject *MARKUP_BOLD;
+extern PyObject *MARKUP_TABLE_OPEN;
+extern PyObject *MARKUP_TABLE_CLOSE;
+extern PyObject *MARKUP_TABLE_ROW;
+extern PyObject *MARKUP_TABLE_CELL;
+extern PyObject *MARKUP_TABLE_CELL_INLINE;
+extern PyObject *MARKUP_TABLE_HEADER;
+extern PyObject *MARKUP_TABLE_HEADER_INLINE;
+
 /* Functions */
 
+int load_token_constants(void);
 void load_tokens_from_module(PyObject *);
+PyObject *make_token(PyObject *, int, ...);
+PyObject *get_token_attr(PyObject *, PyObject *);
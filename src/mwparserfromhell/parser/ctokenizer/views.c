@@ -0,0 +1,308 @@
+/*
+Copyright (C) 2012-2016 Ben Kurtovic <ben.kurtovic@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "views.h"
+
+static const char *VIEW_TAGS[] = {"noinclude", "includeonly", "onlyinclude", NULL};
+
+/*
+    Convert the name of a view into one of the VIEW_* constants. Return 0 on
+    success and -1 (with an exception set) if the name is unknown.
+*/
+int
+get_view(const char *name, int *view)
+{
+    if (!name) {
+        *view = VIEW_NONE;
+    } else if (!strcmp(name, "page")) {
+        *view = VIEW_PAGE;
+    } else if (!strcmp(name, "transcluded")) {
+        *view = VIEW_TRANSCLUDED;
+    } else {
+        PyErr_Format(PyExc_ValueError, "unknown view: '%s'", name);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+    Return whether the given ASCII string appears in the text at index,
+    optionally ignoring the case of the text.
+*/
+int
+match_ascii(PyObject *text, Py_ssize_t index, const char *str, int ignore_case)
+{
+    int kind = PyUnicode_KIND(text);
+    const void *data = PyUnicode_DATA(text);
+    Py_ssize_t length = PyUnicode_GET_LENGTH(text);
+    Py_UCS4 this;
+
+    for (; *str; str++, index++) {
+        if (index >= length) {
+            return 0;
+        }
+        this = PyUnicode_READ(kind, data, index);
+        if (ignore_case && this >= 'A' && this <= 'Z') {
+            this += 'a' - 'A';
+        }
+        if (this != (Py_UCS4) *str) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+    Return the index of the next appearance of an ASCII string in the text at
+    or after start, or -1 if there is none, optionally ignoring the case of the
+    text.
+*/
+Py_ssize_t
+find_ascii(PyObject *text, Py_ssize_t start, const char *str, int ignore_case)
+{
+    Py_ssize_t length = PyUnicode_GET_LENGTH(text);
+
+    for (; start < length; start++) {
+        if (match_ascii(text, start, str, ignore_case)) {
+            return start;
+        }
+    }
+    return -1;
+}
+
+/*
+    Try to match one of the view tags (like <noinclude>, </includeonly>, or
+    <onlyinclude/>) at index. Return the index just past the tag, or -1 if
+    there isn't one, and store which tag it is and its form.
+*/
+static Py_ssize_t
+match_view_tag(PyObject *text,
+               Py_ssize_t index,
+               int *tag,
+               int *closing,
+               int *selfclosing)
+{
+    int kind = PyUnicode_KIND(text);
+    const void *data = PyUnicode_DATA(text);
+    Py_ssize_t length = PyUnicode_GET_LENGTH(text);
+    Py_UCS4 this;
+
+    index++;
+    *closing = index < length && PyUnicode_READ(kind, data, index) == '/';
+    if (*closing) {
+        index++;
+    }
+    for (*tag = 0; VIEW_TAGS[*tag]; (*tag)++) {
+        if (match_ascii(text, index, VIEW_TAGS[*tag], 1)) {
+            break;
+        }
+    }
+    if (!VIEW_TAGS[*tag]) {
+        return -1;
+    }
+    index += strlen(VIEW_TAGS[*tag]);
+    if (index >= length) {
+        return -1;
+    }
+    this = PyUnicode_READ(kind, data, index);
+    if (this != '/' && this != '>' && !Py_UNICODE_ISSPACE(this)) {
+        return -1;
+    }
+    while (PyUnicode_READ(kind, data, index) != '>') {
+        if (++index >= length) {
+            return -1;
+        }
+    }
+    *selfclosing = PyUnicode_READ(kind, data, index - 1) == '/';
+    return index + 1;
+}
+
+/*
+    Return the index just past the closing tag of the given view tag at or
+    after start, or the length of the text if there is none.
+*/
+static Py_ssize_t
+find_closing_tag(PyObject *text, Py_ssize_t start, int tag)
+{
+    int kind = PyUnicode_KIND(text);
+    const void *data = PyUnicode_DATA(text);
+    Py_ssize_t length = PyUnicode_GET_LENGTH(text), index;
+
+    while ((start = find_ascii(text, start, "</", 0)) >= 0) {
+        start += 2;
+        if (!match_ascii(text, start, VIEW_TAGS[tag], 1)) {
+            continue;
+        }
+        index = start + strlen(VIEW_TAGS[tag]);
+        while (index < length &&
+               Py_UNICODE_ISSPACE(PyUnicode_READ(kind, data, index))) {
+            index++;
+        }
+        if (index < length && PyUnicode_READ(kind, data, index) == '>') {
+            return index + 1;
+        }
+    }
+    return length;
+}
+
+/*
+    Append the text between start and end to a list of chunks.
+*/
+static int
+append_chunk(PyObject *chunks, PyObject *text, Py_ssize_t start, Py_ssize_t end)
+{
+    PyObject *chunk = PyUnicode_Substring(text, start, end);
+    int result;
+
+    if (!chunk) {
+        return -1;
+    }
+    result = PyList_Append(chunks, chunk);
+    Py_DECREF(chunk);
+    return result;
+}
+
+/*
+    Join a list of chunks into a new string, stealing the reference to it.
+*/
+static PyObject *
+join_chunks(PyObject *chunks)
+{
+    PyObject *empty, *joined;
+
+    if (!chunks) {
+        return NULL;
+    }
+    empty = PyUnicode_FromStringAndSize("", 0);
+    if (!empty) {
+        Py_DECREF(chunks);
+        return NULL;
+    }
+    joined = PyUnicode_Join(empty, chunks);
+    Py_DECREF(empty);
+    Py_DECREF(chunks);
+    return joined;
+}
+
+/*
+    Return only the <onlyinclude> sections of the text, matched exactly.
+*/
+static PyObject *
+select_onlyinclude(PyObject *text)
+{
+    PyObject *chunks = PyList_New(0);
+    Py_ssize_t index = find_ascii(text, 0, "<onlyinclude>", 0), start, end;
+
+    if (!chunks) {
+        return NULL;
+    }
+    while (index >= 0) {
+        start = index + strlen("<onlyinclude>");
+        end = find_ascii(text, start, "</onlyinclude>", 0);
+        if (end < 0) {
+            end = PyUnicode_GET_LENGTH(text);
+        }
+        if (append_chunk(chunks, text, start, end)) {
+            Py_DECREF(chunks);
+            return NULL;
+        }
+        if (end == PyUnicode_GET_LENGTH(text)) {
+            break;
+        }
+        index = find_ascii(text, end, "<onlyinclude>", 0);
+    }
+    return join_chunks(chunks);
+}
+
+/*
+    Return the parts of the text that are part of the given view, as a new
+    reference.
+
+    VIEW_PAGE drops <includeonly> sections, and VIEW_TRANSCLUDED drops
+    <noinclude> sections and keeps only <onlyinclude> sections if there are
+    any, like MediaWiki does before parsing. The tags themselves are removed
+    either way, but ones inside comments are left alone.
+*/
+PyObject *
+select_view(PyObject *text, int view)
+{
+    PyObject *chunks, *selected;
+    Py_ssize_t length, index = 0, i = 0, end;
+    int dropped, tag, closing, selfclosing;
+
+    if (view == VIEW_NONE) {
+        Py_INCREF(text);
+        return text;
+    }
+    if (view == VIEW_TRANSCLUDED && find_ascii(text, 0, "<onlyinclude>", 0) >= 0) {
+        if (!(text = select_onlyinclude(text))) {
+            return NULL;
+        }
+    } else {
+        Py_INCREF(text);
+    }
+
+    dropped = view == VIEW_PAGE ? 1 : 0; /* includeonly or noinclude */
+    length = PyUnicode_GET_LENGTH(text);
+    if (!(chunks = PyList_New(0))) {
+        Py_DECREF(text);
+        return NULL;
+    }
+    while (i < length) {
+        if (PyUnicode_READ_CHAR(text, i) != '<') {
+            i++;
+            continue;
+        }
+        if (match_ascii(text, i, "<!--", 0)) {
+            end = find_ascii(text, i + 4, "-->", 0);
+            i = end < 0 ? length : end + 3;
+            continue;
+        }
+        end = match_view_tag(text, i, &tag, &closing, &selfclosing);
+        if (end < 0) {
+            i++;
+            continue;
+        }
+        if (append_chunk(chunks, text, index, i)) {
+            Py_DECREF(chunks);
+            Py_DECREF(text);
+            return NULL;
+        }
+        if (tag == dropped && !closing && !selfclosing) {
+            end = find_closing_tag(text, end, tag);
+        }
+        index = i = end;
+    }
+
+    if (PyList_GET_SIZE(chunks) == 0) {
+        Py_DECREF(chunks);
+        return text;
+    }
+    if (append_chunk(chunks, text, index, length)) {
+        Py_DECREF(chunks);
+        Py_DECREF(text);
+        return NULL;
+    }
+    selected = join_chunks(chunks);
+    Py_DECREF(text);
+    return selected;
+}
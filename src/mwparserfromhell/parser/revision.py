@@ -0,0 +1,244 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+This module contains the machinery behind :meth:`.Parser.parse_revision`,
+which parses a new revision of a page by only retokenizing the region around
+the edit and reusing the rest of the previous revision's tree.
+
+The tokenizer records a *checkpoint* whenever its root stack reaches the start
+of a line. Everything before a checkpoint is known not to depend on text past
+the furthest position read when it was recorded, so parsing can resume there
+if the edit starts later. Checkpoints after the edit become *stops*: once the
+new parse reaches one in the same state, the rest of the old tree is reused.
+"""
+
+from itertools import islice
+
+from . import tokens
+from ..nodes import Text
+from ..smart_list import SmartList
+from ..wikicode import Wikicode
+
+__all__ = ["RevisionState", "parse_revision"]
+
+_OPENERS = (
+    tokens.TemplateOpen,
+    tokens.ArgumentOpen,
+    tokens.WikilinkOpen,
+    tokens.ExternalLinkOpen,
+    tokens.HTMLEntityStart,
+    tokens.HeadingStart,
+    tokens.CommentStart,
+    tokens.TagOpenOpen,
+)
+_CLOSERS = (
+    tokens.TemplateClose,
+    tokens.ArgumentClose,
+    tokens.WikilinkClose,
+    tokens.ExternalLinkClose,
+    tokens.HTMLEntityEnd,
+    tokens.HeadingEnd,
+    tokens.CommentEnd,
+    tokens.TagCloseSelfclose,
+    tokens.TagCloseClose,
+)
+
+
+class RevisionState:
+    """Stores what is needed to parse the next revision of a page.
+
+    An instance is attached to each tree returned by
+    :meth:`.Parser.parse_revision`. *checkpoints* is a list of tuples of
+    ``(position, number of top-level nodes before it, context, global context,
+    pending text length, furthest position read)``, sorted by position.
+    *reparsed* is the ``(start, end)`` range of the text that was actually
+    tokenized to produce the tree.
+    """
+
+    def __init__(self, text, checkpoints, skip_style_tags, length, reparsed):
+        self.text = text
+        self.checkpoints = checkpoints
+        self.skip_style_tags = skip_style_tags
+        self.length = length
+        self.reparsed = reparsed
+
+
+def _count_nodes(tokenlist, positions):
+    """Convert token counts in the root stack into top-level node counts.
+
+    *positions* is a sorted list of token counts; return the number of nodes
+    that the builder will create from the first *n* tokens for each.
+    """
+    counts = []
+    index = nodes = depth = 0
+    tokeniter = iter(tokenlist)
+    for position in positions:
+        for token in islice(tokeniter, max(position - index, 0)):
+            if isinstance(token, _CLOSERS):
+                depth -= 1
+            elif isinstance(token, _OPENERS):
+                if not depth:
+                    nodes += 1
+                depth += 1
+            elif not depth and isinstance(token, tokens.Text):
+                nodes += 1
+        index = max(index, position)
+        counts.append(nodes)
+    return counts
+
+
+def _common_prefix(old, new):
+    """Return the length of the longest common prefix of two strings."""
+    low, high = 0, min(len(old), len(new))
+    while low < high:
+        mid = (low + high + 1) // 2
+        if old[low:mid] == new[low:mid]:
+            low = mid
+        else:
+            high = mid - 1
+    return low
+
+
+def _common_suffix(old, new, limit):
+    """Return the length of the longest common suffix, up to *limit*."""
+    low, high = 0, limit
+    olen, nlen = len(old), len(new)
+    while low < high:
+        mid = (low + high + 1) // 2
+        if old[olen - mid : olen - low] == new[nlen - mid : nlen - low]:
+            low = mid
+        else:
+            high = mid - 1
+    return low
+
+
+def _search(checkpoints, field, value):
+    """Return the index of the first checkpoint with *field* >= *value*."""
+    low, high = 0, len(checkpoints)
+    while low < high:
+        mid = (low + high) // 2
+        if checkpoints[mid][field] < value:
+            low = mid + 1
+        else:
+            high = mid
+    return low
+
+
+def _finish(nodes, text, checkpoints, skip_style_tags, reparsed):
+    """Wrap a list of top-level nodes in a tree carrying its revision state."""
+    code = Wikicode(SmartList(nodes))
+    code._revision = RevisionState(
+        text, checkpoints, skip_style_tags, len(nodes), reparsed
+    )
+    return code
+
+
+def _parse_full(tokenizer, builder, text, skip_style_tags):
+    """Parse *text* from scratch, recording checkpoints for the next time."""
+    tokenlist, checkpoints, _ = tokenizer.tokenize_checkpointed(text, skip_style_tags)
+    counts = _count_nodes(tokenlist, [cp[1] for cp in checkpoints])
+    checkpoints = [(cp[0], n) + cp[2:] for cp, n in zip(checkpoints, counts)]
+    nodes = list(builder.build(tokenlist).nodes)
+    return _finish(nodes, text, checkpoints, skip_style_tags, (0, len(text)))
+
+
+def _get_state(prev_text, prev_tree, skip_style_tags):
+    """Return the usable revision state of *prev_tree*, or ``None``."""
+    state = getattr(prev_tree, "_revision", None)
+    if (
+        not isinstance(state, RevisionState)
+        or state.skip_style_tags != skip_style_tags
+        or state.length != len(prev_tree.nodes)
+        or state.text != prev_text
+    ):
+        return None
+    return state
+
+
+def parse_revision(tokenizer, builder, prev_text, prev_tree, text, skip_style_tags):
+    """Parse *text* incrementally against a previous revision.
+
+    See :meth:`.Parser.parse_revision` for details.
+    """
+    state = _get_state(prev_text, prev_tree, skip_style_tags)
+    if state is None:
+        return _parse_full(tokenizer, builder, text, skip_style_tags)
+
+    nodes = list(prev_tree.nodes)
+    checkpoints = state.checkpoints
+    start = _common_prefix(prev_text, text)
+    if start == len(prev_text) == len(text):
+        return _finish(nodes, text, checkpoints, skip_style_tags, (start, start))
+    limit = min(len(prev_text), len(text)) - start
+    old_end = len(prev_text) - _common_suffix(prev_text, text, limit)
+    delta = len(text) - len(prev_text)
+
+    index = _search(checkpoints, 5, start) - 1
+    if index >= 0:
+        position, n_resume, context, glob, plen, max_read = checkpoints[index]
+        pending = ""
+        if plen:
+            if not isinstance(nodes[n_resume], Text):
+                return _parse_full(tokenizer, builder, text, skip_style_tags)
+            pending = nodes[n_resume].value[:plen]
+        resume = (position, context, glob, pending)
+    else:
+        n_resume, max_read, resume = 0, -1, None
+
+    # Stop two characters past the edit, so that the newline before the stop
+    # and the character before it (which may have been peeked) are unchanged:
+    first = _search(checkpoints, 0, old_end + 2)
+    stops = []
+    for cp in islice(checkpoints, first, None):
+        source = None
+        if cp[4]:
+            if not isinstance(nodes[cp[1]], Text):
+                continue
+            source = nodes[cp[1]].value
+        stops.append((cp[0] + delta, cp[2], cp[3], cp[4], source))
+
+    tokenlist, found, stopped = tokenizer.tokenize_checkpointed(
+        text, skip_style_tags, resume, stops
+    )
+    counts = _count_nodes(tokenlist, [cp[1] for cp in found])
+    new = checkpoints[: index + 1]
+    new += [
+        (cp[0], n_resume + n) + cp[2:5] + (max(cp[5], max_read),)
+        for cp, n in zip(found, counts)
+    ]
+    middle = list(builder.build(tokenlist).nodes)
+    result = nodes[:n_resume] + middle
+    if not stopped:
+        reparsed = (resume[0] if resume else 0, len(text))
+        return _finish(result, text, new, skip_style_tags, reparsed)
+
+    end = found[-1][0]
+    stop = _search(checkpoints, 0, end - delta)
+    n_stop = checkpoints[stop][1]
+    shift = len(result) - n_stop
+    max_read = new[-1][5]
+    new += [
+        (cp[0] + delta, cp[1] + shift) + cp[2:5] + (max(cp[5] + delta, max_read),)
+        for cp in islice(checkpoints, stop + 1, None)
+    ]
+    result += islice(nodes, n_stop, None)
+    reparsed = (resume[0] if resume else 0, end)
+    return _finish(result, text, new, skip_style_tags, reparsed)
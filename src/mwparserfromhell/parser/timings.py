@@ -0,0 +1,105 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+This module measures how long each stage of parsing takes. Timings are
+collected for a call to :meth:`.Parser.parse` with ``timings=True``, or for
+every call when a hook is installed with :func:`set_timings_hook`.
+"""
+
+from time import perf_counter
+
+__all__ = ["ParseTimings", "get_timings_hook", "set_timings_hook"]
+
+_hook = None
+
+
+class ParseTimings:
+    """Stores how long each stage of parsing some text took.
+
+    *tokenize_time* and *build_time* are wall times in seconds. *length* is
+    the length of the text, *tokens* is the number of tokens the tokenizer
+    produced, and *nodes* is the number of nodes in the resulting tree,
+    including nested ones.
+    """
+
+    __slots__ = ("length", "tokens", "nodes", "tokenize_time", "build_time")
+
+    def __init__(self, length, tokens, nodes, tokenize_time, build_time):
+        self.length = length
+        self.tokens = tokens
+        self.nodes = nodes
+        self.tokenize_time = tokenize_time
+        self.build_time = build_time
+
+    def __repr__(self):
+        return (
+            "ParseTimings(length={}, tokens={}, nodes={}, tokenize_time={:.6f}, "
+            "build_time={:.6f})"
+        ).format(
+            self.length,
+            self.tokens,
+            self.nodes,
+            self.tokenize_time,
+            self.build_time,
+        )
+
+    @property
+    def total_time(self):
+        """The total time spent parsing, in seconds."""
+        return self.tokenize_time + self.build_time
+
+    def as_dict(self):
+        """Return the timings as a dictionary, such as for logging."""
+        data = {name: getattr(self, name) for name in self.__slots__}
+        data["total_time"] = self.total_time
+        return data
+
+
+def get_timings_hook():
+    """Return the function installed with :func:`set_timings_hook`, or None."""
+    return _hook
+
+
+def set_timings_hook(hook):
+    """Call *hook* with the :class:`ParseTimings` of every parse.
+
+    *hook* is called from :meth:`.Parser.parse` after each parse, in the
+    parsing thread, with the timings as its only argument. Pass ``None`` to
+    remove the hook. Timing parses and counting their nodes has a small cost,
+    so the hook should only be installed while profiling.
+    """
+    global _hook
+    _hook = hook
+
+
+def timed_parse(tokenizer, builder, text, *args):
+    """Tokenize and build *text*, returning the tree and its timings."""
+    start = perf_counter()
+    tokens = tokenizer.tokenize(text, *args)
+    middle = perf_counter()
+    count = len(tokens)
+    code = builder.build(tokens)
+    end = perf_counter()
+    nodes = sum(1 for _ in code.ifilter())
+    timings = ParseTimings(len(text), count, nodes, middle - start, end - middle)
+    if _hook is not None:
+        _hook(timings)
+    return code, timings
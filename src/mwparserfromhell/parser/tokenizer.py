@@ -18,7 +18,9 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+from bisect import bisect_left
 import html.entities as htmlentities
+from itertools import islice
 from math import log
 import re
 
@@ -95,15 +97,45 @@ class Tokenizer:
     MAX_DEPTH = 40
     regex = re.compile(r"([{}\[\]<>|=&'#*;:/\\\"\-!\n])", flags=re.IGNORECASE)
     tag_splitter = re.compile(r"([\s\"\'\\]+)")
-
-    def __init__(self):
+    VIEWS = {"page": "includeonly", "transcluded": "noinclude"}
+    view_regex = re.compile(
+        r"<!--|<(/?)(noinclude|includeonly|onlyinclude)(?=[\s/>])[^>]*>",
+        flags=re.IGNORECASE,
+    )
+
+    MAX_INTERN_LENGTH = 64
+    MAX_INTERN_ENTRIES = 65536
+
+    # Used to match delimiters in constructs nested deeper than max_parse_depth:
+    raw_regexes = {
+        "{": re.compile(r"\{+|\}+|<!--|<nowiki>", flags=re.IGNORECASE),
+        "[": re.compile(r"\[+|\]+|<!--|<nowiki>", flags=re.IGNORECASE),
+    }
+    nowiki_end_regex = re.compile(r"</nowiki>", flags=re.IGNORECASE)
+
+    def __init__(self, keep_interned=False):
+        """Create a new tokenizer.
+
+        Short strings in the tokens, like tag names and template names, are
+        interned in a table so that identical ones share the same object. If
+        *keep_interned* is ``True``, the table is kept between calls to
+        :meth:`tokenize`, so strings are shared between every page parsed with
+        the same tokenizer.
+        """
+        self._keep_interned = keep_interned
+        self._interned = {}
         self._text = None
         self._head = 0
         self._stacks = []
         self._global = 0
         self._depth = 0
         self._bad_routes = set()
+        self._route_max = -1
         self._skip_style_tags = False
+        self._drop_comments = False
+        self._checkpoints = None
+        self._max_parse_depth = None
+        self._construct_depth = 0
 
     @property
     def _stack(self):
@@ -147,10 +179,27 @@ class Tokenizer:
         self._stacks.append([[], context, [], new_ident])
         self._depth += 1
 
+    def _intern(self, text):
+        """Return a shared copy of *text* if it is short enough to intern."""
+        if len(text) > self.MAX_INTERN_LENGTH:
+            return text
+        return self._interned.setdefault(text, text)
+
+    def _start_interning(self):
+        """Prepare the table of interned strings before tokenizing."""
+        if not self._keep_interned or len(self._interned) >= self.MAX_INTERN_ENTRIES:
+            self._interned = {}
+
+    def _finish_interning(self):
+        """Drop the table of interned strings unless it's kept between calls."""
+        if not self._keep_interned:
+            self._interned = {}
+
     def _push_textbuffer(self):
         """Push the textbuffer onto the stack as a Text node and clear it."""
         if self._textbuffer:
-            self._stack.append(tokens.Text(text="".join(self._textbuffer)))
+            text = self._intern("".join(self._textbuffer))
+            self._stack.append(tokens.Text(text=text))
             self._textbuffer = []
 
     def _pop(self, keep_context=False):
@@ -172,13 +221,72 @@ class Tokenizer:
         """Return whether or not our max recursion depth has been exceeded."""
         return self._depth < self.MAX_DEPTH
 
+    def _is_shallow(self):
+        """Return whether constructs at the head should be kept as text."""
+        limit = self._max_parse_depth
+        return limit is not None and self._construct_depth >= limit
+
+    def _find_construct_end(self, opener, closer, most):
+        """Python version of find_construct_end() in tok_parse.c."""
+        text = self._raw
+        regex = self.raw_regexes[opener]
+        pos = self._offsets[self._head]
+        stack = []
+        while True:
+            match = regex.search(text, pos)
+            if not match:
+                return -1
+            token, pos = match.group(), match.end()
+            if token[0] == opener:
+                if len(token) >= 2:
+                    stack.append(len(token))
+            elif token[0] == closer:
+                used = 0
+                while len(token) - used >= 2 and stack:
+                    if most >= 3 and stack[-1] >= 3 and len(token) - used >= 3:
+                        size = 3
+                    else:
+                        size = 2
+                    stack[-1] -= size
+                    used += size
+                    if stack[-1] < 2:
+                        stack.pop()
+                    if not stack:
+                        return match.start() + used
+            elif token == "<!--":
+                end = text.find("-->", pos)
+                if end < 0:
+                    return -1
+                pos = end + 3
+            else:
+                end = self.nowiki_end_regex.search(text, pos)
+                if end:
+                    pos = end.end()
+
+    def _emit_raw_construct(self, opener, closer, most):
+        """Python version of Tokenizer_emit_raw_construct() in tok_parse.c."""
+        end = self._find_construct_end(opener, closer, most)
+        if end < 0:
+            while self._read(1) == opener:
+                self._emit_text(opener)
+                self._head += 1
+            self._emit_text(opener)
+            return
+        self._emit_text(self._raw[self._offsets[self._head] : end])
+        self._head = bisect_left(self._offsets, end) - 1
+        if opener == "{" and self._context & contexts.FAIL_NEXT:
+            self._context ^= contexts.FAIL_NEXT
+
     def _memoize_bad_route(self):
         """Remember that the current route (head + context at push) is invalid.
 
         This will be noticed when calling _push with the same head and context,
         and the route will be failed immediately.
         """
-        self._bad_routes.add(self._stack_ident)
+        ident = self._stack_ident
+        self._bad_routes.add(ident)
+        if ident[0] > self._route_max:
+            self._route_max = ident[0]
 
     def _fail_route(self):
         """Fail the current tokenization route.
@@ -242,17 +350,142 @@ class Tokenizer:
                 self._fail_route()
             return self.END
 
+    def _read_tracked(self, delta=0, wrap=False, strict=False):
+        """Read like :meth:`_read`, remembering the furthest index read."""
+        index = self._head + delta
+        if index < 0 and wrap:
+            index = len(self._text)
+        if index > self._max_read:
+            self._max_read = index
+        return Tokenizer._read(self, delta, wrap, strict)
+
+    def _pending_length(self):
+        """Return the number of characters in the current textbuffer.
+
+        Text is only ever removed from the textbuffer after the last line
+        start, so the count at the previous checkpoint can be reused.
+        """
+        buf = self._textbuffer
+        cached = self._pending
+        if cached and cached[0] is buf and len(buf) >= cached[1]:
+            if not cached[1] or buf[cached[1] - 1] is cached[2]:
+                length = cached[3] + sum(map(len, islice(buf, cached[1], None)))
+                self._pending = (buf, len(buf), buf[-1] if buf else None, length)
+                return length
+        length = sum(map(len, buf))
+        self._pending = (buf, len(buf), buf[-1] if buf else None, length)
+        return length
+
+    def _checkpoint(self):
+        """Record a checkpoint if the head is at the start of a line.
+
+        Positions where routes ahead are already known to fail are skipped,
+        since what follows depends on more than the checkpoint's state.
+
+        Return whether we have reached one of the stops, in which case the
+        textbuffer is discarded.
+        """
+        head = self._head
+        if (
+            head <= self._start
+            or head > len(self._text)
+            or self._route_max >= head
+            or self._text[head - 1] != "\n"
+        ):
+            return False
+        offsets = self._offsets
+        position = offsets[head]
+        length = self._pending_length()
+        if self._max_read + 1 < len(offsets):
+            max_read = offsets[self._max_read + 1]
+        else:
+            max_read = offsets[-1] + self._max_read + 2 - len(offsets)
+        self._checkpoints.append(
+            (position, len(self._stack), self._context, self._global, length, max_read)
+        )
+
+        stops = self._stops
+        while self._next_stop < len(stops):
+            stop = stops[self._next_stop]
+            if stop[0] > position:
+                return False
+            self._next_stop += 1
+            if stop[0] == position:
+                if (
+                    stop[1] == self._context
+                    and stop[2] == self._global
+                    and stop[3] == length
+                    and (not length or stop[4].startswith("".join(self._textbuffer)))
+                ):
+                    self._textbuffer = []
+                    self._stopped = True
+                    return True
+                return False
+        return False
+
+    def _select_view(self, text, view):
+        """Return the parts of *text* that are part of the given *view*.
+
+        The ``"page"`` view drops ``<includeonly>`` sections, and the
+        ``"transcluded"`` view drops ``<noinclude>`` sections and keeps only
+        ``<onlyinclude>`` sections if there are any, like MediaWiki does before
+        parsing. The tags themselves are removed either way, but ones inside
+        comments are left alone.
+        """
+        if view not in self.VIEWS:
+            raise ValueError("unknown view: {!r}".format(view))
+        if view == "transcluded" and "<onlyinclude>" in text:
+            chunks = []
+            index = text.find("<onlyinclude>")
+            while index >= 0:
+                start = index + len("<onlyinclude>")
+                end = text.find("</onlyinclude>", start)
+                if end < 0:
+                    chunks.append(text[start:])
+                    break
+                chunks.append(text[start:end])
+                index = text.find("<onlyinclude>", end)
+            text = "".join(chunks)
+
+        dropped = self.VIEWS[view]
+        closer = re.compile(r"</" + dropped + r"\s*>", flags=re.IGNORECASE)
+        chunks = []
+        index = skip = 0
+        for match in self.view_regex.finditer(text):
+            if match.start() < skip:
+                continue
+            if match.group() == "<!--":
+                end = text.find("-->", match.end())
+                skip = len(text) if end < 0 else end + 3
+                continue
+            chunks.append(text[index : match.start()])
+            index = skip = match.end()
+            if (
+                match.group(2).lower() == dropped
+                and not match.group(1)
+                and not match.group().endswith("/>")
+            ):
+                close = closer.search(text, index)
+                index = skip = close.end() if close else len(text)
+        if not chunks:
+            return text
+        chunks.append(text[index:])
+        return "".join(chunks)
+
     def _parse_template(self, has_content):
         """Parse a template at the head of the wikicode string."""
         reset = self._head
         context = contexts.TEMPLATE_NAME
         if has_content:
             context |= contexts.HAS_TEMPLATE
+        self._construct_depth += 1
         try:
             template = self._parse(context)
         except BadRoute:
             self._head = reset
             raise
+        finally:
+            self._construct_depth -= 1
         self._emit_first(tokens.TemplateOpen())
         self._emit_all(template)
         self._emit(tokens.TemplateClose())
@@ -260,11 +493,14 @@ class Tokenizer:
     def _parse_argument(self):
         """Parse an argument at the head of the wikicode string."""
         reset = self._head
+        self._construct_depth += 1
         try:
             argument = self._parse(contexts.ARGUMENT_NAME)
         except BadRoute:
             self._head = reset
             raise
+        finally:
+            self._construct_depth -= 1
         self._emit_first(tokens.ArgumentOpen())
         self._emit_all(argument)
         self._emit(tokens.ArgumentClose())
@@ -356,6 +592,7 @@ class Tokenizer:
             link, _extra = self._really_parse_external_link(True)
         except BadRoute:
             self._head = reset + 1
+            self._construct_depth += 1
             try:
                 # Otherwise, actually parse it as a wikilink:
                 wikilink = self._parse(contexts.WIKILINK_TITLE)
@@ -366,6 +603,8 @@ class Tokenizer:
                 self._emit(tokens.WikilinkOpen())
                 self._emit_all(wikilink)
                 self._emit(tokens.WikilinkClose())
+            finally:
+                self._construct_depth -= 1
         else:
             if self._context & contexts.EXT_LINK_TITLE:
                 # In this exceptional case, an external link that looks like a
@@ -681,21 +920,28 @@ class Tokenizer:
             self._emit_all(self._pop())
 
     def _parse_comment(self):
-        """Parse an HTML comment at the head of the wikicode string."""
+        """Parse an HTML comment at the head of the wikicode string.
+
+        If comments are being dropped, skip over it without emitting anything.
+        """
         self._head += 4
         reset = self._head - 1
-        self._push()
+        drop = self._drop_comments
+        if not drop:
+            self._push()
         while True:
             this = self._read()
             if this == self.END:
-                self._pop()
+                if not drop:
+                    self._pop()
                 self._head = reset
                 self._emit_text("<!--")
                 return
             if this == self._read(1) == "-" and self._read(2) == ">":
-                self._emit_first(tokens.CommentStart())
-                self._emit(tokens.CommentEnd())
-                self._emit_all(self._pop())
+                if not drop:
+                    self._emit_first(tokens.CommentStart())
+                    self._emit(tokens.CommentEnd())
+                    self._emit_all(self._pop())
                 self._head += 2
                 if self._context & contexts.FAIL_NEXT:
                     # _verify_safe() sets this flag while parsing a template
@@ -703,7 +949,8 @@ class Tokenizer:
                     # must unset it to let _verify_safe() know it was correct:
                     self._context ^= contexts.FAIL_NEXT
                 return
-            self._emit_text(this)
+            if not drop:
+                self._emit_text(this)
             self._head += 1
 
     def _push_tag_buffer(self, data):
@@ -714,9 +961,9 @@ class Tokenizer:
         buf = data.padding_buffer
         self._emit_first(
             tokens.TagAttrStart(
-                pad_first=buf["first"],
-                pad_before_eq=buf["before_eq"],
-                pad_after_eq=buf["after_eq"],
+                pad_first=self._intern(buf["first"]),
+                pad_before_eq=self._intern(buf["before_eq"]),
+                pad_after_eq=self._intern(buf["after_eq"]),
             )
         )
         self._emit_all(self._pop())
@@ -816,7 +1063,7 @@ class Tokenizer:
         """Handle the closing of a open tag (``<foo>``)."""
         if data.context & (data.CX_ATTR_NAME | data.CX_ATTR_VALUE):
             self._push_tag_buffer(data)
-        self._emit(token(padding=data.padding_buffer["first"]))
+        self._emit(token(padding=self._intern(data.padding_buffer["first"])))
         self._head += 1
 
     def _handle_tag_open_close(self):
@@ -1162,7 +1409,7 @@ class Tokenizer:
                     self._push_tag_buffer(data)
                 if this.isspace():
                     data.padding_buffer["first"] += this
-                return data.padding_buffer["first"]
+                return self._intern(data.padding_buffer["first"])
             if this is self.END or this == end_token:
                 if self._context & contexts.TAG_ATTR:
                     if data.context & data.CX_QUOTED:
@@ -1368,6 +1615,9 @@ class Tokenizer:
         if push:
             self._push(context)
         while True:
+            if self._checkpoints is not None and self._depth == 1:
+                if self._checkpoint():
+                    return self._pop()
             this = self._read()
             if self._context & contexts.UNSAFE:
                 if not self._verify_safe(this):
@@ -1382,7 +1632,9 @@ class Tokenizer:
                 return self._handle_end()
             nxt = self._read(1)
             if this == nxt == "{":
-                if self._can_recurse():
+                if self._is_shallow():
+                    self._emit_raw_construct("{", "}", 3)
+                elif self._can_recurse():
                     self._parse_template_or_argument()
                 else:
                     self._emit_text("{")
@@ -1409,10 +1661,12 @@ class Tokenizer:
                 # TODO: Only do this if not in a file context:
                 # if self._context & contexts.WIKILINK_TEXT:
                 #     self._fail_route()
-                if not self._context & contexts.NO_WIKILINKS:
-                    self._parse_wikilink()
-                else:
+                if self._context & contexts.NO_WIKILINKS:
                     self._emit_text("[")
+                elif self._is_shallow():
+                    self._emit_raw_construct("[", "]", 2)
+                else:
+                    self._parse_wikilink()
             elif this == "|" and self._context & contexts.WIKILINK_TITLE:
                 self._handle_wikilink_separator()
             elif this == nxt == "]" and self._context & contexts.WIKILINK:
@@ -1537,19 +1791,111 @@ class Tokenizer:
                 self._emit_text(this)
             self._head += 1
 
-    def tokenize(self, text, context=0, skip_style_tags=False):
-        """Build a list of tokens from a string of wikicode and return it."""
+    def tokenize(
+        self,
+        text,
+        context=0,
+        skip_style_tags=False,
+        drop_comments=False,
+        view=None,
+        max_parse_depth=None,
+    ):
+        """Build a list of tokens from a string of wikicode and return it.
+
+        If *drop_comments* is ``True``, HTML comments are skipped entirely
+        instead of becoming :class:`.CommentStart`/:class:`.CommentEnd` tokens.
+        If *view* is ``"page"`` or ``"transcluded"``, only the parts of the text
+        that are shown when viewing the page directly or when transcluding it
+        are tokenized; see :meth:`_select_view`. If *max_parse_depth* is given,
+        templates, arguments, and wikilinks nested more deeply than that are
+        emitted as text, after matching their delimiters.
+        """
+        if max_parse_depth is not None and max_parse_depth < 0:
+            raise ValueError("max_parse_depth must be at least 0")
+        if view is not None:
+            text = self._select_view(text, view)
         split = self.regex.split(text)
         self._text = [segment for segment in split if segment]
+        if max_parse_depth is not None:
+            self._raw = text
+            self._offsets = offsets = [0]
+            for segment in self._text:
+                offsets.append(offsets[-1] + len(segment))
+        self._max_parse_depth = max_parse_depth
+        self._construct_depth = 0
         self._head = self._global = self._depth = 0
         self._bad_routes = set()
+        self._route_max = -1
         self._skip_style_tags = skip_style_tags
+        self._drop_comments = drop_comments
+        self._start_interning()
 
         try:
             result = self._parse(context)
         except BadRoute as exc:  # pragma: no cover (untestable/exceptional case)
             raise ParserError("Python tokenizer exited with BadRoute") from exc
+        finally:
+            self._finish_interning()
         if self._stacks:  # pragma: no cover (untestable/exceptional case)
             err = "Python tokenizer exited with non-empty token stack"
             raise ParserError(err)
         return result
+
+    def tokenize_checkpointed(
+        self, text, skip_style_tags=False, resume=None, stops=None
+    ):
+        """Build a list of tokens like :meth:`tokenize`, and record checkpoints.
+
+        A checkpoint is recorded whenever the root stack reaches the start of a
+        line, as a tuple of ``(position, number of tokens in the root stack,
+        context, global context, textbuffer length, furthest position read so
+        far)``.
+
+        If *resume* is given, it is a tuple of ``(position, context, global
+        context, textbuffer contents)`` to start tokenizing from. If *stops* is
+        given, it is a list of tuples of ``(position, context, global context,
+        textbuffer length, source)`` sorted by position; we stop when the root
+        stack reaches one of these positions in the same state, discarding the
+        textbuffer, whose contents must be the start of *source*.
+
+        Return a tuple of ``(tokens, checkpoints, whether we stopped)``.
+        """
+        split = self.regex.split(text)
+        self._text = [segment for segment in split if segment]
+        self._offsets = offsets = [0]
+        for segment in self._text:
+            offsets.append(offsets[-1] + len(segment))
+        start, context, self._global, pending = resume or (0, 0, 0, "")
+        self._head = self._start = bisect_left(offsets, start)
+        if start < 0 or start > len(text) or offsets[self._head] != start:
+            raise ValueError("resume position out of range")
+        self._depth = 0
+        self._max_parse_depth = None
+        self._bad_routes = set()
+        self._route_max = -1
+        self._skip_style_tags = skip_style_tags
+        self._drop_comments = False
+        self._max_read = -1
+        self._pending = None
+        self._stops = stops or []
+        self._next_stop = 0
+        self._stopped = False
+        self._start_interning()
+
+        self._push(context)
+        if pending:
+            self._emit_text(pending)
+        self._checkpoints = checkpoints = []
+        self._read = self._read_tracked
+        try:
+            result = self._parse(context, push=False)
+        except BadRoute as exc:  # pragma: no cover (untestable/exceptional case)
+            raise ParserError("Python tokenizer exited with BadRoute") from exc
+        finally:
+            del self._read
+            self._checkpoints = None
+            self._finish_interning()
+        if self._stacks:  # pragma: no cover (untestable/exceptional case)
+            err = "Python tokenizer exited with non-empty token stack"
+            raise ParserError(err)
+        return result, checkpoints, self._stopped
@@ -0,0 +1,277 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Contains a fast prefilter that tells whether a page might use any of a set of
+templates or link to any of a set of pages, without parsing it. Jobs that only
+care about a few templates can use it to skip parsing most pages.
+
+The prefilter scans the raw text for ``{{`` and ``[[`` followed by one of the
+names, using a trie of the names anchored at those positions. Matching is
+loose in the same way as :func:`.utils.normalize_title`: the first letter's
+case is ignored, runs of underscores and spaces are interchangeable, and
+whitespace is allowed around the name. A ``Template:`` prefix is ignored in templates, and a leading
+colon and section in links. The scanner runs in C, without holding the GIL,
+when the C tokenizer is available.
+
+Since it doesn't parse, the prefilter may find false positives, like a
+template inside a ``<nowiki>`` tag, but a page it rejects never contains one
+of the templates or links (except when transcluded from another page or
+generated by a parser function).
+"""
+
+from array import array
+
+from . import parser
+from .utils import normalize_spaces, normalize_title
+
+try:
+    from .parser._tokenizer import _prefilter_scan
+except ImportError:
+    _prefilter_scan = None
+
+__all__ = ["Prefilter", "prefilter"]
+
+_TEMPLATE = 1
+_LINK = 2
+
+_INVALID = set("#<>[]{}|")
+
+
+class _Alphabet:
+    """The characters the scanner looks for, as str or bytes items."""
+
+    def __init__(self, convert):
+        self.space = convert(" ")
+        self.spaces = {convert(c) for c in " _\t\n\r"}
+        self.words = {convert(c) for c in " _"}
+        self.ends = {convert(c) for c in "|}]#<{"}
+        self.brace = convert("{")
+        self.bracket = convert("[")
+        self.colon = convert(":")
+        self.prefix = [{convert(c), convert(c.upper())} for c in "template"]
+
+
+_STR = _Alphabet(lambda c: c)
+_BYTES = _Alphabet(ord)
+
+
+def _skip_spaces(text, index, alpha):
+    """Python version of skip_spaces() in prefilter.c."""
+    while index < len(text) and text[index] in alpha.spaces:
+        index += 1
+    return index
+
+
+def _is_name_end(text, index, alpha):
+    """Python version of is_name_end() in prefilter.c."""
+    index = _skip_spaces(text, index, alpha)
+    return index >= len(text) or text[index] in alpha.ends
+
+
+def _match_name(trie, text, index, alpha):
+    """Python version of match_name() in prefilter.c."""
+    node = trie
+    while True:
+        slot, children = node
+        if slot >= 0 and _is_name_end(text, index, alpha):
+            return slot
+        if index >= len(text):
+            return -1
+        char = text[index]
+        if char in alpha.words:
+            while index < len(text) and text[index] in alpha.words:
+                index += 1
+            char = alpha.space
+        else:
+            index += 1
+        node = children.get(char)
+        if node is None:
+            return -1
+
+
+def _skip_template_prefix(text, index, alpha):
+    """Python version of skip_template_prefix() in prefilter.c."""
+    if index + 8 >= len(text):
+        return index
+    for i, chars in enumerate(alpha.prefix):
+        if text[index + i] not in chars:
+            return index
+    after = _skip_spaces(text, index + 8, alpha)
+    if after < len(text) and text[after] == alpha.colon:
+        return _skip_spaces(text, after + 1, alpha)
+    return index
+
+
+def _scan(text, templates, links, find_all):
+    """Python version of prefilter_scan() in prefilter.c.
+
+    *templates* and *links* are nested tries of ``[slot, children]`` lists.
+    """
+    alpha = _STR if isinstance(text, str) else _BYTES
+    if not isinstance(text, (str, bytes)):
+        text = bytes(text)
+    hits = []
+    for i in range(len(text) - 1):
+        char = text[i]
+        if (char != alpha.brace and char != alpha.bracket) or text[i + 1] != char:
+            continue
+        start = _skip_spaces(text, i + 2, alpha)
+        if char == alpha.brace:
+            start = _skip_template_prefix(text, start, alpha)
+            slot = _match_name(templates, text, start, alpha)
+        else:
+            if start < len(text) and text[start] == alpha.colon:
+                start = _skip_spaces(text, start + 1, alpha)
+            slot = _match_name(links, text, start, alpha)
+        if slot >= 0:
+            hit = (i, _TEMPLATE if char == alpha.brace else _LINK, slot)
+            if not find_all:
+                return hit
+            hits.append(hit)
+    return hits if find_all else None
+
+
+def _flatten(trie, convert):
+    """Convert a nested trie into the flat array used by prefilter.c."""
+    nodes = []
+    flat = array("i")
+    queue = [trie]
+    offsets = {}
+    offset = 0
+    for node in queue:
+        offsets[id(node)] = offset
+        offset += 2 + 2 * len(node[1])
+        queue.extend(child for _, child in sorted(node[1].items()))
+        nodes.append(node)
+    for slot, children in nodes:
+        flat.extend((slot, len(children)))
+        for label, child in sorted(children.items()):
+            flat.extend((convert(label), offsets[id(child)]))
+    return flat.tobytes()
+
+
+class Prefilter:
+    """Checks whether text might contain some templates or links.
+
+    *patterns* is an iterable of names. A name starting with ``{{`` only
+    matches templates, and one starting with ``[[`` only matches links;
+    otherwise, it matches both. See the module documentation for how names
+    are compared. Use :func:`prefilter` as a shortcut for creating one.
+
+    A :class:`Prefilter` can be shared between threads.
+    """
+
+    def __init__(self, patterns):
+        self._patterns = ([], [])
+        tries = ([-1, {}], [-1, {}])
+        btries = ([-1, {}], [-1, {}])
+        keys = ({}, {})
+        for pattern in patterns:
+            if pattern.startswith("{{"):
+                kinds, name = (0,), pattern[2:]
+            elif pattern.startswith("[["):
+                kinds, name = (1,), pattern[2:]
+            else:
+                kinds, name = (0, 1), pattern
+            for kind in kinds:
+                words = self._normalize(name, kind)
+                key = normalize_title(words)
+                if key in keys[kind]:
+                    continue
+                keys[kind][key] = slot = len(self._patterns[kind])
+                self._patterns[kind].append(pattern)
+                first = words[0]
+                for char in {first, first.upper(), first.lower()}:
+                    if len(char) == 1:
+                        self._insert(tries[kind], char + words[1:], slot)
+                        self._insert(btries[kind], (char + words[1:]).encode(), slot)
+
+        self._tries = tries
+        self._btries = btries
+        self._flat = tuple(_flatten(trie, ord) for trie in tries)
+        self._bflat = tuple(_flatten(trie, int) for trie in btries)
+
+    def __repr__(self):
+        count = len(self._patterns[0]) + len(self._patterns[1])
+        return "Prefilter({} templates and links)".format(count)
+
+    @staticmethod
+    def _normalize(name, kind):
+        """Return the words of a template name or link title, or raise."""
+        words = normalize_spaces(name)
+        if kind == 0:
+            prefix, sep, rest = words.partition(":")
+            if sep and prefix.strip().lower() == "template":
+                words = rest.strip()
+        else:
+            words = words.lstrip(":").split("#", 1)[0].strip()
+        if not words or _INVALID.intersection(words):
+            raise ValueError("Invalid template name or link title: {!r}".format(name))
+        return words
+
+    @staticmethod
+    def _insert(trie, name, slot):
+        """Add a name to a nested trie."""
+        node = trie
+        for char in name:
+            node = node[1].setdefault(char, [-1, {}])
+        if node[0] < 0:
+            node[0] = slot
+
+    def _scan(self, text, find_all):
+        if isinstance(text, str):
+            if _prefilter_scan and parser.use_c:
+                return _prefilter_scan(text, *self._flat, find_all)
+            return _scan(text, *self._tries, find_all)
+        if _prefilter_scan and parser.use_c:
+            return _prefilter_scan(text, *self._bflat, find_all)
+        return _scan(text, *self._btries, find_all)
+
+    def search(self, text):
+        """Return where the templates and links might be in *text*.
+
+        *text* is a string, or UTF-8 encoded ``bytes``. The result is a list of
+        ``(offset, pattern)`` tuples, in the order they appear, where *offset*
+        is the index of the ``{{`` or ``[[`` (in bytes, for bytes input) and
+        *pattern* is the pattern that was found there.
+        """
+        return [
+            (offset, self._patterns[kind - 1][slot])
+            for offset, kind, slot in self._scan(text, True)
+        ]
+
+    def matches(self, text):
+        """Return whether *text* might contain any of the templates or links.
+
+        This stops scanning at the first one found, so it is faster than
+        :meth:`search`.
+        """
+        return self._scan(text, False) is not None
+
+
+def prefilter(patterns):
+    """Return a :class:`Prefilter` for some template names and link titles.
+
+    For example, ``prefilter(["Infobox person", "[[Paris"]).matches(text)``
+    tells whether *text* might use ``{{Infobox person}}`` or link to
+    ``[[Paris]]``.
+    """
+    return Prefilter(patterns)
@@ -0,0 +1,253 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Contains a rule engine for applying many template and link rewrites at once,
+such as renaming templates and parameters, removing deprecated parameters, and
+retargeting links.
+
+Rules are declared once on a :class:`Rewriter`, which stores them in tables
+keyed by normalized template name and link title. Applying them to a page
+walks its tree a single time and looks up each template and link in these
+tables, so the cost of a page doesn't grow with the number of rules. Names are
+normalized by :func:`.utils.normalize_title`, and a ``Template:`` prefix is
+ignored, so a rule for ``"Cite web"`` also applies to ``{{cite_web}}`` and
+``{{Template:Cite web}}``.
+"""
+
+import re
+
+from .nodes import Template, Text, Wikilink
+from .smart_list import SmartList
+from .utils import normalize_title, parse_anything, render_title
+from .wikicode import Wikicode
+
+__all__ = ["Rewriter"]
+
+# Values containing any of these are parsed instead of stored as plain text:
+_MARKUP = re.compile(r"[{}\[\]<>|=&'~\n]|__")
+
+_KEEP = object()
+_REMOVE = object()
+
+
+def _template_key(title):
+    """Return the dispatch key of a normalized template title."""
+    if title[:9].lower() == "template:":
+        return normalize_title(title[9:])
+    return title
+
+
+def _link_key(title):
+    """Return the dispatch key of a normalized link title, without fragment."""
+    return normalize_title(title.split("#", 1)[0])
+
+
+def _make_code(value):
+    """Return a :class:`.Wikicode` of *value*, only parsing it if needed."""
+    if _MARKUP.search(value):
+        return parse_anything(value)
+    return Wikicode(SmartList([Text(value)]))
+
+
+def _replace_text(code, value):
+    """Return a :class:`.Wikicode` of *value* with the whitespace of *code*."""
+    old = str(code)
+    stripped = old.strip()
+    start = old.find(stripped) if stripped else len(old)
+    return _make_code(old[:start] + value + old[start + len(stripped) :])
+
+
+class _TemplateRules:
+    """The rules for templates with a given name."""
+
+    __slots__ = ("rename", "params", "callbacks")
+
+    def __init__(self):
+        self.rename = None
+        self.params = {}
+        self.callbacks = []
+
+
+class Rewriter:
+    """Applies a set of rewrite rules to wikicode in a single pass.
+
+    Declare rules with the methods below, then call :meth:`apply` on each
+    page. Rules are matched against the names templates and links have before
+    any rules are applied, so renaming a template doesn't make the rules for
+    its new name apply to it in the same pass. For each template, parameter
+    rules are applied first, then the template is renamed, then callbacks are
+    called in the order they were declared.
+
+    A :class:`Rewriter` can be reused for any number of pages.
+    """
+
+    def __init__(self):
+        self._templates = {}
+        self._links = {}
+
+    def _get_template_rules(self, name):
+        key = _template_key(normalize_title(name))
+        if key not in self._templates:
+            self._templates[key] = _TemplateRules()
+        return self._templates[key]
+
+    def rename_template(self, old, new):
+        """Rename templates called *old* to *new*.
+
+        Whitespace around the old name is kept, so ``{{ old\\n|a=b}}`` becomes
+        ``{{ new\\n|a=b}}``.
+        """
+        self._get_template_rules(old).rename = new
+
+    def rename_param(self, template, old, new):
+        """Rename parameter *old* of templates called *template* to *new*.
+
+        The parameter is left alone if the template already has a parameter
+        called *new*. Renaming a positional parameter makes it a named one, and
+        the positional parameters after it are given explicit names to keep
+        their numbers.
+        """
+        self._get_template_rules(template).params[old.strip()] = new.strip()
+
+    def remove_param(self, template, name):
+        """Remove parameter *name* from templates called *template*.
+
+        This works like :meth:`.Template.remove`, except that all parameters
+        removed from a template are removed at once.
+        """
+        self._get_template_rules(template).params[name.strip()] = _REMOVE
+
+    def on_template(self, name, callback):
+        """Call *callback* with every template called *name*.
+
+        The callback can modify the template, and should return a true value
+        if it did, so it is counted as a change by :meth:`apply`.
+        """
+        self._get_template_rules(name).callbacks.append(callback)
+
+    def retarget_link(self, old, new, keep_text=True):
+        """Change wikilinks to the page *old* to link to *new* instead.
+
+        A section in the old link, like ``[[old#History]]``, is kept unless
+        *new* has its own. If *keep_text* is ``True``, links without text get
+        their old title as their text, so they still display the same way.
+        """
+        self._links.setdefault(_link_key(old), []).append((new, keep_text))
+
+    def on_link(self, title, callback):
+        """Call *callback* with every wikilink to the page *title*.
+
+        The callback should return a true value if it modified the link, like
+        with :meth:`on_template`.
+        """
+        self._links.setdefault(_link_key(title), []).append(callback)
+
+    def _apply_params(self, template, rules):
+        """Rename and remove the parameters of a template in one pass."""
+        changes = 0
+        names = None
+        kept = []
+        unhide = False
+        for param in template.params:
+            action = rules.get(param.name.strip(), _KEEP)
+            if action is _REMOVE:
+                unhide = unhide or not param.showkey
+                changes += 1
+                continue
+            if unhide and not param.showkey:
+                param.showkey = True
+            if action is not _KEEP:
+                if names is None:
+                    names = {par.name.strip() for par in template.params}
+                if action not in names:
+                    names.add(action)
+                    if not param.showkey:
+                        param.showkey = unhide = True
+                    param.name = _replace_text(param.name, action)
+                    changes += 1
+            kept.append(param)
+        if len(kept) != len(template.params):
+            template.params[:] = kept
+        return changes
+
+    def _apply_template(self, template, rules):
+        """Apply all of the rules for a template's name to it."""
+        changes = 0
+        if rules.params and template.params:
+            changes += self._apply_params(template, rules.params)
+        if rules.rename is not None:
+            template.name = _replace_text(template.name, rules.rename)
+            changes += 1
+        for callback in rules.callbacks:
+            if callback(template):
+                changes += 1
+        return changes
+
+    @staticmethod
+    def _apply_link(link, rules):
+        """Apply all of the rules for a link's title to it."""
+        changes = 0
+        for rule in rules:
+            if callable(rule):
+                if rule(link):
+                    changes += 1
+                continue
+            new, keep_text = rule
+            old = str(link.title).strip()
+            if "#" in old and "#" not in new:
+                new += old[old.index("#") :]
+            if keep_text and link.text is None:
+                link.text = _make_code(old)
+            link.title = _replace_text(link.title, new)
+            changes += 1
+        return changes
+
+    def apply(self, code):
+        """Apply the rules to *code*, a :class:`.Wikicode` object, in place.
+
+        Return the number of changes made.
+        """
+        types = []
+        if self._templates:
+            types.append(Template)
+        if self._links:
+            types.append(Wikilink)
+        if not types:
+            return 0
+
+        changes = 0
+        for node in code.filter(forcetype=tuple(types)):
+            if isinstance(node, Template):
+                key = _template_key(render_title(node.name))
+                rules = self._templates.get(key)
+                if rules:
+                    changes += self._apply_template(node, rules)
+            else:
+                rules = self._links.get(_link_key(render_title(node.title)))
+                if rules:
+                    changes += self._apply_link(node, rules)
+        return changes
+
+    def rewrite(self, text):
+        """Parse *text*, apply the rules to it, and return the new text."""
+        code = parse_anything(text)
+        self.apply(code)
+        return str(code)
@@ -0,0 +1,520 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Contains a small CSS-like query language for finding nodes in
+:class:`.Wikicode`, used by :meth:`.Wikicode.select`. For example::
+
+    template[name~=Infobox*] > param[name=birth_place] wikilink
+
+finds every wikilink inside the ``birth_place`` parameter of any template whose
+name starts with "Infobox". A selector is compiled once into a
+:class:`Selector`, which finds all of its matches in a single walk of the tree.
+
+A selector is a comma-separated list of alternatives, each a sequence of
+*compound selectors* joined by whitespace (any descendant) or ``>`` (a direct
+child). A leading ``>`` only matches top-level nodes. A compound selector is a
+type, or ``*`` for any type, followed by any number of predicates in brackets:
+
+========================  ===================================================
+Type                      Attributes
+========================  ===================================================
+``template``              ``name``
+``param``                 ``name``, ``value``
+``wikilink``              ``title``, ``text``
+``extlink``               ``url``, ``title``
+``tag``                   ``name``, and ``@attr`` for the tag's attributes
+``attribute``             ``name``, ``value``
+``heading``               ``title``, ``level``
+``argument``              ``name``, ``default``
+``comment``               ``contents``
+``text``                  ``value``
+``entity``                ``value``
+========================  ===================================================
+
+A predicate is either ``[attr]``, which checks that the attribute is present,
+or ``[attr op value]``, where *op* is one of ``=`` (equal), ``!=`` (not
+equal), ``^=`` (starts with), ``$=`` (ends with), ``*=`` (contains), or
+``~=`` (matches a glob pattern using ``*`` and ``?``). *value* can be quoted
+with single or double quotes, and must be if it contains spaces or ``]``.
+Adding `` i`` before the closing bracket makes the comparison case-insensitive.
+A missing attribute, like the text of a wikilink without one, never matches.
+
+Values are stripped of surrounding whitespace before being compared. Template
+names and wikilink titles are also normalized by
+:func:`.utils.normalize_title`, on both sides: markup is stripped, runs of
+whitespace and underscores become single spaces, and the first letter is
+capitalized. Tag names are compared in lowercase.
+
+Templates have their parameters as children, and parameters and attributes
+have the nodes of their names and values as children. Every other node has the
+nodes of its :class:`.Wikicode` attributes as children.
+"""
+
+from functools import lru_cache
+from itertools import chain
+import re
+
+from .nodes import (
+    Argument,
+    Comment,
+    ExternalLink,
+    Heading,
+    HTMLEntity,
+    Tag,
+    Template,
+    Text,
+    Wikilink,
+)
+from .nodes.extras import Attribute, Parameter
+from .utils import normalize_spaces, normalize_title, render_title
+
+__all__ = ["SelectorError", "Selector", "compile_selector"]
+
+_TYPES = {
+    "template": Template,
+    "param": Parameter,
+    "parameter": Parameter,
+    "wikilink": Wikilink,
+    "extlink": ExternalLink,
+    "tag": Tag,
+    "attribute": Attribute,
+    "heading": Heading,
+    "argument": Argument,
+    "comment": Comment,
+    "text": Text,
+    "entity": HTMLEntity,
+}
+
+# Nodes that can't have children:
+_LEAVES = (Text, Comment, HTMLEntity)
+
+# Types that can only appear as children of certain others:
+_PARENTS = {Parameter: Template, Attribute: Tag}
+
+_TOKEN = re.compile(
+    r"\s*(?:(?P<op>[!^$*~]?=)|(?P<punct>[>,\[\]])|(?P<name>@?[A-Za-z_][\w-]*|\*))"
+)
+_VALUE = re.compile(
+    r"""\s*(?:"((?:[^"\\]|\\.)*)"|'((?:[^'\\]|\\.)*)'|([^\s\]]+))""", re.DOTALL
+)
+
+
+class SelectorError(ValueError):
+    """Raised when a selector can't be parsed."""
+
+
+def _render(obj):
+    return str(obj).strip()
+
+
+def _render_optional(obj):
+    return str(obj).strip() if obj is not None else None
+
+
+def _strip(value):
+    return value.strip()
+
+
+def _lower(value):
+    return value.strip().lower()
+
+
+# For each type and attribute: how to get and render the attribute, and how to
+# normalize a value to compare against it.
+_ATTRS = {
+    Template: {"name": (lambda n: render_title(n.name), normalize_title)},
+    Parameter: {
+        "name": (lambda n: _render(n.name), _strip),
+        "value": (lambda n: _render(n.value), _strip),
+    },
+    Wikilink: {
+        "title": (lambda n: render_title(n.title), normalize_title),
+        "text": (lambda n: _render_optional(n.text), _strip),
+    },
+    ExternalLink: {
+        "url": (lambda n: _render(n.url), _strip),
+        "title": (lambda n: _render_optional(n.title), _strip),
+    },
+    Tag: {"name": (lambda n: _render(n.tag).lower(), _lower)},
+    Attribute: {
+        "name": (lambda n: _render(n.name), _strip),
+        "value": (lambda n: _render_optional(n.value), _strip),
+    },
+    Heading: {
+        "title": (lambda n: _render(n.title), _strip),
+        "level": (lambda n: str(n.level), _strip),
+    },
+    Argument: {
+        "name": (lambda n: _render(n.name), _strip),
+        "default": (lambda n: _render_optional(n.default), _strip),
+    },
+    Comment: {"contents": (lambda n: _render(n.contents), _strip)},
+    Text: {"value": (lambda n: n.value.strip(), _strip)},
+    HTMLEntity: {"value": (lambda n: n.value, _strip)},
+}
+
+
+def _get_tag_attr(name):
+    """Return a getter for the value of an attribute of a :class:`.Tag`."""
+
+    def getter(node):
+        if not node.has(name):
+            return None
+        return _render_optional(node.get(name).value) or ""
+
+    return getter
+
+
+def _get_children(elem):
+    """Return an iterator over the children of an element in the tree."""
+    if isinstance(elem, Template):
+        return chain(elem.name.nodes, elem.params)
+    if isinstance(elem, (Parameter, Attribute)):
+        if elem.value is None:
+            return iter(elem.name.nodes)
+        return chain(elem.name.nodes, elem.value.nodes)
+    if isinstance(elem, Tag):
+        parts = [elem.attributes]
+        if not elem.wiki_markup:
+            parts.insert(0, elem.tag.nodes)
+        if not elem.self_closing:
+            parts.append(elem.contents.nodes)
+        return chain.from_iterable(parts)
+    return chain.from_iterable(code.nodes for code in elem.__children__())
+
+
+class _Predicate:
+    """A single bracketed condition on an attribute of an element.
+
+    Each type gets its own getter and test, since types normalize the values
+    of their attributes differently (template names are compared as titles,
+    for example, but parameter names aren't).
+    """
+
+    __slots__ = ("tests",)
+
+    def __init__(self, attr, op, value, ignore_case, types):
+        self.tests = {}
+        by_normalizer = {}
+        for cls in types:
+            if attr.startswith("@") and cls is Tag:
+                getter, normalizer = _get_tag_attr(attr[1:]), _strip
+            elif attr in _ATTRS[cls]:
+                getter, normalizer = _ATTRS[cls][attr]
+            else:
+                continue
+            if normalizer not in by_normalizer:
+                by_normalizer[normalizer] = self._make_test(
+                    op, value, ignore_case, normalizer
+                )
+            self.tests[cls] = (getter, by_normalizer[normalizer])
+
+    @staticmethod
+    def _make_test(op, value, ignore_case, normalizer):
+        """Return a function testing a rendered attribute against *value*."""
+        if op is None:
+            return lambda actual: True
+
+        if op in ("$=", "*=") and normalizer is normalize_title:
+            # The value isn't at the start of the title, so don't capitalize it:
+            normalizer = normalize_spaces
+        value = normalizer(value)
+        fold = str.casefold if ignore_case else lambda s: s
+        value = fold(value)
+        if op == "~=":
+            pattern = "".join(
+                ".*" if c == "*" else "." if c == "?" else re.escape(c) for c in value
+            )
+            match = re.compile(pattern, re.DOTALL).fullmatch
+            return lambda actual: match(fold(actual)) is not None
+        if op == "=":
+            return lambda actual: fold(actual) == value
+        if op == "!=":
+            return lambda actual: fold(actual) != value
+        if op == "^=":
+            return lambda actual: fold(actual).startswith(value)
+        if op == "$=":
+            return lambda actual: fold(actual).endswith(value)
+        return lambda actual: value in fold(actual)
+
+    def __call__(self, elem):
+        entry = self.tests.get(type(elem))
+        if entry is None:
+            return False
+        getter, test = entry
+        actual = getter(elem)
+        return actual is not None and test(actual)
+
+
+class _Compound:
+    """A type and a list of predicates, all of which an element must match."""
+
+    __slots__ = ("types", "predicates", "child", "parents")
+
+    def __init__(self, types, predicates, child):
+        self.types = types
+        self.predicates = predicates
+        self.child = child
+        parents = {_PARENTS.get(cls) for cls in types}
+        self.parents = parents.pop() if len(parents) == 1 else None
+
+    def test(self, elem):
+        """Return whether an element of one of our types matches."""
+        for predicate in self.predicates:
+            if not predicate(elem):
+                return False
+        return True
+
+
+class _Parser:
+    """Parses a selector into a list of lists of :class:`_Compound`\\ s."""
+
+    def __init__(self, text):
+        self._text = text
+        self._pos = 0
+
+    def _fail(self, message):
+        raise SelectorError(
+            "{} at position {} in selector {!r}".format(message, self._pos, self._text)
+        )
+
+    def _peek(self):
+        """Return the kind and value of the next token, skipping whitespace.
+
+        The kind is ``None`` at the end of the selector.
+        """
+        match = _TOKEN.match(self._text, self._pos)
+        if not match or match.lastgroup is None:
+            if self._text[self._pos :].strip():
+                self._fail("unexpected character")
+            return None, None
+        return match.lastgroup, match.group(match.lastgroup)
+
+    def _next(self):
+        token = self._peek()
+        if token[0] is not None:
+            self._pos = _TOKEN.match(self._text, self._pos).end()
+        return token
+
+    def _parse_value(self):
+        match = _VALUE.match(self._text, self._pos)
+        if not match:
+            self._fail("expected a value")
+        self._pos = match.end()
+        if match.group(3) is not None:
+            return match.group(3)
+        return re.sub(r"\\(.)", r"\1", match.group(1) or match.group(2) or "")
+
+    def _parse_predicate(self, types):
+        kind, attr = self._peek()
+        if kind != "name" or attr == "*":
+            self._fail("expected an attribute name")
+        if not any(attr.lower() in _ATTRS[cls] for cls in types):
+            if not (attr.startswith("@") and Tag in types):
+                self._fail("unknown attribute {!r}".format(attr))
+        self._next()
+        kind, op = self._next()
+        if (kind, op) == ("punct", "]"):
+            return _Predicate(attr.lower(), None, None, False, types)
+        if kind != "op":
+            self._fail("expected an operator or ']'")
+        value = self._parse_value()
+        ignore_case = self._peek() == ("name", "i")
+        if ignore_case:
+            self._next()
+        if self._next() != ("punct", "]"):
+            self._fail("expected ']'")
+        return _Predicate(attr.lower(), op, value, ignore_case, types)
+
+    def _parse_compound(self, child):
+        while self._text[self._pos : self._pos + 1].isspace():
+            self._pos += 1
+        kind, value = self._peek()
+        types = tuple(_ATTRS)
+        if kind == "name" and not value.startswith("@"):
+            if value != "*":
+                if value.lower() not in _TYPES:
+                    self._fail("unknown type {!r}".format(value))
+                types = (_TYPES[value.lower()],)
+            self._next()
+        elif (kind, value) != ("punct", "["):
+            self._fail("expected a type or '['")
+        predicates = []
+        while self._text.startswith("[", self._pos):
+            self._next()
+            predicates.append(self._parse_predicate(types))
+        return _Compound(types, predicates, child)
+
+    def _parse_selector(self):
+        child = self._peek() == ("punct", ">")
+        if child:
+            self._next()
+        compounds = [self._parse_compound(child)]
+        while True:
+            spaced = self._text[self._pos : self._pos + 1].isspace()
+            token = self._peek()
+            if token[0] is None or token == ("punct", ","):
+                return compounds
+            child = token == ("punct", ">")
+            if child:
+                self._next()
+            elif not spaced:
+                self._fail("expected a combinator")
+            compounds.append(self._parse_compound(child))
+
+    def parse(self):
+        selectors = [self._parse_selector()]
+        while self._next() == ("punct", ","):
+            selectors.append(self._parse_selector())
+        if self._peek()[0] is not None:
+            self._fail("unexpected {!r}".format(self._peek()[1]))
+        return selectors
+
+
+class _Plan:
+    """A set of active states, with the work to do for each type of element.
+
+    A state is a tuple of a selector's index, the index of the compound to
+    match next, and whether it must match a direct child. Plans are built
+    lazily and shared, so walking a tree mostly consists of dictionary lookups.
+    """
+
+    __slots__ = ("states", "steps")
+
+    def __init__(self, states):
+        self.states = states
+        self.steps = {}
+
+
+class Selector:
+    """A compiled selector, which can find its matches in :class:`.Wikicode`.
+
+    Use :func:`compile_selector` to create one, or pass a string directly to
+    :meth:`.Wikicode.select`. See the module documentation for the syntax.
+    """
+
+    def __init__(self, text):
+        self._text = text
+        self._selectors = _Parser(text).parse()
+        self._plans = {}
+        self._root = self._get_plan(
+            tuple((i, 0, sel[0].child) for i, sel in enumerate(self._selectors))
+        )
+
+    def __repr__(self):
+        return "Selector({!r})".format(self._text)
+
+    def _get_plan(self, states):
+        """Return the shared :class:`_Plan` for a tuple of states, or None."""
+        if not states:
+            return None
+        plan = self._plans.get(states)
+        if plan is None:
+            plan = self._plans[states] = _Plan(states)
+        return plan
+
+    def _get_step(self, plan, cls):
+        """Return what to do with an element of type *cls* under a plan.
+
+        This is a tuple of the plan for its children if nothing matches it,
+        the states that carry over to its children regardless, and a list of
+        ``(compound, next state)`` pairs to test it against, where the next
+        state is ``None`` for the last compound in a selector. Compounds that
+        can't match this type are left out, as are next states that could
+        only match children of some other type.
+        """
+        carry = []
+        candidates = []
+        for state in plan.states:
+            index, pos, child = state
+            if not child:
+                carry.append(state)
+            compounds = self._selectors[index]
+            compound = compounds[pos]
+            if not issubclass(cls, compound.types):
+                continue
+            if pos + 1 == len(compounds):
+                candidates.append((compound, None))
+                continue
+            following = compounds[pos + 1]
+            if following.child and following.parents is not None:
+                if not issubclass(cls, following.parents):
+                    continue
+            candidates.append((compound, (index, pos + 1, following.child)))
+
+        if issubclass(cls, _LEAVES):
+            step = (None, (), [(c, None) for c, nxt in candidates if nxt is None])
+        else:
+            step = (self._get_plan(tuple(carry)), tuple(carry), candidates)
+        plan.steps[cls] = step
+        return step
+
+    def iselect(self, code):
+        """Iterate over the elements of *code* matching the selector.
+
+        *code* is a :class:`.Wikicode` object. Elements are yielded in the
+        order they appear in the text, and are usually :class:`.Node`\\ s, but
+        may be :class:`.Parameter`\\ s or :class:`.Attribute`\\ s.
+        """
+        stack = [(iter(code.nodes), self._root)]
+        while stack:
+            children, plan = stack[-1]
+            elem = next(children, None)
+            if elem is None:
+                stack.pop()
+                continue
+            step = plan.steps.get(type(elem))
+            if step is None:
+                step = self._get_step(plan, type(elem))
+            following, carry, candidates = step
+            if candidates:
+                matched = False
+                found = []
+                for compound, state in candidates:
+                    if compound.test(elem):
+                        if state is None:
+                            matched = True
+                        else:
+                            found.append(state)
+                if matched:
+                    yield elem
+                if found:
+                    states = tuple(dict.fromkeys(carry + tuple(found)))
+                    following = self._get_plan(states)
+            if following is not None:
+                stack.append((_get_children(elem), following))
+
+    def select(self, code):
+        """Return a list of the elements of *code* matching the selector.
+
+        This is equivalent to calling :func:`list` on :meth:`iselect`.
+        """
+        return list(self.iselect(code))
+
+
+@lru_cache(maxsize=256)
+def compile_selector(text):
+    """Compile a selector string into a :class:`Selector`.
+
+    Compiled selectors are cached, so calling this again with the same string
+    is cheap. Raises :exc:`SelectorError` if the selector is invalid.
+    """
+    return Selector(text)
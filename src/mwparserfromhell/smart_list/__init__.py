@@ -22,8 +22,10 @@
 """
 This module contains the :class:`.SmartList` type, as well as its
 :class:`.ListProxy` child, which together implement a list whose sublists
-reflect changes made to the main list, and vice-versa.
+reflect changes made to the main list, and vice-versa. Very long lists use
+:class:`.ChunkedSmartList`, which keeps its elements in chunks.
 """
 
+from .chunked_list import ChunkedList
 from .list_proxy import ListProxy as _ListProxy
-from .smart_list import SmartList
+from .smart_list import ChunkedSmartList, SmartList
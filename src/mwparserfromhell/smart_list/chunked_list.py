@@ -0,0 +1,356 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+from itertools import islice
+from sys import maxsize
+
+from .utils import inheritdoc
+
+
+class ChunkedList(list):
+    """Implement the ``list`` interface by storing elements in chunks.
+
+    The elements are split into a sequence of short lists, and the length of
+    each is kept in a Fenwick tree, so finding, inserting, or removing an
+    element at any index takes logarithmic time instead of shifting every
+    element after it. The underlying ``list`` storage is always empty; every
+    ``list`` method is overridden to use the chunks instead.
+    """
+
+    CHUNK_SIZE = 512
+
+    def __init__(self, iterable=None):
+        super().__init__()
+        self._load(list(iterable) if iterable is not None else [])
+
+    def __reduce_ex__(self, protocol):
+        return (type(self), (self._as_list(),))
+
+    def __repr__(self):
+        return repr(self._as_list())
+
+    def _compare(self, other, op):
+        """Compare this list with *other* using the given list method."""
+        if not isinstance(other, list):
+            return NotImplemented
+        return op(self._as_list(), list(other))
+
+    def __lt__(self, other):
+        return self._compare(other, list.__lt__)
+
+    def __le__(self, other):
+        return self._compare(other, list.__le__)
+
+    def __eq__(self, other):
+        return self._compare(other, list.__eq__)
+
+    def __ne__(self, other):
+        return self._compare(other, list.__ne__)
+
+    def __gt__(self, other):
+        return self._compare(other, list.__gt__)
+
+    def __ge__(self, other):
+        return self._compare(other, list.__ge__)
+
+    __hash__ = None
+
+    def __bool__(self):
+        return self._len > 0
+
+    def __len__(self):
+        return self._len
+
+    def __getitem__(self, key):
+        if isinstance(key, slice):
+            start, stop, step = key.indices(self._len)
+            if step != 1:
+                return self._as_list()[key]
+            return self._get_range(start, stop)
+        chunk, offset = self._locate(self._check_index(key))
+        return self._chunks[chunk][offset]
+
+    def __setitem__(self, key, item):
+        if isinstance(key, slice):
+            start, stop, step = key.indices(self._len)
+            if step != 1:
+                items = self._as_list()
+                items[key] = item
+                self._load(items)
+                return
+            self._replace(start, max(start, stop), list(item))
+            return
+        chunk, offset = self._locate(self._check_index(key, "assignment "))
+        self._chunks[chunk][offset] = item
+
+    def __delitem__(self, key):
+        if isinstance(key, slice):
+            start, stop, step = key.indices(self._len)
+            if step != 1:
+                items = self._as_list()
+                del items[key]
+                self._load(items)
+                return
+            if start < stop:
+                self._replace(start, stop, [])
+            return
+        chunk, offset = self._locate(self._check_index(key, "assignment "))
+        del self._chunks[chunk][offset]
+        self._add(chunk, -1)
+        self._balance(chunk)
+
+    def __iter__(self):
+        index = 0
+        while index < self._len:
+            version = self._version
+            chunk, offset = self._locate(index)
+            for item in islice(self._chunks[chunk], offset, None):
+                yield item
+                index += 1
+                if self._version != version:
+                    break
+
+    def __reversed__(self):
+        index = self._len - 1
+        while index >= 0:
+            if index < self._len:
+                yield self[index]
+            index -= 1
+
+    def __contains__(self, item):
+        return any(item in chunk for chunk in self._chunks)
+
+    def __add__(self, other):
+        if not isinstance(other, list):
+            return NotImplemented
+        return self._as_list() + list(other)
+
+    def __radd__(self, other):
+        if not isinstance(other, list):
+            return NotImplemented
+        return list(other) + self._as_list()
+
+    def __iadd__(self, other):
+        self.extend(other)
+        return self
+
+    def __mul__(self, other):
+        return self._as_list() * other
+
+    def __rmul__(self, other):
+        return other * self._as_list()
+
+    def __imul__(self, other):
+        self._load(self._as_list() * other)
+        return self
+
+    def _load(self, items):
+        """Replace the contents of the list with *items*, a ``list``."""
+        size = self.CHUNK_SIZE
+        self._chunks = [items[i : i + size] for i in range(0, len(items), size)]
+        self._rebuild()
+
+    def _rebuild(self):
+        """Rebuild the tree of chunk lengths after chunks were changed."""
+        chunks = [chunk for chunk in self._chunks if chunk] or [[]]
+        tree = [0] + [len(chunk) for chunk in chunks]
+        for i in range(1, len(tree)):
+            parent = i + (i & -i)
+            if parent < len(tree):
+                tree[parent] += tree[i]
+        self._chunks = chunks
+        self._tree = tree
+        self._top = 1 << (len(chunks).bit_length() - 1)
+        self._len = sum(len(chunk) for chunk in chunks)
+        self._version = getattr(self, "_version", 0) + 1
+
+    def _add(self, chunk, delta):
+        """Add *delta* to the stored length of the given chunk."""
+        tree = self._tree
+        i = chunk + 1
+        while i < len(tree):
+            tree[i] += delta
+            i += i & -i
+        self._len += delta
+        self._version += 1
+
+    def _locate(self, index):
+        """Return the chunk number and offset of the element at *index*.
+
+        If *index* is the length of the list, the position just past the end
+        of the last chunk is returned.
+        """
+        if index >= self._len:
+            return len(self._chunks) - 1, index - self._len + len(self._chunks[-1])
+        tree = self._tree
+        pos = 0
+        bit = self._top
+        while bit:
+            nxt = pos + bit
+            if nxt < len(tree) and tree[nxt] <= index:
+                index -= tree[nxt]
+                pos = nxt
+            bit >>= 1
+        return pos, index
+
+    def _check_index(self, index, kind=""):
+        """Normalize an integer index, raising IndexError if out of range."""
+        index = index.__index__()
+        if index < 0:
+            index += self._len
+        if index < 0 or index >= self._len:
+            raise IndexError("list {}index out of range".format(kind))
+        return index
+
+    def _as_list(self):
+        """Return the elements of the list as a plain ``list``."""
+        items = []
+        for chunk in self._chunks:
+            items += chunk
+        return items
+
+    def _get_range(self, start, stop):
+        """Return the elements from *start* to *stop* as a plain ``list``."""
+        if start >= stop:
+            return []
+        chunk, offset = self._locate(start)
+        items = []
+        remaining = stop - start
+        while remaining > 0:
+            part = self._chunks[chunk][offset : offset + remaining]
+            items += part
+            remaining -= len(part)
+            chunk += 1
+            offset = 0
+        return items
+
+    def _replace(self, start, stop, items):
+        """Replace the elements from *start* to *stop* with *items*."""
+        first, offset = self._locate(start)
+        chunk = self._chunks[first]
+        if offset + stop - start <= len(chunk):
+            chunk[offset : offset + stop - start] = items
+            self._add(first, len(items) - (stop - start))
+            self._balance(first)
+            return
+        last, _ = self._locate(stop - 1)
+        merged = []
+        for part in self._chunks[first : last + 1]:
+            merged += part
+        merged[offset : offset + stop - start] = items
+        self._chunks[first : last + 1] = [merged]
+        self._split(first, first + 1)
+
+    def _balance(self, chunk):
+        """Split a chunk that has grown too long, or merge one too short."""
+        length = len(self._chunks[chunk])
+        if length > 2 * self.CHUNK_SIZE:
+            self._split(chunk, chunk + 1)
+        elif (not length or length * 4 < self.CHUNK_SIZE) and len(self._chunks) > 1:
+            if chunk + 1 < len(self._chunks):
+                self._split(chunk, chunk + 2)
+            else:
+                self._split(chunk - 1, chunk + 1)
+
+    def _split(self, first, last):
+        """Split the chunks from *first* to *last* into even-sized chunks.
+
+        Each new chunk holds between one and two times ``CHUNK_SIZE`` elements,
+        unless there are fewer elements than that in total.
+        """
+        merged = []
+        for part in self._chunks[first:last]:
+            merged += part
+        count = max(len(merged) // self.CHUNK_SIZE, 1)
+        bounds = [len(merged) * i // count for i in range(count + 1)]
+        self._chunks[first:last] = [
+            merged[bounds[i] : bounds[i + 1]] for i in range(count)
+        ]
+        self._rebuild()
+
+    @inheritdoc
+    def append(self, item):
+        self._replace(self._len, self._len, [item])
+
+    @inheritdoc
+    def extend(self, item):
+        self._replace(self._len, self._len, list(item))
+
+    @inheritdoc
+    def insert(self, index, item):
+        index = index.__index__()
+        if index < 0:
+            index = max(index + self._len, 0)
+        index = min(index, self._len)
+        self._replace(index, index, [item])
+
+    @inheritdoc
+    def pop(self, index=-1):
+        if not self._len:
+            raise IndexError("pop from empty list")
+        index = self._check_index(index)
+        item = self[index]
+        del self[index]
+        return item
+
+    @inheritdoc
+    def remove(self, item):
+        del self[self.index(item)]
+
+    @inheritdoc
+    def index(self, item, start=0, stop=maxsize):
+        start, stop, _ = slice(start, stop).indices(self._len)
+        if start < stop:
+            chunk, offset = self._locate(start)
+            index = start - offset
+            for part in self._chunks[chunk:]:
+                if index >= stop:
+                    break
+                try:
+                    return index + part.index(item, offset, stop - index)
+                except ValueError:
+                    pass
+                index += len(part)
+                offset = 0
+        raise ValueError("{!r} is not in list".format(item))
+
+    @inheritdoc
+    def count(self, item):
+        return sum(chunk.count(item) for chunk in self._chunks)
+
+    @inheritdoc
+    def copy(self):
+        return self._as_list()
+
+    @inheritdoc
+    def clear(self):
+        self._load([])
+
+    @inheritdoc
+    def reverse(self):
+        items = self._as_list()
+        items.reverse()
+        self._load(items)
+
+    @inheritdoc
+    def sort(self, *, key=None, reverse=False):
+        items = self._as_list()
+        items.sort(key=key, reverse=reverse)
+        self._load(items)
@@ -148,6 +148,11 @@ class ListProxy(_SliceNormalizerMixIn, list):
         self.extend(list(self) * (other - 1))
         return self
 
+    @property
+    def _tracks_changes(self):
+        """Whether changes to this list call :func:`.utils.mark_changed`."""
+        return getattr(self._parent, "_tracks_changes", False)
+
     @property
     def _start(self):
         """The starting index of this list, inclusive."""
@@ -21,8 +21,13 @@
 
 from weakref import ref
 
+from .chunked_list import ChunkedList
 from .list_proxy import ListProxy
 from .utils import _SliceNormalizerMixIn, inheritdoc
+from ..utils import mark_changed
+
+# Lists longer than this are stored in chunks; see ChunkedSmartList:
+CHUNKED_THRESHOLD = 20000
 
 
 class SmartList(_SliceNormalizerMixIn, list):
@@ -47,8 +52,23 @@ class SmartList(_SliceNormalizerMixIn, list):
         [2, 3, 4]
         >>> parent
         [0, 1, 2, 3, 4]
+
+    Lists with more than ``CHUNKED_THRESHOLD`` elements are created as, or
+    converted to, :class:`.ChunkedSmartList`\\ s, which behave the same way
+    but can insert and remove elements from the middle of the list quickly.
     """
 
+    _tracks_changes = True
+
+    def __new__(cls, iterable=None):
+        if (
+            cls is SmartList
+            and hasattr(iterable, "__len__")
+            and len(iterable) > CHUNKED_THRESHOLD
+        ):
+            cls = ChunkedSmartList
+        return super().__new__(cls)
+
     def __init__(self, iterable=None):
         if iterable:
             super().__init__(iterable)
@@ -67,6 +87,7 @@ class SmartList(_SliceNormalizerMixIn, list):
         return child
 
     def __setitem__(self, key, item):
+        mark_changed()
         if not isinstance(key, slice):
             super().__setitem__(key, item)
             return
@@ -76,6 +97,8 @@ class SmartList(_SliceNormalizerMixIn, list):
         diff = len(item) + (key.start - key.stop) // key.step
         if not diff:
             return
+        if diff > 0 and type(self) is SmartList and len(self) > CHUNKED_THRESHOLD:
+            self._convert_to_chunked()
         for child, (start, stop, _step) in self._children.values():
             if start > key.stop:
                 self._children[id(child)][1][0] += diff
@@ -83,6 +106,7 @@ class SmartList(_SliceNormalizerMixIn, list):
                 self._children[id(child)][1][1] += diff
 
     def __delitem__(self, key):
+        mark_changed()
         super().__delitem__(key)
         if isinstance(key, slice):
             key = self._normalize_slice(key, clamp=True)
@@ -105,10 +129,21 @@ class SmartList(_SliceNormalizerMixIn, list):
         self.extend(other)
         return self
 
+    def __imul__(self, other):
+        mark_changed()
+        return super().__imul__(other)
+
     def _delete_child(self, child_ref):
         """Remove a child reference that is about to be garbage-collected."""
         del self._children[id(child_ref)]
 
+    def _convert_to_chunked(self):
+        """Move our elements into chunked storage, keeping our children."""
+        items = list.copy(self)
+        list.clear(self)
+        self.__class__ = ChunkedSmartList
+        self._load(items)
+
     def _detach_children(self):
         """Remove all children and give them independent parent copies."""
         children = [val[0] for val in self._children.values()]
@@ -142,13 +177,19 @@ class SmartList(_SliceNormalizerMixIn, list):
     def remove(self, item):
         del self[self.index(item)]
 
+    @inheritdoc
+    def clear(self):
+        del self[:]
+
     @inheritdoc
     def reverse(self):
+        mark_changed()
         self._detach_children()
         super().reverse()
 
     @inheritdoc
     def sort(self, key=None, reverse=None):
+        mark_changed()
         self._detach_children()
         kwargs = {}
         if key is not None:
@@ -156,3 +197,13 @@ class SmartList(_SliceNormalizerMixIn, list):
         if reverse is not None:
             kwargs["reverse"] = reverse
         super().sort(**kwargs)
+
+
+class ChunkedSmartList(SmartList, ChunkedList):
+    """A :class:`.SmartList` whose elements are stored in chunks.
+
+    This has the same interface as :class:`.SmartList`, but its elements are
+    kept in a :class:`.ChunkedList`, so inserting, removing, or looking up an
+    element anywhere in the list takes logarithmic time. It is used
+    automatically for very long lists, such as the nodes of a huge page.
+    """
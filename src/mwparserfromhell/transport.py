@@ -0,0 +1,313 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Contains tools for passing :class:`.RecordBatch` objects between processes
+through shared memory, instead of pickling their rows.
+
+:func:`write_batch` lays out a batch in a buffer as a small self-describing
+header followed by the raw column buffers, and :func:`read_batch` wraps such a
+buffer as a batch whose columns are :class:`memoryview` objects into it, with
+no copying or decoding. Since the columns of a batch hold strings as UTF-8
+data, a parse tree can be sent the same way as one of its exports, such as
+:meth:`.Wikicode.to_json` in a string column.
+
+A :class:`SegmentPool` manages a set of reusable
+:class:`multiprocessing.shared_memory.SharedMemory` segments: worker processes
+write batches into free segments with a :class:`SegmentWriter` and send back a
+small :class:`SegmentHandle`, and the parent reads the batch in place and
+returns the segment to the pool once it is done with it.
+"""
+
+from collections import namedtuple
+import json
+import multiprocessing
+import struct
+
+from .batches import RecordBatch, StringColumn
+
+try:
+    from multiprocessing import shared_memory
+except ImportError:  # Python < 3.8
+    shared_memory = None
+
+__all__ = [
+    "SegmentHandle",
+    "SegmentPool",
+    "SegmentWriter",
+    "batch_nbytes",
+    "read_batch",
+    "write_batch",
+]
+
+#: Identifies a batch written into a segment: the segment's name, the size of
+#: the batch in bytes, and whether the segment belongs to the pool (otherwise,
+#: it was made for this batch alone and is removed once the batch is released).
+SegmentHandle = namedtuple("SegmentHandle", ["name", "nbytes", "pooled"])
+
+# The header is a magic number, a format version, and the size of the JSON
+# directory that follows it. Column buffers come after, aligned to 8 bytes.
+_HEADER = struct.Struct("<4sII")
+_MAGIC = b"MWPB"
+_VERSION = 1
+_ALIGN = 8
+
+
+def _align(offset):
+    return (offset + _ALIGN - 1) // _ALIGN * _ALIGN
+
+
+def _layout(batch):
+    """Return the directory of a batch, its buffers, and its total size."""
+    buffers = []
+    columns = []
+    for name, kind in batch.schema:
+        column = batch[name]
+        if kind == "string":
+            parts = (column.offsets, column.data)
+        else:
+            parts = (column,)
+        columns.append([name, kind, len(buffers)])
+        buffers.extend(memoryview(part).cast("B") for part in parts)
+
+    directory = {"rows": len(batch), "columns": columns, "buffers": []}
+    # Buffer offsets are relative to the end of the directory, so they don't
+    # depend on its own length:
+    offset = 0
+    for buf in buffers:
+        directory["buffers"].append([offset, len(buf)])
+        offset = _align(offset + len(buf))
+    encoded = json.dumps(directory, separators=(",", ":")).encode("utf8")
+    start = _align(_HEADER.size + len(encoded))
+    return encoded, buffers, start, start + offset
+
+
+def batch_nbytes(batch):
+    """Return the number of bytes :func:`write_batch` needs for *batch*."""
+    return _layout(batch)[3]
+
+
+def write_batch(batch, buffer):
+    """Write a :class:`.RecordBatch` into a writable *buffer*.
+
+    Return the number of bytes written, or raise :exc:`ValueError` if the
+    buffer is too small.
+    """
+    encoded, buffers, start, size = _layout(batch)
+    out = memoryview(buffer).cast("B")
+    if len(out) < size:
+        raise ValueError("Buffer too small: {} < {}".format(len(out), size))
+    _HEADER.pack_into(out, 0, _MAGIC, _VERSION, len(encoded))
+    out[_HEADER.size : _HEADER.size + len(encoded)] = encoded
+    offset = start
+    for buf in buffers:
+        out[offset : offset + len(buf)] = buf
+        offset = _align(offset + len(buf))
+    return size
+
+
+def read_batch(buffer):
+    """Return a :class:`.RecordBatch` for a batch written by :func:`write_batch`.
+
+    The batch's columns are read-only views into *buffer*, which must stay
+    alive and unchanged for as long as the batch is used.
+    """
+    view = memoryview(buffer).cast("B")
+    if not view.readonly and hasattr(view, "toreadonly"):
+        view = view.toreadonly()
+    magic, version, length = _HEADER.unpack_from(view, 0)
+    if magic != _MAGIC:
+        raise ValueError("Not a record batch")
+    if version != _VERSION:
+        raise ValueError("Unsupported record batch version: {}".format(version))
+    end = _HEADER.size + length
+    directory = json.loads(str(view[_HEADER.size : end], "utf8"))
+    start = _align(end)
+
+    def get_buffer(index, fmt):
+        offset, size = directory["buffers"][index]
+        return view[start + offset : start + offset + size].cast(fmt)
+
+    schema = []
+    columns = {}
+    for name, kind, index in directory["columns"]:
+        schema.append((name, kind))
+        if kind == "string":
+            column = StringColumn.__new__(StringColumn)
+            column.offsets = get_buffer(index, "q")
+            column.data = get_buffer(index + 1, "B")
+        elif kind == "int64":
+            column = get_buffer(index, "q")
+        else:
+            raise ValueError("Unknown column type: {!r}".format(kind))
+        columns[name] = column
+    return RecordBatch._from_columns(schema, columns)
+
+
+def _require_shared_memory():
+    if shared_memory is None:
+        raise NotImplementedError("Shared memory requires Python 3.8 or later")
+
+
+class SegmentWriter:
+    """Writes batches into the free segments of a :class:`SegmentPool`.
+
+    Writers are made by :attr:`SegmentPool.writer` and are meant to be passed
+    to worker processes when they are started, as an argument of
+    :class:`multiprocessing.Process` or of a pool's initializer.
+    """
+
+    def __init__(self, free, size):
+        self._free = free
+        self._size = size
+        self._attached = {}
+
+    def __getstate__(self):
+        return (self._free, self._size)
+
+    def __setstate__(self, state):
+        self._free, self._size = state
+        self._attached = {}
+
+    def write(self, batch, timeout=None):
+        """Write *batch* into a free segment and return its handle.
+
+        This waits up to *timeout* seconds (forever if ``None``) for a segment
+        to be released, raising :exc:`queue.Empty` if none is. A batch larger
+        than the pool's segments gets a new segment of its own instead.
+        """
+        _require_shared_memory()
+        size = batch_nbytes(batch)
+        if size > self._size:
+            segment = shared_memory.SharedMemory(create=True, size=size)
+            try:
+                write_batch(batch, segment.buf)
+            finally:
+                segment.close()
+            return SegmentHandle(segment.name, size, False)
+
+        name = self._free.get(timeout=timeout)
+        segment = self._attached.get(name)
+        if segment is None:
+            segment = shared_memory.SharedMemory(name)
+            self._attached[name] = segment
+        write_batch(batch, segment.buf)
+        return SegmentHandle(name, size, True)
+
+
+class SegmentPool:
+    """A pool of reusable shared memory segments for passing batches.
+
+    The pool makes *count* segments of *size* bytes each. *context* is the
+    :mod:`multiprocessing` context used for the queue of free segments. The
+    process that owns the pool reads batches with :meth:`read` or
+    :meth:`open`, and must :meth:`release` each handle once it no longer
+    needs the batch, so that its segment can be reused. A batch's columns
+    can't be accessed after it is released.
+
+    The segments are removed by :meth:`close`, or when the pool is used as a
+    context manager and exits.
+    """
+
+    def __init__(self, count=4, size=4 * 1024 * 1024, context=None):
+        _require_shared_memory()
+        if count < 1 or size < 1:
+            raise ValueError("count and size must be positive")
+        context = context or multiprocessing.get_context()
+        self._size = size
+        self._free = context.Queue()
+        self._segments = {}
+        self._views = {}
+        for _ in range(count):
+            segment = shared_memory.SharedMemory(create=True, size=size)
+            self._segments[segment.name] = segment
+            self._free.put(segment.name)
+        self._writer = SegmentWriter(self._free, size)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    @property
+    def writer(self):
+        """The :class:`SegmentWriter` for worker processes to use."""
+        return self._writer
+
+    def read(self, handle):
+        """Return the :class:`.RecordBatch` in a segment, without copying it."""
+        if handle.pooled:
+            segment = self._segments[handle.name]
+        else:
+            segment = shared_memory.SharedMemory(handle.name)
+        view = segment.buf[: handle.nbytes]
+        batch = read_batch(view)
+        self._views.setdefault(handle.name, []).append((segment, view, batch))
+        return batch
+
+    def release(self, handle):
+        """Stop using the batch in a segment, and make the segment reusable."""
+        segment = None
+        for segment, view, batch in self._views.pop(handle.name, []):
+            for column in batch._columns.values():
+                if isinstance(column, StringColumn):
+                    column.offsets.release()
+                    column.data.release()
+                else:
+                    column.release()
+            view.release()
+        if handle.pooled:
+            self._free.put(handle.name)
+        else:
+            if segment is None:
+                segment = shared_memory.SharedMemory(handle.name)
+            segment.close()
+            segment.unlink()
+
+    def open(self, handle):
+        """Return a context manager for reading and then releasing a batch."""
+        return _Reading(self, handle)
+
+    def close(self):
+        """Release every batch being read and remove the pool's segments."""
+        for name in list(self._views):
+            pooled = name in self._segments
+            self.release(SegmentHandle(name, 0, pooled))
+        for segment in self._segments.values():
+            segment.close()
+            segment.unlink()
+        self._segments = {}
+        self._free.close()
+
+
+class _Reading:
+    """Context manager returned by :meth:`SegmentPool.open`."""
+
+    def __init__(self, pool, handle):
+        self._pool = pool
+        self._handle = handle
+
+    def __enter__(self):
+        return self._pool.read(self._handle)
+
+    def __exit__(self, *args):
+        self._pool.release(self._handle)
@@ -23,10 +23,132 @@ This module contains accessory functions for other parts of the library. Parser
 users generally won't need stuff from here.
 """
 
-__all__ = ["parse_anything"]
+from functools import lru_cache
+import re
 
+__all__ = [
+    "TrackedList",
+    "get_changes",
+    "get_spans",
+    "is_tracked",
+    "iter_layout",
+    "mark_changed",
+    "normalize_spaces",
+    "normalize_title",
+    "parse_anything",
+    "render_title",
+]
 
-def parse_anything(value, context=0, skip_style_tags=False):
+# The number of changes made to any tree, for invalidating cached positions:
+_changes = 0
+
+
+def mark_changed():
+    """Record that a tree was changed.
+
+    This is called by every node property setter and by the methods that
+    change the contents of :class:`.SmartList` and :class:`TrackedList`
+    objects. It invalidates the positional indexes of all :class:`.Wikicode`
+    objects.
+    """
+    global _changes  # pylint: disable=global-statement
+    _changes += 1
+
+
+def get_changes():
+    """Return the number of changes made to any tree so far."""
+    return _changes
+
+
+def _tracked(method):
+    """Wrap a :class:`list` method so it calls :func:`mark_changed` first."""
+
+    def wrapper(self, *args, **kwargs):
+        mark_changed()
+        return method(self, *args, **kwargs)
+
+    wrapper.__name__ = method.__name__
+    wrapper.__doc__ = method.__doc__
+    return wrapper
+
+
+class TrackedList(list):
+    """A :class:`list` that calls :func:`mark_changed` whenever it's changed.
+
+    This is used for node attributes that are lists of other objects, like
+    :attr:`.Template.params` and :attr:`.Tag.attributes`, so that editing
+    them directly invalidates positional indexes like any other change.
+    """
+
+    __slots__ = ()
+    _tracks_changes = True
+
+    __setitem__ = _tracked(list.__setitem__)
+    __delitem__ = _tracked(list.__delitem__)
+    __iadd__ = _tracked(list.__iadd__)
+    __imul__ = _tracked(list.__imul__)
+    append = _tracked(list.append)
+    extend = _tracked(list.extend)
+    insert = _tracked(list.insert)
+    pop = _tracked(list.pop)
+    remove = _tracked(list.remove)
+    clear = _tracked(list.clear)
+    reverse = _tracked(list.reverse)
+    sort = _tracked(list.sort)
+
+
+def normalize_spaces(value):
+    """Normalize the whitespace and underscores in part of a page title."""
+    return re.sub(r"[\s_]+", " ", value).strip()
+
+
+def normalize_title(value):
+    """Normalize a page title like MediaWiki does.
+
+    Runs of whitespace and underscores become single spaces, surrounding
+    whitespace is removed, and the first letter is capitalized. This is looser
+    than :meth:`.Wikicode.matches`, which only treats each underscore as a
+    space and doesn't collapse runs of them.
+    """
+    value = normalize_spaces(value)
+    return value[:1].upper() + value[1:]
+
+
+def render_title(code):
+    """Return the normalized title in a :class:`.Wikicode` object.
+
+    Titles made only of text are joined directly; others, like template names
+    with comments or transclusions in them, go through
+    :meth:`.Wikicode.strip_code` first.
+    """
+    # pylint: disable=cyclic-import,import-outside-toplevel
+    from .nodes import Text
+
+    nodes = code.nodes
+    if all(type(node) is Text for node in nodes):
+        return normalize_title("".join(node.value for node in nodes))
+    return normalize_title(code.strip_code())
+
+
+def is_tracked(items):
+    """Return whether changes to the list *items* call :func:`mark_changed`.
+
+    This is true of :class:`.SmartList` and :class:`TrackedList` objects, and
+    of slices of the former, but not of plain lists, which nodes and
+    :class:`.Wikicode` objects also accept. Positional indexes that cover
+    plain lists aren't cached, since edits to them can't be seen.
+    """
+    return getattr(items, "_tracks_changes", False)
+
+
+def parse_anything(
+    value,
+    context=0,
+    skip_style_tags=False,
+    drop_comments=False,
+    view=None,
+    max_parse_depth=None,
+):
     """Return a :class:`.Wikicode` for *value*, allowing multiple types.
 
     This differs from :meth:`.Parser.parse` in that we accept more than just a
@@ -49,20 +171,23 @@ def parse_anything(value, context=0, skip_style_tags=False):
         return value
     if isinstance(value, Node):
         return Wikicode(SmartList([value]))
+    args = (context, skip_style_tags, drop_comments, view)
     if isinstance(value, str):
-        return Parser().parse(value, context, skip_style_tags)
+        return Parser().parse(value, *args, max_parse_depth=max_parse_depth)
     if isinstance(value, bytes):
-        return Parser().parse(value.decode("utf8"), context, skip_style_tags)
+        return Parser().parse(
+            value.decode("utf8"), *args, max_parse_depth=max_parse_depth
+        )
     if isinstance(value, int):
-        return Parser().parse(str(value), context, skip_style_tags)
+        return Parser().parse(str(value), *args, max_parse_depth=max_parse_depth)
     if value is None:
         return Wikicode(SmartList())
     if hasattr(value, "read"):
-        return parse_anything(value.read(), context, skip_style_tags)
+        return parse_anything(value.read(), *args, max_parse_depth)
     try:
         nodelist = SmartList()
         for item in value:
-            nodelist += parse_anything(item, context, skip_style_tags).nodes
+            nodelist += parse_anything(item, *args, max_parse_depth).nodes
         return Wikicode(nodelist)
     except TypeError as exc:
         error = (
@@ -70,3 +195,164 @@ def parse_anything(value, context=0, skip_style_tags=False):
             "iterable of these, but got {0}: {1}"
         )
         raise ValueError(error.format(type(value).__name__, value)) from exc
+
+
+@lru_cache(maxsize=None)
+def _layout_types():
+    """Return the classes used by :func:`iter_layout`, imported only once."""
+    # pylint: disable=cyclic-import,import-outside-toplevel
+    from .nodes import Argument, ExternalLink, Heading, Tag, Template, Wikilink
+    from .nodes.extras import Attribute, Parameter
+
+    return (
+        Argument,
+        ExternalLink,
+        Heading,
+        Tag,
+        Template,
+        Wikilink,
+        Attribute,
+        Parameter,
+    )
+
+
+def iter_layout(node, extras=False):
+    """Yield the parts of a :class:`.Node`'s text in order.
+
+    Parts are integers, for the lengths of markup, and :class:`.Wikicode`
+    objects, for children that appear in the text, so that the length of the
+    node is the sum of the integers and of the lengths of the children.
+
+    *node* can also be a :class:`.Parameter` or an :class:`.Attribute`. If
+    *extras* is ``True``, the parameters of templates and the attributes of
+    tags are yielded as themselves instead of as their parts, which can be
+    found by calling this function on them in turn.
+    """
+    (
+        Argument,
+        ExternalLink,
+        Heading,
+        Tag,
+        Template,
+        Wikilink,
+        Attribute,
+        Parameter,
+    ) = _layout_types()
+
+    if isinstance(node, Template):
+        yield 2
+        yield node.name
+        for param in node.params:
+            yield 1
+            if extras:
+                yield param
+            else:
+                yield from iter_layout(param)
+        yield 2
+    elif isinstance(node, Parameter):
+        if node.showkey:
+            yield node.name
+            yield 1
+        yield node.value
+    elif isinstance(node, Attribute):
+        yield len(node.pad_first)
+        yield node.name
+        yield len(node.pad_before_eq)
+        if node.value is not None:
+            quotes = len(node.quotes or "")
+            yield 1 + len(node.pad_after_eq) + quotes
+            yield node.value
+            yield quotes
+    elif isinstance(node, Wikilink):
+        yield 2
+        yield node.title
+        if node.text is not None:
+            yield 1
+            yield node.text
+        yield 2
+    elif isinstance(node, Argument):
+        yield 3
+        yield node.name
+        if node.default is not None:
+            yield 1
+            yield node.default
+        yield 3
+    elif isinstance(node, ExternalLink):
+        if node.brackets:
+            yield 1
+        yield node.url
+        if node.brackets:
+            if node.title is not None:
+                if node.suppress_space is not True:
+                    yield 1
+                yield node.title
+            yield 1
+    elif isinstance(node, Heading):
+        yield node.level
+        yield node.title
+        yield node.level
+    elif isinstance(node, Tag):
+        if node.wiki_markup:
+            yield len(node.wiki_markup)
+        else:
+            yield 2 if node.invalid else 1
+            yield node.tag
+        for attr in node.attributes:
+            if extras:
+                yield attr
+            else:
+                yield from iter_layout(attr)
+        if node.wiki_markup:
+            yield len(node.padding or "") + len(node.wiki_style_separator or "")
+            if not node.self_closing:
+                yield node.contents
+                yield len(node.closing_wiki_markup or "")
+        else:
+            yield len(node.padding)
+            if node.self_closing:
+                yield 1 if node.implicit else 2
+            else:
+                yield 1
+                yield node.contents
+                yield 2
+                yield node.closing_tag
+                yield 1
+    else:
+        yield len(str(node))
+
+
+def get_spans(code, start=0):
+    """Return the position of every node in a :class:`.Wikicode` object.
+
+    The result is a list of ``(node, start, end)`` tuples, one for each node
+    in the tree, in the same order as :meth:`.Wikicode.filter`, such that
+    ``str(code)[start:end] == str(node)``. *start* is added to each offset.
+    Text nodes are measured without being rendered. Nodes that aren't part of
+    the text, like the title of an external link without brackets, are left
+    out.
+    """
+    # pylint: disable=cyclic-import,import-outside-toplevel
+    from .nodes import Text
+
+    spans = []
+
+    def visit(code, pos):
+        for node in code.nodes:
+            if type(node) is Text:  # pylint: disable=unidiomatic-typecheck
+                end = pos + len(node.value)
+                spans.append((node, pos, end))
+                pos = end
+                continue
+            index = len(spans)
+            spans.append(None)
+            begin = pos
+            for part in iter_layout(node):
+                if isinstance(part, int):
+                    pos += part
+                else:
+                    pos = visit(part, pos)
+            spans[index] = (node, begin, pos)
+        return pos
+
+    visit(code, start)
+    return spans
@@ -18,6 +18,7 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+from bisect import bisect_right
 import re
 from itertools import chain
 
@@ -35,7 +36,13 @@ from .nodes import (
 )
 from .smart_list.list_proxy import ListProxy
 from .string_mixin import StringMixIn
-from .utils import parse_anything
+from .utils import (
+    get_changes,
+    is_tracked,
+    iter_layout,
+    mark_changed,
+    parse_anything,
+)
 
 __all__ = ["Wikicode"]
 
@@ -58,10 +65,111 @@ class Wikicode(StringMixIn):
     def __init__(self, nodes):
         super().__init__()
         self._nodes = nodes
+        self._index = None
 
     def __str__(self):
         return "".join([str(node) for node in self.nodes])
 
+    def __len__(self):
+        ends = self._get_index()
+        return ends[-1] if ends else 0
+
+    def __iter__(self):
+        for node in self.nodes:
+            yield from str(node)
+
+    def __getitem__(self, key):
+        if isinstance(key, slice):
+            start, stop, step = key.indices(len(self))
+            if step != 1:
+                return str(self)[key]
+            if start >= stop:
+                return ""
+            ends = self._get_index()
+            first = bisect_right(ends, start)
+            last = bisect_right(ends, stop - 1)
+            base = ends[first - 1] if first else 0
+            nodes = self.nodes
+            text = "".join([str(nodes[i]) for i in range(first, last + 1)])
+            return text[start - base : stop - base]
+
+        index = key.__index__()
+        if index < 0:
+            index += len(self)
+        node, offset = self._locate(index)
+        if isinstance(node, Text):
+            return node.value[offset]
+        child, child_offset = self._find_child(node, offset)
+        if child is None:
+            return str(node)[offset]
+        return child[child_offset]
+
+    def _get_index(self):
+        """Return the end offsets of our nodes, rebuilding them if needed.
+
+        The offsets are cached until any tree is changed, as counted by
+        :func:`.utils.mark_changed`. Node lengths are computed from the
+        indexes of their children, without rendering them. Offsets that
+        depend on a plain list, whose changes can't be seen, aren't cached.
+        """
+        index = self._index
+        changes = get_changes()
+        if index is not None and index[0] == changes:
+            return index[1]
+        nodes = self.nodes
+        tracked = is_tracked(nodes)
+        ends = []
+        total = 0
+        for node in nodes:
+            if type(node) is Text:  # pylint: disable=unidiomatic-typecheck
+                total += len(node.value)
+                ends.append(total)
+                continue
+            for part in iter_layout(node):
+                if isinstance(part, int):
+                    total += part
+                else:
+                    total += len(part)
+                    tracked = tracked and part._index is not None
+            if isinstance(node, Template):
+                tracked = tracked and is_tracked(node.params)
+            elif isinstance(node, Tag):
+                tracked = tracked and is_tracked(node.attributes)
+            ends.append(total)
+        self._index = (changes, ends) if tracked else None
+        return ends
+
+    def _locate(self, offset):
+        """Return the node containing a character and the offset within it.
+
+        Raises :exc:`IndexError` if *offset* is out of range.
+        """
+        ends = self._get_index()
+        if offset < 0 or not ends or offset >= ends[-1]:
+            raise IndexError("string index out of range")
+        i = bisect_right(ends, offset)
+        return self.nodes[i], offset - (ends[i - 1] if i else 0)
+
+    @staticmethod
+    def _find_child(node, offset):
+        """Return the child code of *node* containing a character, if any.
+
+        The result is a tuple of the :class:`.Wikicode` object and the offset
+        within it, or ``(None, None)`` if the character is part of the node's
+        own markup.
+        """
+        for part in iter_layout(node):
+            if isinstance(part, int):
+                if offset < part:
+                    return None, None
+                offset -= part
+            else:
+                length = len(part)
+                if offset < length:
+                    return part, offset
+                offset -= length
+        return None, None
+
     @staticmethod
     def _get_children(node, contexts=False, restrict=None, parent=None):
         """Iterate over all child :class:`.Node`\\ s of a given *node*."""
@@ -288,6 +396,7 @@ class Wikicode(StringMixIn):
         if not isinstance(value, list):
             value = parse_anything(value).nodes
         self._nodes = value
+        mark_changed()
 
     def get(self, index):
         """Return the *index*\\ th node within the list of nodes."""
@@ -393,6 +502,33 @@ class Wikicode(StringMixIn):
         ancestors = self.get_ancestors(obj)
         return ancestors[-1] if ancestors else None
 
+    def node_at(self, offset):
+        """Return the innermost node containing the character at *offset*.
+
+        *offset* is an index into ``str(self)``. For example, in
+        ``{{foo|[[bar]]}}``, offset 2 is in the template's name, so its text
+        node is returned, and offset 6 is in the ``[[`` of the wikilink, so the
+        wikilink is returned. Raises :exc:`IndexError` if *offset* is out of
+        range.
+
+        This uses a cached index of node lengths, so it takes logarithmic time
+        in the number of nodes at each level of the tree. The index is rebuilt
+        after any tree is changed, including through the lists of
+        :attr:`.Template.params` and :attr:`.Tag.attributes`. Trees that hold
+        plain lists instead, like a :attr:`nodes` set to a :class:`list`,
+        aren't cached, since changes to those lists can't be seen.
+        """
+        index = offset.__index__()
+        if index < 0:
+            index += len(self)
+        node, index = self._locate(index)
+        while not isinstance(node, Text):
+            child, index = self._find_child(node, index)
+            if child is None:
+                break
+            node, index = child._locate(index)
+        return node
+
     def insert(self, index, value):
         """Insert *value* at *index* in the list of nodes.
 
@@ -564,6 +700,29 @@ class Wikicode(StringMixIn):
         """
         return list(self.ifilter(*args, **kwargs))
 
+    def iselect(self, selector):
+        """Iterate over nodes in our tree matching a selector.
+
+        *selector* is a string like ``"template[name=foo] > param[name=bar]"``,
+        or a :class:`.Selector` returned by :func:`.compile_selector`; see
+        :mod:`.selectors` for the syntax. All of its conditions are checked in
+        a single walk of the tree, so one selector is faster than a chain of
+        :meth:`filter` calls. Matches are yielded in the order they appear,
+        and may include :class:`.Parameter` and :class:`.Attribute` objects.
+        """
+        from .selectors import Selector, compile_selector
+
+        if not isinstance(selector, Selector):
+            selector = compile_selector(selector)
+        return selector.iselect(self)
+
+    def select(self, selector):
+        """Return a list of nodes in our tree matching a selector.
+
+        This is equivalent to calling :func:`list` on :meth:`iselect`.
+        """
+        return list(self.iselect(selector))
+
     def get_sections(
         self,
         levels=None,
@@ -674,6 +833,35 @@ class Wikicode(StringMixIn):
             return stripped
         return "".join(nodes)
 
+    def to_jsonable(self, spans=False):
+        """Return a JSON-compatible object representing this tree.
+
+        See :mod:`.jsonify` for the schema. If *spans* is ``True``, every node
+        gets the ``[start, end]`` offsets of its text in ``str(self)``.
+        """
+        from .jsonify import to_jsonable
+
+        return to_jsonable(self, spans)
+
+    def to_json(self, fp=None, spans=False):
+        """Export this tree as JSON text, following :meth:`to_jsonable`.
+
+        If *fp* is given, the JSON is streamed to it, a file-like object opened
+        in text mode, instead of being returned as a string.
+        """
+        from .jsonify import to_json
+
+        return to_json(self, fp, spans)
+
+    def memory_report(self):
+        """Return how much memory this tree uses, by type of object.
+
+        See :func:`.memory.memory_report` for the format of the result.
+        """
+        from .memory import memory_report
+
+        return memory_report(self)
+
     def get_tree(self):
         """Return a hierarchical tree representation of the object.
 
@@ -0,0 +1,112 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Tests for the batches module, which collects extraction results in columns.
+"""
+
+from array import array
+
+import pytest
+
+import mwparserfromhell
+from mwparserfromhell.batches import (
+    SCAN_SCHEMA,
+    TEMPLATE_SCHEMA,
+    RecordBatch,
+    StringColumn,
+    extract_templates,
+    scan_pages,
+)
+from mwparserfromhell.prefilters import Prefilter
+
+
+def test_string_column():
+    """test the layout and accessors of StringColumn"""
+    column = StringColumn(["ab", "", "ü€"])
+    assert 3 == len(column)
+    assert array("q", [0, 2, 2, 7]) == column.offsets
+    assert bytearray("abü€".encode()) == column.data
+    assert ["ab", "", "ü€"] == column.to_list()
+    assert "ü€" == column[2] == column[-1]
+    assert 4 * 8 + 7 == column.nbytes
+    assert StringColumn(["ab", "", "ü€"]) == column
+    assert bytes(memoryview(column.offsets))[:8] == (0).to_bytes(8, "little")
+    with pytest.raises(IndexError):
+        column[3]
+
+
+def test_record_batch():
+    """test building a RecordBatch by rows and reading it back"""
+    batch = RecordBatch([("id", "int64"), ("name", "string")])
+    batch.append(1, "a")
+    batch.append(2, "bc")
+    assert 2 == len(batch)
+    assert "RecordBatch(2 rows: id, name)" == repr(batch)
+    assert array("q", [1, 2]) == batch["id"]
+    assert ["a", "bc"] == batch["name"].to_list()
+    assert [{"id": 1, "name": "a"}, {"id": 2, "name": "bc"}] == batch.to_pylist()
+    assert 16 + 24 + 3 == batch.nbytes
+    with pytest.raises(ValueError):
+        batch.append(3)
+    with pytest.raises(ValueError):
+        RecordBatch([("x", "float")])
+
+
+def test_extract_templates():
+    """test extracting template parameters into batches"""
+    text = "a {{ cite_web |url=x| title = ü }} {{foo|{{bar}}}}"
+    pages = [(7, mwparserfromhell.parse(text)), (8, "{{baz}}")]
+    (batch,) = extract_templates(pages)
+    assert TEMPLATE_SCHEMA == batch.schema
+    assert [
+        {"template": "Cite web", "param": "url", "value": "x", "start": 2},
+        {"template": "Cite web", "param": "title", "value": "ü", "start": 2},
+        {"template": "Foo", "param": "1", "value": "{{bar}}", "start": 35},
+        {"template": "Bar", "param": "", "value": "", "start": 41},
+        {"template": "Baz", "param": "", "value": "", "start": 0},
+    ] == [
+        {key: row[key] for key in ("template", "param", "value", "start")}
+        for row in batch.to_pylist()
+    ]
+    assert array("q", [7, 7, 7, 7, 8]) == batch["page_id"]
+    for start, end in zip(batch["start"][:4], batch["end"]):
+        assert text[start:end].startswith("{{") and text[start:end].endswith("}}")
+    assert "{{bar}}" == text[batch["start"][3] : batch["end"][3]]
+
+
+def test_batch_size():
+    """test that batches are split between pages"""
+    pages = [(i, "{{a|1|2}}") for i in range(5)]
+    batches = list(extract_templates(pages, batch_size=3))
+    assert [4, 4, 2] == [len(batch) for batch in batches]
+    assert [] == list(extract_templates([]))
+
+
+def test_scan_pages():
+    """test collecting prefilter hits into batches"""
+    prefilter = Prefilter(["Foo", "[[Bar"])
+    pages = [(1, "{{foo}} [[bar]]"), (2, "nothing"), (3, "ü{{Foo}}".encode())]
+    (batch,) = scan_pages(prefilter, pages)
+    assert SCAN_SCHEMA == batch.schema
+    assert array("q", [1, 1, 3]) == batch["page_id"]
+    assert array("q", [0, 8, 2]) == batch["offset"]
+    assert ["Foo", "[[Bar", "Foo"] == batch["pattern"].to_list()
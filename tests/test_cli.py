@@ -0,0 +1,186 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Tests for the cli module, which runs batches of pages from the command line.
+"""
+
+import bz2
+import io
+import json
+
+import pytest
+
+from mwparserfromhell import cli, utils
+from mwparserfromhell.cli import main
+
+PAGES = {
+    "a.wiki": "{{foo|a=1|b}} [[Bar|baz]] '''x'''",
+    "b.wiki": "== H ==\n[[Q]] {{Cite web|url=x}}",
+    "sub/c.wiki": "plain text ä",
+    "sub/d.txt": "{{ignored}}",
+}
+
+
+@pytest.fixture(name="corpus")
+def fixture_corpus(tmp_path):
+    """Write a directory of pages."""
+    for name, text in PAGES.items():
+        path = tmp_path / name
+        path.parent.mkdir(exist_ok=True)
+        path.write_text(text, encoding="utf8")
+    return tmp_path
+
+
+def run(argv, stdin=""):
+    """Run the command line and return its exit status, stdout, and stderr."""
+    stdout = io.StringIO()
+    stderr = io.StringIO()
+    status = main(argv, io.StringIO(stdin), stdout, stderr)
+    return status, stdout.getvalue(), stderr.getvalue()
+
+
+def lines(output):
+    return [json.loads(line) for line in output.splitlines()]
+
+
+def test_extract(corpus):
+    """test extracting templates and links from a directory"""
+    status, out, err = run(["extract", "-j1", str(corpus)])
+    assert 0 == status
+    records = lines(out)
+    assert [str(corpus / name) for name in ("a.wiki", "b.wiki", "sub/c.wiki")] == [
+        record["title"] for record in records
+    ]
+    assert {
+        "id": None,
+        "title": str(corpus / "a.wiki"),
+        "templates": [{"name": "foo", "params": {"a": "1", "1": "b"}}],
+        "links": [{"title": "Bar", "text": "baz"}],
+    } == records[0]
+    assert [{"title": "Q", "text": None}] == records[1]["links"]
+    assert "3 pages (0 skipped, 0 failed)" in err
+    assert str(corpus / "a.wiki") in err
+
+
+def test_strip_and_stats():
+    """test the strip and stats commands on stdin"""
+    text = "{{foo|bar}} ''baz'' [[a|b]]"
+    _, out, _ = run(["strip", "-j1", "-q"], text)
+    assert [{"id": None, "title": "-", "text": " baz b"}] == lines(out)
+    _, out, _ = run(["strip", "-j1", "-q", "--keep-template-params", "-"], text)
+    assert "bar baz b" == lines(out)[0]["text"]
+    status, out, err = run(["stats", "-j1", "-q", "--skip-style-tags"], text)
+    assert 0 == status and "" == err
+    record = lines(out)[0]
+    assert len(text) == record["bytes"]
+    assert {"template": 1, "text": 5, "wikilink": 1} == record["nodes"]
+
+
+def test_pool(corpus):
+    """test that a pool of workers gives the same output, in either order"""
+    _, expected, _ = run(["stats", "-j1", "-q", str(corpus)])
+    expected = [(rec["title"], rec["nodes"]) for rec in lines(expected)]
+    output = corpus / "out.jsonl"
+    for flags in ([], ["-u"]):
+        args = ["stats", "-j2", "--chunksize", "1", "-q", "-o", str(output)]
+        assert 0 == run(args + flags + [str(corpus)])[0]
+        with open(output, encoding="utf8") as fp:
+            records = lines(fp.read())
+        found = [(rec["title"], rec["nodes"]) for rec in records]
+        if flags:
+            found.sort()
+        assert expected == found
+
+
+def test_bench_and_match(corpus):
+    """test the bench summary, and skipping pages with --match"""
+    args = ["bench", "-j1", "--json", "--glob", "*", "--match", "{{cite web"]
+    status, out, err = run(args + ["--outliers", "1", str(corpus)])
+    assert 0 == status and "" == err
+    summary = json.loads(out)
+    assert 1 == summary["pages"]
+    assert 3 == summary["skipped"]
+    assert sum(len(text.encode("utf8")) for text in PAGES.values()) == summary["bytes"]
+    assert [str(corpus / "b.wiki")] == [page["title"] for page in summary["slowest"]]
+    _, out, _ = run(["bench", "-j1", str(corpus)])
+    assert out.startswith("3 pages (0 skipped, 0 failed)")
+
+
+def test_dump(tmp_path):
+    """test reading pages from a multistream dump"""
+    page = (
+        "<page><title>Page {0}</title><ns>0</ns><id>{0}</id><revision><id>1</id>"
+        "<text>{{{{t|{0}}}}}</text></revision></page>"
+    )
+    path = tmp_path / "dump.xml.bz2"
+    index = []
+    with open(path, "wb") as fp:
+        fp.write(bz2.compress(b"<mediawiki><siteinfo></siteinfo>"))
+        for pid in (1, 2):
+            index.append("{}:{}:Page {}".format(fp.tell(), pid, pid))
+            fp.write(bz2.compress(page.format(pid).encode("utf8")))
+        fp.write(bz2.compress(b"</mediawiki>"))
+    (tmp_path / "index.txt").write_text("\n".join(index) + "\n")
+    args = ["extract", "-j1", "-q", "--dump", str(path)]
+    _, out, _ = run(args + ["--index", str(tmp_path / "index.txt")])
+    assert [(1, "Page 1", {"1": "1"}), (2, "Page 2", {"1": "2"})] == [
+        (rec["id"], rec["title"], rec["templates"][0]["params"]) for rec in lines(out)
+    ]
+
+
+def test_errors(tmp_path, capsys):
+    """test bad arguments and missing files"""
+    with pytest.raises(SystemExit):
+        main(["extract", "--dump", "x"])
+    assert "--dump and --index" in capsys.readouterr().err
+    with pytest.raises(SystemExit):
+        main(["bench", "--match", "{{a|b"])
+    assert "Invalid template name" in capsys.readouterr().err
+    status, _, err = run(["extract", "-j1", str(tmp_path / "missing.wiki")])
+    assert 1 == status
+    assert "missing.wiki" in err
+
+
+def test_failed_pages(corpus, monkeypatch):
+    """test that unreadable files and parser errors don't stop the run"""
+    missing = str(corpus / "missing")
+    for jobs in ("-j1", "-j2"):
+        args = ["stats", jobs, "--chunksize", "1", missing, str(corpus), missing]
+        status, out, err = run(args)
+        assert 1 == status
+        assert 3 == len(lines(out))
+        assert "3 pages (0 skipped, 2 failed)" in err
+        assert "error: {}: No such file or directory".format(missing) in err
+
+    def parse_anything(text, **kwargs):
+        if "Cite web" in text:
+            raise RuntimeError("broken")
+        return utils.parse_anything(text, **kwargs)
+
+    monkeypatch.setattr(cli, "parse_anything", parse_anything)
+    status, out, _ = run(["bench", "-j1", "--json", str(corpus)])
+    assert 1 == status
+    summary = json.loads(out)
+    assert (2, 1) == (summary["pages"], summary["failed"])
+    assert [
+        {"id": None, "title": str(corpus / "b.wiki"), "error": "RuntimeError: broken"}
+    ] == summary["errors"]
@@ -0,0 +1,108 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Tests for the costs module, which estimates how long wikicode takes to parse.
+"""
+
+import random
+
+import pytest
+
+import mwparserfromhell
+from mwparserfromhell import costs, parser
+from mwparserfromhell.costs import CostFeatures, cost_features, estimate_cost
+
+
+@pytest.fixture(params=[False, True], ids=["python", "c"])
+def anyscanner(request, monkeypatch):
+    """run the test with both scanners"""
+    if request.param and not costs._cost_scan:
+        pytest.skip("C tokenizer not available")
+    monkeypatch.setattr(parser, "use_c", request.param)
+
+
+def test_features(anyscanner):
+    """test counting the features of some text"""
+    text = "{{a|[[b|<ref>x</ref> '''y'''\n{|\n| a || b\n|}\n<br/>"
+    expected = CostFeatures(
+        length=49,
+        markers=31,
+        templates=1,
+        links=1,
+        tags=2,
+        apostrophes=2,
+        table_markers=4,
+        unclosed=2,
+        unclosed_span=94,
+        unclosed_tag_span=0,
+        unclosed_markers=55,
+    )
+    assert expected == cost_features(text)
+    assert expected == cost_features(text.encode())
+    assert CostFeatures(*[0] * 11) == cost_features("")
+
+
+def test_unclosed(anyscanner):
+    """test that unclosed constructs are counted until the end of the text"""
+    tail = "x" * 100
+    assert (1, 103, 0) == cost_features("{{a" + tail)[7:10]
+    assert (1, 104, 0) == cost_features("[[a|" + tail)[7:10]
+    assert (1, 0, 105) == cost_features("<ref>" + tail)[7:10]
+    assert (1, 0, 103) == cost_features("\n{|\n" + tail)[7:10]
+    assert (0, 0, 0) == cost_features("{{a}}<br><ref>a</ref><ref />" + tail)[7:10]
+    assert (0, 0, 0) == cost_features("{{a|{{b}}}}[[c|[[d]]]]" + tail)[7:10]
+    assert (1, 109, 0) == cost_features("{{a|{{b}}" + tail)[7:10]
+    assert 9 == cost_features("{{a|{{b}}{{c}}").unclosed_markers
+    assert 12 == cost_features("é" * 10 + "{{").length
+    assert 22 == cost_features(("é" * 10 + "{{").encode()).length
+
+
+def test_parity():
+    """test that the C and Python scanners agree on random text"""
+    if not costs._cost_scan:
+        pytest.skip("C tokenizer not available")
+    rng = random.Random(0)
+    chars = "{}[]<>|!'=\n a/é" + "bhrtd"
+    for _ in range(2000):
+        text = "".join(rng.choice(chars) for _ in range(rng.randrange(40)))
+        for data in (text, text.encode()):
+            assert tuple(costs._scan(data)) == costs._cost_scan(data), repr(data)
+
+
+def test_estimate(anyscanner):
+    """test that broken pages are estimated to be slower than clean ones"""
+    clean = "The [[quick]] {{brown|fox}} jumps <ref>over</ref> the dog. " * 50
+    broken = "<ref>" + clean
+    assert 0 < estimate_cost(clean) < estimate_cost(broken)
+    assert estimate_cost(clean) < estimate_cost(clean * 2)
+    assert estimate_cost(clean) == mwparserfromhell.estimate_cost(clean)
+    assert 0 == estimate_cost("")
+
+
+def test_estimate_ranking(anyscanner):
+    """test that markup-dense pages outrank prose of the same length"""
+    fill = lambda unit: (unit * (10000 // len(unit) + 1))[:10000]
+    prose = estimate_cost(fill("The quick brown fox jumps over the lazy dog. "))
+    assert prose * 5 < estimate_cost(fill("{{cite|a=b|{{c|d}}}} "))
+    assert prose * 5 < estimate_cost(fill("[[a|b]] [[c]] "))
+    assert prose * 5 < estimate_cost(fill("<b>x</b> "))
+    assert prose < estimate_cost("<span>" + fill("The quick brown fox. "))
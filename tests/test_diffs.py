@@ -0,0 +1,125 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Tests for the diffs module, which compares the structure of two trees.
+"""
+
+import mwparserfromhell
+from mwparserfromhell.diffs import diff
+
+
+def resolve(code, path):
+    """Return the item at a path in a tree."""
+    item = code
+    for key in path:
+        if isinstance(key, int):
+            item = (item.nodes if hasattr(item, "nodes") else item)[key]
+        else:
+            item = getattr(item, key)
+    return item
+
+
+def summarize(old, new):
+    """Diff two texts, checking the paths, and return the changes as strings."""
+    old, new = mwparserfromhell.parse(old), mwparserfromhell.parse(new)
+    changes = diff(old, new)
+    for change in changes:
+        if change.old_path is not None:
+            assert resolve(old, change.old_path) is change.old
+        if change.new_path is not None:
+            assert resolve(new, change.new_path) is change.new
+    return [
+        (
+            change.op,
+            change.new_path if change.op != "remove" else change.old_path,
+            str(change.old if change.op == "remove" else change.new),
+        )
+        for change in changes
+    ]
+
+
+def test_identical():
+    """test that identical trees and strings have no changes"""
+    text = "{{a|b=[[c]]}} <ref name=x>d</ref>\n== e =="
+    assert [] == diff(mwparserfromhell.parse(text), mwparserfromhell.parse(text))
+    assert [] == diff(text, text)
+    assert [] == mwparserfromhell.diff("", "")
+    assert 1 == len(mwparserfromhell.diff("a", "b"))
+
+
+def test_templates():
+    """test changes to templates and their parameters"""
+    old = "x {{Infobox|name=A|born=1900|died=2000}} y"
+    new = "x {{infobox|name=B|born=1900|spouse=C}} y"
+    assert [
+        ("modify", (1,), "{{infobox|name=B|born=1900|spouse=C}}"),
+        ("modify", (1, "name", 0), "infobox"),
+        ("modify", (1, "params", 0), "name=B"),
+        ("modify", (1, "params", 0, "value", 0), "B"),
+        ("remove", (1, "params", 2), "died=2000"),
+        ("insert", (1, "params", 2), "spouse=C"),
+    ] == summarize(old, new)
+    assert [
+        ("modify", (0,), "{{b|x=1}}"),
+        ("modify", (0, "name", 0), "b"),
+    ] == summarize("{{a|x=1}}", "{{b|x=1}}")
+
+
+def test_nodes():
+    """test inserted and removed nodes, with paths in each tree"""
+    changes = diff("a [[b]] {{c}} d", "{{z}}a [[b]] d [[e]]")
+    assert [
+        ("insert", None, (0,), "{{z}}"),
+        ("remove", (3,), None, "{{c}}"),
+        ("remove", (4,), None, " d"),
+        ("modify", (2,), (3,), " d "),
+        ("insert", None, (4,), "[[e]]"),
+    ] == [
+        (change.op, change.old_path, change.new_path, str(change.new or change.old))
+        for change in changes
+    ]
+
+
+def test_fields():
+    """test changes to scalar fields and optional children"""
+    assert [("modify", (0,), "=== A ===")] == summarize("== A ==", "=== A ===")
+    assert [
+        ("modify", (0,), "[[A|b]]"),
+        ("insert", (0, "text", 0), "b"),
+    ] == summarize("[[A]]", "[[A|b]]")
+    assert [
+        ("modify", (1,), "<ref name=b>x</ref>"),
+        ("modify", (1, "attributes", 0), " name=b"),
+        ("modify", (1, "attributes", 0, "value", 0), "b"),
+    ] == summarize("a<ref name=a>x</ref>", "a<ref name=b>x</ref>")
+    assert [("modify", (0,), "&#x41;")] == summarize("&#65;", "&#x41;")
+
+
+def test_large():
+    """test a small edit in a large tree"""
+    text = "".join("{{cite|n=%d}} [[L%d]]\n" % (i, i) for i in range(500))
+    new = text.replace("[[L250]]", "[[L250|x]]")
+    changes = summarize(text, new)
+    assert [
+        ("modify", (1002,), "[[L250|x]]"),
+        ("insert", (1002, "text", 0), "x"),
+    ] == changes
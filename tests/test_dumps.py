@@ -0,0 +1,182 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Tests for the dumps module, which reads and parses multistream XML dumps.
+"""
+
+import bz2
+from xml.sax.saxutils import escape
+
+import pytest
+
+from mwparserfromhell.dumps import MultistreamDump, read_index
+from mwparserfromhell.nodes import Template
+from mwparserfromhell.wikicode import Wikicode
+
+HEADER = """<mediawiki xmlns="http://www.mediawiki.org/xml/export-0.10/">
+  <siteinfo>
+    <sitename>Wikipedia</sitename>
+  </siteinfo>
+"""
+
+PAGE = """  <page>
+    <title>{title}</title>
+    <ns>0</ns>
+    <id>{id}</id>
+    <revision>
+      <id>{rev}</id>
+      <text bytes="{size}" xml:space="preserve">{text}</text>
+    </revision>
+  </page>
+"""
+
+
+def _page_text(pid):
+    return "{{{{foo|{0}}}}} [[Page {0}]] <b>&amp;</b>".format(pid)
+
+
+@pytest.fixture(name="dump")
+def fixture_dump(tmp_path):
+    """Write a small multistream dump with 7 streams of 3 pages each."""
+    path = tmp_path / "dump.xml.bz2"
+    index_path = tmp_path / "index.txt.bz2"
+    index = []
+    with open(path, "wb") as fp:
+        fp.write(bz2.compress(HEADER.encode("utf8")))
+        pid = 1
+        for _ in range(7):
+            offset = fp.tell()
+            chunk = ""
+            for _ in range(3):
+                text = _page_text(pid)
+                title = "Page {0}: ä".format(pid)
+                chunk += PAGE.format(
+                    title=escape(title),
+                    id=pid,
+                    rev=pid * 10,
+                    size=len(text),
+                    text=escape(text),
+                )
+                index.append("{0}:{1}:{2}".format(offset, pid, title))
+                pid += 1
+            fp.write(bz2.compress(chunk.encode("utf8")))
+        fp.write(bz2.compress(b"</mediawiki>\n"))
+    with bz2.open(index_path, "wt", encoding="utf8") as fp:
+        fp.write("\n".join(index) + "\n")
+    return MultistreamDump(str(path), str(index_path))
+
+
+def test_read_index(dump, tmp_path):
+    """test read_index() on compressed and uncompressed files"""
+    entries = list(read_index(dump.index_path))
+    assert len(entries) == 21
+    assert entries[0].id == 1
+    assert entries[4].title == "Page 5: ä"
+    assert entries[0].offset == entries[2].offset < entries[3].offset
+
+    plain = tmp_path / "index.txt"
+    plain.write_text("597:12:Foo:Bar\n", encoding="utf8")
+    assert list(read_index(str(plain))) == [(597, 12, "Foo:Bar")]
+
+
+def test_streams(dump):
+    """test that the stream ranges are read from the index"""
+    streams = dump.streams
+    assert len(streams) == 7
+    for (_, end), (start, _) in zip(streams, streams[1:]):
+        assert end == start
+    pages = dump.read_stream(*streams[1])
+    assert [page[0] for page in pages] == [4, 5, 6]
+    assert pages[0][2] == "Page 4: ä"
+    assert pages[0][3] == _page_text(4)
+
+
+@pytest.mark.parametrize("threads", [1, 3])
+@pytest.mark.parametrize("parse_threads", [1, 2])
+def test_pipeline_ordered(dump, threads, parse_threads):
+    """test that an ordered pipeline yields every page in dump order"""
+    pipeline = dump.pages(threads=threads, parse_threads=parse_threads, queue_size=2)
+    pages = list(pipeline)
+    assert [page.id for page in pages] == list(range(1, 22))
+    for page in pages:
+        assert page.text == _page_text(page.id)
+        assert isinstance(page.code, Wikicode)
+        assert str(page.code) == page.text
+        assert page.code.filter_templates()[0].name == "foo"
+
+    stats = pipeline.stats
+    assert stats.streams == 7
+    assert stats.pages == 21
+    assert stats.uncompressed_bytes > 0
+    assert stats.compressed_bytes > 0
+    assert stats.elapsed > 0
+    assert 0 < stats.queue_depth("streams")[1] <= 2
+    assert 0 < stats.queue_depth("results")[1] <= 2
+    data = stats.as_dict()
+    assert data["pages"] == 21
+    assert set(data["queues"]) == {"streams", "results"}
+
+
+def test_pipeline_unordered(dump):
+    """test an unordered pipeline, and one that doesn't parse"""
+    pages = list(dump.pages(threads=4, ordered=False))
+    assert sorted(page.id for page in pages) == list(range(1, 22))
+
+    pipeline = dump.pages(parse=False, ordered=False)
+    pages = list(pipeline)
+    assert sorted(page.id for page in pages) == list(range(1, 22))
+    assert all(page.code is None for page in pages)
+    assert "results" not in pipeline.stats.as_dict()["queues"]
+
+
+def test_pipeline_prefilter(dump):
+    """test that pages a prefilter doesn't match are skipped"""
+    pipeline = dump.pages(threads=2, prefilter=["[[page_5", "[[Page 12"])
+    pages = list(pipeline)
+    assert [page.id for page in pages] == [5, 12]
+    assert str(pages[1].code) == _page_text(12)
+    assert pipeline.stats.pages == 21
+    assert pipeline.stats.skipped_pages == 19
+    assert pipeline.stats.as_dict()["skipped_pages"] == 19
+
+
+def test_pipeline_close(dump):
+    """test that a pipeline can be stopped early"""
+    pipeline = dump.pages(threads=2, queue_size=1)
+    first = next(iter(pipeline))
+    assert first.id == 1
+    assert isinstance(first.code.get(0), Template)
+    pipeline.close()
+    with pytest.raises(StopIteration):
+        next(pipeline)
+    assert pipeline.stats.elapsed > 0
+
+
+def test_pipeline_errors(dump, tmp_path):
+    """test that errors in worker threads are raised to the consumer"""
+    broken = tmp_path / "broken.xml.bz2"
+    with open(dump.path, "rb") as src, open(broken, "wb") as dst:
+        data = src.read()
+        start = dump.streams[2][0]
+        dst.write(data[:start] + b"garbage" + data[start + 7 :])
+    pipeline = MultistreamDump(str(broken), dump.index_path).pages(threads=2)
+    with pytest.raises(OSError):
+        list(pipeline)
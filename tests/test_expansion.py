@@ -0,0 +1,107 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Tests for the expansion module, which expands templates against local sources.
+"""
+
+import pytest
+
+import mwparserfromhell
+from mwparserfromhell.expansion import Expander, ExpansionError
+from mwparserfromhell.nodes import Template, Wikilink
+from mwparserfromhell.wikicode import Wikicode
+
+TEMPLATES = {
+    "Template:Greet": "Hello, {{{1|world}}}!<noinclude>\n[[Category:T]]</noinclude>",
+    "Template:Link": "[[{{{page}}}|{{{text|{{{page}}}}}}]]",
+    "Outer": "<{{Greet|{{{who}}}}}> {{link|page=Foo bar}}",
+    "Template:Loop": "a{{loop}}b",
+    "Template:Wrap": "{{outer|who=x}}",
+    "Template:Big": "{{{1}}}{{{1}}}{{{1}}}{{{1}}}",
+    "User:Example/box": "<onlyinclude>box</onlyinclude> not included",
+}
+
+
+def test_expand():
+    """test expanding templates, arguments, and defaults"""
+    code = mwparserfromhell.parse("{{greet}} {{Template:greet| you }} {{{x|y}}}")
+    expanded = mwparserfromhell.expand(code, TEMPLATES)
+    assert isinstance(expanded, Wikicode)
+    assert expanded == "Hello, world! Hello,  you ! y"
+    assert code == "{{greet}} {{Template:greet| you }} {{{x|y}}}"
+
+    expanded = mwparserfromhell.expand("{{Outer| who = me }}", TEMPLATES)
+    assert expanded == "<Hello, me!> [[Foo bar|Foo bar]]"
+    assert isinstance(expanded.get(-1), Wikilink)
+    assert mwparserfromhell.expand("{{User:example/box}}", TEMPLATES) == "box"
+
+
+def test_unexpanded():
+    """test that unknown templates and parser functions are left alone"""
+    text = "{{missing|{{greet}}}} {{#if:{{{1|}}}|a|b}} {{PAGENAME}} {{{arg}}}"
+    expanded = mwparserfromhell.expand(text, TEMPLATES)
+    assert expanded == "{{missing|Hello, world!}} {{#if:|a|b}} {{PAGENAME}} {{{arg}}}"
+    assert isinstance(expanded.get(0), Template)
+
+
+def test_limits():
+    """test the depth and size limits"""
+    assert mwparserfromhell.expand("{{loop}}", TEMPLATES) == "a{{loop}}b"
+    assert mwparserfromhell.expand("{{outer}}", TEMPLATES, max_depth=1) == (
+        "<{{Greet|{{{who}}}}}> {{link|page=Foo bar}}"
+    )
+    assert mwparserfromhell.expand("{{big|abc}}", TEMPLATES, max_size=12) == (
+        "abcabcabcabc"
+    )
+    with pytest.raises(ExpansionError):
+        mwparserfromhell.expand("{{big|abc}}{{greet}}", TEMPLATES, max_size=12)
+
+
+def test_memoization():
+    """test that template bodies are loaded once and results are memoized"""
+    calls = []
+
+    def provider(title):
+        calls.append(title)
+        return TEMPLATES.get(title, TEMPLATES.get(title.split(":", 1)[1]))
+
+    expander = Expander(provider, max_depth=2)
+    assert expander.expand("{{greet|a}}{{greet|a}}{{greet|b}}") == (
+        "Hello, a!Hello, a!Hello, b!"
+    )
+    assert expander.expand("{{greet|1=a}}{{nope}}{{nope}}") == (
+        "Hello, a!{{nope}}{{nope}}"
+    )
+    assert calls == ["Template:Greet", "Template:Nope"]
+
+    # A result memoized near the top can't be reused past the depth limit:
+    assert expander.expand("{{outer|who=x}}") == "<Hello, x!> [[Foo bar|Foo bar]]"
+    assert expander.expand("{{wrap}}") == "<{{Greet|x}}> {{link|page=Foo bar}}"
+
+
+def test_directory(tmp_path):
+    """test loading templates from a directory"""
+    (tmp_path / "Template:Greet.wiki").write_text("Hi {{{1}}}", encoding="utf8")
+    (tmp_path / "User:Example%2Fbox").write_text("box", encoding="utf8")
+    expanded = mwparserfromhell.expand(
+        "{{greet|there}} {{user:Example/box}}", str(tmp_path)
+    )
+    assert expanded == "Hi there box"
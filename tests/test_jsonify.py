@@ -0,0 +1,194 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Tests for the jsonify module, which exports wikicode trees as JSON.
+"""
+
+import io
+import json
+
+import pytest
+
+import mwparserfromhell
+from mwparserfromhell.jsonify import SCHEMA_VERSION
+from mwparserfromhell.nodes import Tag
+
+TEXT = """{{a|b| c = d |{{{e|f}}}}} [[g|h]] [[i]] [http://j k] [http://l]http://m
+== n ==
+<!-- o --> &amp;&#x41;&#65; <ref name="p" q='r' s>t</ref><br/><br> ''u'' '''v'''
+* w
+; x : y
+{| class=z
+|-
+| aa || bb
+|} </b> <p/ > {{cc|1=dd|ee}} ∑ <nowiki>ff</nowiki>"""
+
+CHILDREN = {
+    "argument": ("name", "default"),
+    "wikilink": ("title", "text"),
+    "extlink": ("url", "title"),
+    "heading": ("title",),
+}
+
+TYPES = {
+    "Argument": "argument",
+    "Comment": "comment",
+    "ExternalLink": "extlink",
+    "Heading": "heading",
+    "HTMLEntity": "entity",
+    "Tag": "tag",
+    "Template": "template",
+    "Text": "text",
+    "Wikilink": "wikilink",
+}
+
+
+def walk(nodes):
+    """Yield exported nodes in the same order as Wikicode.filter()."""
+    for node in nodes or []:
+        yield node
+        if node["type"] == "template":
+            yield from walk(node["name"])
+            for param in node["params"]:
+                if param["showkey"]:
+                    yield from walk(param["name"])
+                yield from walk(param["value"])
+        elif node["type"] == "tag":
+            if not node["wiki_markup"]:
+                yield from walk(node["tag"])
+            for attr in node["attributes"]:
+                yield from walk(attr["name"])
+                yield from walk(attr["value"])
+            yield from walk(node["contents"])
+            yield from walk(node["closing_tag"])
+        else:
+            for key in CHILDREN.get(node["type"], ()):
+                yield from walk(node[key])
+
+
+def test_schema():
+    """test the fields of exported nodes"""
+    code = mwparserfromhell.parse("{{a|b=c}}[[d]]<br/>")
+    assert {
+        "version": SCHEMA_VERSION,
+        "nodes": [
+            {
+                "type": "template",
+                "name": [{"type": "text", "value": "a"}],
+                "params": [
+                    {
+                        "name": [{"type": "text", "value": "b"}],
+                        "value": [{"type": "text", "value": "c"}],
+                        "showkey": True,
+                    }
+                ],
+            },
+            {
+                "type": "wikilink",
+                "title": [{"type": "text", "value": "d"}],
+                "text": None,
+            },
+            {
+                "type": "tag",
+                "tag": [{"type": "text", "value": "br"}],
+                "wiki_markup": None,
+                "attributes": [],
+                "contents": None,
+                "self_closing": True,
+                "invalid": False,
+                "implicit": False,
+                "padding": "",
+                "closing_tag": None,
+                "wiki_style_separator": None,
+                "closing_wiki_markup": None,
+            },
+        ],
+    } == code.to_jsonable()
+
+
+def test_all_types():
+    """test that every node is exported, in order"""
+    code = mwparserfromhell.parse(TEXT)
+    nodes = list(walk(code.to_jsonable()["nodes"]))
+    assert len(code.filter()) == len(nodes)
+    for node, data in zip(code.filter(), nodes):
+        assert TYPES[type(node).__name__] == data["type"]
+
+
+@pytest.mark.parametrize("text", [TEXT, "", "plain", "{{a|{{b|[[c|{{d}}]]}}}}"])
+def test_spans(text):
+    """test that spans give the text of each node"""
+    code = mwparserfromhell.parse(text)
+    nodes = list(walk(code.to_jsonable(spans=True)["nodes"]))
+    for node, data in zip(code.filter(), nodes):
+        start, end = data["span"]
+        assert str(node) == text[start:end]
+    templates = code.filter_templates()
+    params = [param for template in templates for param in template.params]
+    spans = [param["span"] for data in nodes for param in data.get("params", [])]
+    assert len(params) == len(spans)
+    for param, (start, end) in zip(params, spans):
+        assert str(param) == text[start:end]
+
+
+def test_hidden_names():
+    """test that hidden parameter names and wiki tag names have no spans"""
+    code = mwparserfromhell.parse("{{a|b}}''c''")
+    template, tag = code.to_jsonable(spans=True)["nodes"]
+    assert [{"type": "text", "value": "1"}] == template["params"][0]["name"]
+    assert [4, 5] == template["params"][0]["span"]
+    assert [{"type": "text", "value": "i"}] == tag["tag"]
+    assert [7, 12] == tag["span"]
+    assert [9, 10] == tag["contents"][0]["span"]
+
+
+def test_hidden_spans():
+    """test that spans skip children that aren't part of the text"""
+    code = mwparserfromhell.parse("x http://a.com y")
+    link = code.get(1)
+    link.title = "z"
+    _, data, _ = code.to_jsonable(spans=True)["nodes"]
+    assert [2, 14] == data["span"]
+    assert str(link) == str(code)[2:14]
+    assert [{"type": "text", "value": "z"}] == data["title"]
+    tag = Tag("b", "c")
+    code = mwparserfromhell.parse("x ")
+    code.append(tag)
+    data = code.to_jsonable(spans=True)["nodes"][1]
+    assert tag.tag is tag.closing_tag
+    assert [3, 4] == data["tag"][0]["span"]
+    assert [8, 9] == data["closing_tag"][0]["span"]
+
+
+@pytest.mark.parametrize("spans", [False, True])
+def test_to_json(spans):
+    """test that the JSON text matches to_jsonable(), streamed or not"""
+    code = mwparserfromhell.parse(TEXT * 50)
+    text = code.to_json(spans=spans)
+    assert json.loads(text) == code.to_jsonable(spans=spans)
+    assert "∑" in text
+    stream = io.StringIO()
+    assert code.to_json(stream, spans=spans) is None
+    assert text == stream.getvalue()
+    stream = io.StringIO()
+    mwparserfromhell.parse("").to_json(stream)
+    assert '{"version":1,"nodes":[]}' == stream.getvalue()
@@ -0,0 +1,82 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Tests for the memory module, which measures the memory used by parsed trees.
+"""
+
+import sys
+
+import mwparserfromhell
+from mwparserfromhell.memory import memory_report
+
+
+def test_types():
+    """test that objects are counted once per type"""
+    code = mwparserfromhell.parse("{{a|b=[[c]]}} d")
+    report = code.memory_report()
+    assert report == memory_report(code)
+    counts = {name: entry["count"] for name, entry in report["types"].items()}
+    assert 1 == counts["Template"]
+    assert 1 == counts["Parameter"]
+    assert 1 == counts["Wikilink"]
+    assert 4 == counts["Text"]
+    assert 5 == counts["Wikicode"]
+    assert 5 == counts["SmartList"]
+    assert all(entry["bytes"] > 0 for entry in report["types"].values())
+    assert report["types"]["Text"]["bytes"] >= 4 * sys.getsizeof(code.get(1))
+
+
+def test_strings():
+    """test that shared and unique strings are told apart"""
+    code = mwparserfromhell.parse("{{foo}}{{foo}}")
+    strings = code.memory_report()["strings"]
+    assert 1 == strings["count"]
+    assert 2 == strings["references"]
+    assert (1, 0) == (strings["shared"], strings["unique"])
+    assert 3 == strings["payload_bytes"]
+    assert sys.getsizeof("foo") == strings["bytes"]
+    assert strings["bytes"] - 3 == strings["overhead_bytes"]
+
+    strings = mwparserfromhell.parse("é€\U0001f600").memory_report()["strings"]
+    assert (1, 0, 1) == (strings["count"], strings["shared"], strings["unique"])
+    assert 12 == strings["payload_bytes"]
+
+
+def test_proxies_and_totals():
+    """test that slices of a list are counted as ListProxies, and the totals"""
+    code = mwparserfromhell.parse("a{{b}}c")
+    before = code.memory_report()
+    sub = mwparserfromhell.wikicode.Wikicode(code.nodes[1:])
+    report = memory_report(sub)
+    assert 1 == report["types"]["ListProxy"]["count"]
+    # The parent list is also counted, and now keeps track of its child:
+    lists = report["types"]["SmartList"]
+    assert before["types"]["SmartList"]["count"] == lists["count"]
+    assert before["types"]["SmartList"]["bytes"] < lists["bytes"]
+    total = report["total"]
+    assert total["bytes"] == report["strings"]["bytes"] + sum(
+        entry["bytes"] for entry in report["types"].values()
+    )
+    assert total["count"] == report["strings"]["count"] + sum(
+        entry["count"] for entry in report["types"].values()
+    )
+    assert {"count": 0, "bytes": 0} != total
@@ -22,9 +22,13 @@
 Tests for the Parser class itself, which tokenizes and builds nodes.
 """
 
+from html.entities import entitydefs
+import tracemalloc
+
 import pytest
 
 from mwparserfromhell import parser
+from mwparserfromhell.parser import tokens
 from mwparserfromhell.nodes import Tag, Template, Text, Wikilink
 from mwparserfromhell.nodes.extras import Parameter
 from .conftest import assert_wikicode_equal, wrap, wraptext
@@ -99,3 +103,270 @@ def test_skip_style_tags(pyparser):
     without_style = parser.Parser().parse(text, skip_style_tags=True)
     assert_wikicode_equal(a, with_style)
     assert_wikicode_equal(b, without_style)
+
+
+@pytest.fixture(params=[False, True], ids=["python", "c"])
+def anyparser(request, monkeypatch):
+    """run the test with both tokenizers"""
+    if request.param and not parser.CTokenizer:
+        pytest.skip("C tokenizer not available")
+    monkeypatch.setattr(parser, "use_c", request.param)
+
+
+def test_entity_names(anyparser):
+    """test that every HTML entity name is recognized, and nothing else"""
+    names = sorted(entitydefs) + ["foobar", "NBSP", "amp2", "zwnj_"]
+    code = parser.Parser().parse("".join("&{};".format(name) for name in names))
+    entities = [node.value for node in code.filter_html_entities()]
+    assert sorted(entitydefs) == entities
+
+
+def test_drop_comments(anyparser):
+    """test Parser.parse(drop_comments=True)"""
+    text = "foo<!-- bar -->baz {{temp<!--\n-->late|a<!---->=b}}<!--unclosed"
+    expected = wrap(
+        [
+            Text("foobaz "),
+            Template(wraptext("template"), [Parameter(wraptext("a"), wraptext("b"))]),
+            Text("<!--unclosed"),
+        ]
+    )
+    actual = parser.Parser().parse(text, drop_comments=True)
+    assert_wikicode_equal(expected, actual)
+    assert len(parser.Parser().parse(text).filter_comments()) == 3
+
+
+def test_view(anyparser):
+    """test Parser.parse(view=...)"""
+    text = (
+        "{{a}}<noinclude>{{doc}}\n[[Category:Foo]]</noinclude>"
+        "<includeonly>{{b}}</includeonly><!-- <noinclude> -->{{c}}"
+    )
+    page = parser.Parser().parse(text, view="page")
+    assert page == "{{a}}{{doc}}\n[[Category:Foo]]<!-- <noinclude> -->{{c}}"
+    assert [str(t.name) for t in page.filter_templates()] == ["a", "doc", "c"]
+    transcluded = parser.Parser().parse(text, view="transcluded")
+    assert transcluded == "{{a}}{{b}}<!-- <noinclude> -->{{c}}"
+    assert [str(t.name) for t in transcluded.filter_templates()] == ["a", "b", "c"]
+
+    text = "x<onlyinclude>{{a}}</onlyinclude><NOINCLUDE/>y<onlyinclude>z"
+    assert parser.Parser().parse(text, view="transcluded") == "{{a}}z"
+    assert parser.Parser().parse(text, view="page") == "x{{a}}yz"
+    assert parser.Parser().parse("a<noinclude>b", view="transcluded") == "a"
+    assert parser.Parser().parse(text) == text
+    with pytest.raises(ValueError):
+        parser.Parser().parse(text, view="foo")
+
+
+def test_max_parse_depth(anyparser):
+    """test Parser.parse(max_parse_depth=...)"""
+    text = (
+        "{{Infobox|a={{cite|{{b}}|x=[[c|d]]}}|e=[[f|{{g}}]]<!--}}-->}}"
+        "[[h|{{i|<nowiki>}}</nowiki>}}]] {{j"
+    )
+    code = parser.Parser().parse(text, max_parse_depth=1)
+    assert text == code
+    infobox, link = code.filter(recursive=False, forcetype=(Template, Wikilink))
+    assert ["a", "e"] == [str(param.name) for param in infobox.params]
+    assert [Text] == [type(node) for node in infobox.get("a").value.nodes]
+    assert "{{cite|{{b}}|x=[[c|d]]}}" == infobox.get("a").value
+    assert [Text] == [type(node) for node in link.text.nodes]
+    assert "{{i|<nowiki>}}</nowiki>}}" == link.text
+    assert 5 == len(parser.Parser().parse(text).filter_templates())
+
+    deeper = parser.Parser().parse(text, max_parse_depth=2)
+    assert ["Infobox", "cite", "i"] == [
+        str(template.name) for template in deeper.filter_templates()
+    ]
+    assert ["f", "h"] == [str(link.title) for link in deeper.filter_wikilinks()]
+    assert "{{j" == parser.Parser().parse("{{j", max_parse_depth=0)
+    none = parser.Parser().parse(text, max_parse_depth=0)
+    assert [Text] == [type(node) for node in none.nodes[:1]]
+    assert not none.filter_templates() and not none.filter_wikilinks()
+    assert "[[a|b" == parser.Parser().parse("[[a|b", max_parse_depth=0)
+    nested = "{{a|" + "{{x|" * 200 + "y" + "}}" * 200 + "}}"
+    code = parser.Parser().parse(nested, max_parse_depth=1)
+    assert nested == code
+    assert 1 == len(code.get(0).params)
+    assert [Text] == [type(node) for node in code.get(0).params[0].value.nodes]
+    with pytest.raises(ValueError):
+        parser.Parser().parse(text, max_parse_depth=-1)
+
+
+def test_interning(anyparser):
+    """test that short strings are shared between identical tokens"""
+    text = '<ref name="a">{{cite web|url=x}}</ref> <ref name="b">{{cite web}}</ref>'
+    tags = parser.Parser().parse(text).filter_tags()
+    assert tags[0].tag.get(0).value is tags[1].tag.get(0).value
+    names = [tag.attributes[0].name.get(0).value for tag in tags]
+    assert names[0] is names[1]
+    templates = parser.Parser().parse(text).filter_templates()
+    assert templates[0].name.get(0).value is templates[1].name.get(0).value
+
+    other = parser.Parser().parse(text).filter_templates()[0]
+    assert other.name.get(0).value is not templates[0].name.get(0).value
+    shared = parser.Parser(keep_interned=True)
+    first = shared.parse(text).filter_templates()[0]
+    second = shared.parse(text).filter_templates()[1]
+    assert first.name.get(0).value is second.name.get(0).value
+
+
+def test_interning_table_released():
+    """test that the Python tokenizer drops its interned strings after a call"""
+    tokenizer = parser.tokenizer.Tokenizer()
+    tokenizer.tokenize("{{foo|bar}}")
+    assert {} == tokenizer._interned
+    tokenizer.tokenize_checkpointed("{{foo|bar}}\nbaz")
+    assert {} == tokenizer._interned
+    shared = parser.tokenizer.Tokenizer(keep_interned=True)
+    shared.tokenize("{{foo|bar}}")
+    assert "foo" in shared._interned
+
+
+def test_timings(anyparser, monkeypatch):
+    """test Parser.parse(timings=True) and the global timings hook"""
+    text = "foo {{bar|[[baz]]}} <b>qux</b>"
+    prs = parser.Parser()
+    assert prs.last_timings is None
+    prs.parse(text)
+    assert prs.last_timings is None
+    code = prs.parse(text, timings=True)
+    assert str(code) == text
+    timings = prs.last_timings
+    assert timings.length == len(text)
+    assert timings.tokens == 16
+    assert timings.nodes == 10
+    assert timings.tokenize_time >= 0 and timings.build_time >= 0
+    assert timings.total_time == timings.tokenize_time + timings.build_time
+    assert timings.as_dict()["nodes"] == 10
+    assert repr(timings).startswith("ParseTimings(length=30, tokens=16, nodes=10,")
+
+    seen = []
+    monkeypatch.setattr(parser.timings, "_hook", None)
+    parser.set_timings_hook(seen.append)
+    assert parser.get_timings_hook() == seen.append
+    try:
+        parser.Parser().parse("{{a}}")
+        parser.Parser().parse("{{b}}", timings=True)
+    finally:
+        parser.set_timings_hook(None)
+    parser.Parser().parse("{{c}}")
+    assert [timing.nodes for timing in seen] == [2, 2]
+
+
+@pytest.mark.skipif(not parser.CTokenizer, reason="C tokenizer not available")
+def test_tracemalloc_domain():
+    """test that the C tokenizer reports its allocations to tracemalloc"""
+    domain = parser.CTokenizer.TRACEMALLOC_DOMAIN
+    snapshots = []
+
+    def record(self, *args, **kwargs):
+        dict.__init__(self, *args, **kwargs)
+        if not snapshots:
+            snapshots.append(tracemalloc.take_snapshot())
+
+    tracemalloc.start()
+    tokens.Text.__init__ = record
+    try:
+        parser.CTokenizer().tokenize("{{foo|{{bar|[[baz]]}}}}")
+        after = tracemalloc.take_snapshot()
+    finally:
+        del tokens.Text.__init__
+        tracemalloc.stop()
+    # While tokenizing, the stacks are traced in the tokenizer's domain, and
+    # they are all released afterwards:
+    assert domain != 0
+    assert any(trace.domain == domain for trace in snapshots[0].traces)
+    during = {trace for trace in snapshots[0].traces if trace.domain == domain}
+    assert not during & {trace for trace in after.traces if trace.domain == domain}
+
+
+def test_tokenizer_memory(anyparser):
+    """test Parser.tokenizer_memory()"""
+    instance = parser.Parser()
+    instance.parse("{{a|[[b|{{c}}]]}} {{d")
+    stats = instance.tokenizer_memory()
+    if not parser.use_c:
+        assert stats is None
+        return
+    assert ["stacks", "textbuffers", "routes", "total"] == list(stats)
+    assert all(stats[key] > 0 for key in stats)
+    assert stats["total"] <= stats["stacks"] + stats["textbuffers"] + stats["routes"]
+    instance.parse("x")
+    small = instance.tokenizer_memory()
+    assert 0 == small["routes"]
+    assert small["total"] < stats["total"]
+
+
+REVISION_TEXT = """\
+{{Infobox|name=Foo
+|image=[[File:Foo.png|thumb]]}}
+'''Foo''' is a [[bar]].<ref>{{cite web|url=http://example.com|title=Baz}}</ref>
+
+== History ==
+Some text with &amp; and <!-- a comment --> in it.
+* a list item
+* another {{template|with
+multiple=lines}}
+
+== See also ==
+[http://example.com/ an external link]
+"""
+
+
+def test_parse_revision(anyparser):
+    """test Parser.parse_revision() against full parses of each revision"""
+    edits = [
+        ("Some text", "More text"),
+        ("== History ==", "== Early history =="),
+        ("multiple=lines}}", "multiple=lines"),
+        ("multiple=lines", "multiple=lines}}"),
+        ("'''Foo'''", "''Foo'''"),
+        ("<ref>", "<ref name=a>"),
+        ("\n[http", "\n{{stub}}\n[http"),
+        ("[[bar]]", "[[bar"),
+        ("{{Infobox", "{{{Infobox"),
+        ("See also", "See also <!--"),
+    ]
+    p = parser.Parser()
+    text = REVISION_TEXT
+    code = p.parse_revision(None, None, text)
+    assert_wikicode_equal(p.parse(text), code)
+    for old, new in edits:
+        assert old in text
+        new_text = text.replace(old, new, 1)
+        code = p.parse_revision(text, code, new_text)
+        assert_wikicode_equal(p.parse(new_text), code)
+        assert str(code) == new_text
+        text = new_text
+
+
+def test_parse_revision_reuse(anyparser):
+    """test that Parser.parse_revision() only reparses around the edit"""
+    p = parser.Parser()
+    text = REVISION_TEXT * 20
+    code = p.parse_revision(None, None, text)
+    assert code._revision.reparsed == (0, len(text))
+
+    index = text.index("Some text", len(text) // 2)
+    new_text = text[:index] + "[[Some]]" + text[index + 4 :]
+    new_code = p.parse_revision(text, code, new_text)
+    assert_wikicode_equal(p.parse(new_text), new_code)
+    start, end = new_code._revision.reparsed
+    assert start <= index < index + 8 <= end
+    assert end - start < len(REVISION_TEXT)
+    assert new_code.get(0) is code.get(0)
+    assert new_code.get(-1) is code.get(-1)
+
+    same = p.parse_revision(new_text, new_code, new_text)
+    assert same.nodes == new_code.nodes
+
+    # A missing or mismatched previous tree falls back to a full parse:
+    for prev_text, prev_code in [
+        (text, None),
+        (text, p.parse(text)),
+        (text + "x", code),
+    ]:
+        fallback = p.parse_revision(prev_text, prev_code, new_text)
+        assert fallback._revision.reparsed == (0, len(new_text))
+        assert_wikicode_equal(new_code, fallback)
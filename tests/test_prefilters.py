@@ -0,0 +1,122 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Tests for the prefilters module, which finds templates and links without parsing.
+"""
+
+import random
+
+import pytest
+
+import mwparserfromhell
+from mwparserfromhell import parser, prefilters
+from mwparserfromhell.prefilters import Prefilter
+
+
+@pytest.fixture(params=[False, True], ids=["python", "c"])
+def anyscanner(request, monkeypatch):
+    """run the test with both scanners"""
+    if request.param and not prefilters._prefilter_scan:
+        pytest.skip("C tokenizer not available")
+    monkeypatch.setattr(parser, "use_c", request.param)
+
+
+def test_matching(anyscanner):
+    """test the loose matching of names"""
+    pf = mwparserfromhell.prefilter(["Infobox person", "Cite web", "[[Paris"])
+    assert isinstance(pf, Prefilter)
+    for text in [
+        "{{Infobox person}}",
+        "{{infobox_person|a=b}}",
+        "x {{ \n Infobox   person \n|}}",
+        "{{Template:Infobox person}}",
+        "{{template : infobox person}}",
+        "{{Cite web<!-- c -->}}",
+        "{{cite web",
+        "[[Paris]]",
+        "[[ :paris#History|the city]]",
+        "{{{{cite web}}}}",
+    ]:
+        assert pf.matches(text), text
+        assert pf.matches(text.encode()), text
+    for text in [
+        "",
+        "{",
+        "{{Infobox persons}}",
+        "{{Infobox}}",
+        "{{InfoboX person}}",
+        "{{Paris}}",
+        "[[Cite webs]]",
+        "{{Template list|Infobox person}}",
+        "{ {Cite web}}",
+        "Infobox person",
+    ]:
+        assert not pf.matches(text), text
+        assert not pf.matches(text.encode()), text
+
+
+def test_search(anyscanner):
+    """test finding the offsets of every candidate"""
+    pf = Prefilter(["{{Foo", "[[Foo", "Bar baz", "{{Élan", "[[Foo bar"])
+    text = "{{foo}} [[Foo]] [[bar_baz]] é{{élan}} [[Foo bar|x]] {{Foo bar}}"
+    expected = [
+        (0, "{{Foo"),
+        (8, "[[Foo"),
+        (16, "Bar baz"),
+        (29, "{{Élan"),
+        (38, "[[Foo bar"),
+    ]
+    assert expected == pf.search(text)
+    encoded = [(len(text[:offset].encode()), pattern) for offset, pattern in expected]
+    assert encoded == pf.search(text.encode())
+    assert encoded == pf.search(bytearray(text.encode()))
+    assert [] == pf.search("{{Foo bar}}")
+
+
+def test_invalid():
+    """test that invalid patterns are rejected"""
+    for pattern in ["", "{{", "[[ ", "Foo|bar", "{{Foo}}", "Template:", "a#b"]:
+        with pytest.raises(ValueError):
+            Prefilter([pattern])
+    assert [(0, "[[a#b")] == Prefilter(["[[a#b"]).search("[[A]]")
+    assert not Prefilter([]).matches("{{Foo}} [[Bar]]")
+
+
+def test_consistent_with_parser(anyscanner):
+    """test that the prefilter finds every template and link the parser does"""
+    rand = random.Random(42)
+    names = ["Foo", "Foo bar", "Bar", "Baz_qux", "Émile"]
+    pieces = ["{{", "}}", "[[", "]]", "|", " ", "_", "\n", ":", "#", "<!-- -->", "x"]
+    pf = Prefilter(names)
+    for _ in range(300):
+        text = "".join(
+            rand.choice(pieces + names + [name.lower() for name in names])
+            for _ in range(rand.randint(1, 15))
+        )
+        code = mwparserfromhell.parse(text)
+        expected = any(
+            template.name.matches(names) for template in code.filter_templates()
+        ) or any(link.title.matches(names) for link in code.filter_wikilinks())
+        if expected:
+            assert pf.matches(text), text
+        assert pf.matches(text) == bool(pf.search(text))
+        assert pf.matches(text) == pf.matches(text.encode())
@@ -0,0 +1,119 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Tests for the rewrite module, which applies many rewrite rules in one pass.
+"""
+
+import mwparserfromhell
+from mwparserfromhell.nodes import Template, Text
+from mwparserfromhell.rewrite import Rewriter
+
+
+def test_rename_template():
+    """test renaming templates, keeping their whitespace"""
+    rules = Rewriter()
+    rules.rename_template("cite_web", "Cite news")
+    rules.rename_template("Foo", "{{bar}}")
+    code = mwparserfromhell.parse(
+        "{{ Cite web |url=a}} {{Template:cite web}} {{cite webs}} {{foo\n}}"
+    )
+    assert 3 == rules.apply(code)
+    assert "{{ Cite news |url=a}} {{Cite news}} {{cite webs}} {{{{bar}}\n}}" == code
+    first, _, _, fourth, _ = code.filter_templates()
+    assert [Text] == [type(node) for node in first.name.nodes]
+    assert isinstance(fourth.name.get(0), Template)
+
+
+def test_params():
+    """test renaming and removing parameters"""
+    rules = Rewriter()
+    rules.rename_param("Infobox person", "birthplace", "birth_place")
+    rules.remove_param("Infobox person", "deprecated")
+    rules.remove_param("foo", "1")
+    rules.rename_param("bar", "1", "text")
+    code = mwparserfromhell.parse(
+        "{{Infobox person\n| birthplace = Paris\n| deprecated = yes\n| name = X\n}}"
+        "{{foo|a|b|c}}{{bar|a|b}}{{Infobox person|birthplace=a|birth_place=b}}"
+    )
+    assert 4 == rules.apply(code)
+    assert (
+        "{{Infobox person\n| birth_place = Paris\n| name = X\n}}"
+        "{{foo|2=b|3=c}}{{bar|text=a|2=b}}"
+        "{{Infobox person|birthplace=a|birth_place=b}}"
+    ) == code
+
+
+def test_remove_matches_template_remove():
+    """test that removing parameters works like Template.remove()"""
+    for text, name in [
+        ("{{foo|a|b|c}}", "2"),
+        ("{{foo|a|1=b|c}}", "1"),
+        ("{{foo|x=1|y=2|x=3}}", "x"),
+        ("{{foo|a|b}}", "3"),
+    ]:
+        rules = Rewriter()
+        rules.remove_param("foo", name)
+        code = mwparserfromhell.parse(text)
+        rules.apply(code)
+        expected = mwparserfromhell.parse(text)
+        template = expected.get(0)
+        if template.has(name):
+            template.remove(name)
+        assert str(expected) == str(code)
+
+
+def test_links():
+    """test retargeting links"""
+    rules = Rewriter()
+    rules.retarget_link("Old page", "New page")
+    rules.retarget_link("Other", "Target#Top", keep_text=False)
+    code = mwparserfromhell.parse(
+        "[[old_page]] [[Old page#Life|life]] [[Other#Sec]] [[Old pages]]"
+    )
+    assert 3 == rules.apply(code)
+    assert (
+        "[[New page|old_page]] [[New page#Life|life]] [[Target#Top]] [[Old pages]]"
+    ) == code
+
+
+def test_callbacks():
+    """test on_template() and on_link() callbacks"""
+    seen = []
+    rules = Rewriter()
+    rules.rename_template("Foo", "Bar")
+    rules.on_template("Foo", lambda template: seen.append(str(template)))
+    rules.on_template("Baz", lambda template: template.add("x", "y") or True)
+    rules.on_link("A", lambda link: setattr(link, "text", "b") or True)
+    code = mwparserfromhell.parse("{{foo|1}} {{baz}} [[a]] {{bar}}")
+    assert 3 == rules.apply(code)
+    assert ["{{Bar|1}}"] == seen
+    assert "{{Bar|1}} {{baz|x=y}} [[a|b]] {{bar}}" == code
+
+
+def test_nested_and_rewrite():
+    """test nested templates and the rewrite() shortcut"""
+    rules = Rewriter()
+    assert "{{a}}" == rules.rewrite("{{a}}")
+    rules.rename_template("a", "b")
+    rules.rename_param("b", "x", "y")
+    assert "{{b|x={{b|x=1}}}}" == rules.rewrite("{{a|x={{a|x=1}}}}")
+    assert "{{b|y={{b}}}}" == rules.rewrite("{{b|x={{a}}}}")
+    assert "[[a]]" == rules.rewrite("[[a]]")
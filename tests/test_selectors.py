@@ -0,0 +1,171 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""
+Tests for the selectors module, which finds nodes using CSS-like selectors.
+"""
+
+import pytest
+
+import mwparserfromhell
+from mwparserfromhell.nodes.extras import Attribute, Parameter
+from mwparserfromhell.selectors import Selector, SelectorError, compile_selector
+
+TEXT = """{{Infobox person|name=X|birth_place=[[Paris]], [[France]]|death_place=[[Nice]]
+}}
+{{infobox_settlement <!-- c --> | birth_place = [[Lyon]] {{flag|[[Deep]]}} }}
+== Life ==
+<ref name="a">{{cite|url=http://example.com}}</ref><ref group=n>[[Q|q]]</ref>
+{{Foo|{{{arg|default}}}}} &nbsp; [http://example.org Site]"""
+
+
+def select(selector, text=TEXT):
+    return [str(elem) for elem in mwparserfromhell.parse(text).select(selector)]
+
+
+def test_compile():
+    """test compile_selector() and passing Selector objects to select()"""
+    selector = compile_selector("template")
+    assert isinstance(selector, Selector)
+    assert compile_selector("template") is selector
+    assert "Selector('template')" == repr(selector)
+    code = mwparserfromhell.parse("{{a|{{b}}}}")
+    assert ["{{a|{{b}}}}", "{{b}}"] == [str(node) for node in code.select(selector)]
+    assert code.select(selector) == selector.select(code)
+    assert code.select(selector) == list(code.iselect("template"))
+
+
+def test_types():
+    """test selecting nodes by type"""
+    code = mwparserfromhell.parse(TEXT)
+    assert select("template") == [str(node) for node in code.filter_templates()]
+    assert ["[[Paris]]", "[[France]]", "[[Nice]]", "[[Lyon]]", "[[Deep]]"] == select(
+        "wikilink"
+    )[:5]
+    assert ["http://example.com", "[http://example.org Site]"] == select("extlink")
+    assert ["== Life =="] == select("heading")
+    assert ["<!-- c -->"] == select("comment")
+    assert ["&nbsp;"] == select("entity")
+    assert ["{{{arg|default}}}"] == select("argument")
+    assert [' name="a"', " group=n"] == select("attribute")
+    assert ["name=X", "birth_place=[[Paris]], [[France]]"] == select("param")[:2]
+    assert select("param") == select("parameter")
+    types = (mwparserfromhell.nodes.Template, mwparserfromhell.nodes.Wikilink)
+    assert select("template, wikilink") == [
+        str(node) for node in code.filter(forcetype=types)
+    ]
+
+
+def test_predicates():
+    """test the different predicate operators"""
+    assert ["{{Foo|{{{arg|default}}}}}"] == select("template[name=foo]")
+    assert ["{{Foo|{{{arg|default}}}}}"] == select("template[name='Foo']")
+    assert 2 == len(select("template[name~=Infobox*]"))
+    assert 2 == len(select("template[name~=infobox_*]"))
+    assert 2 == len(select("template[name^=Infobox]"))
+    assert ["{{cite|url=http://example.com}}"] == select("template[name$=ite]")
+    assert ["{{flag|[[Deep]]}}"] == select("template[name*=la]")
+    assert 1 == len(select("template[name*='x_person']"))
+    assert 4 == len(select("template[name!=Foo]"))
+    assert ["{{Foo|{{{arg|default}}}}}"] == select("template[name=FOO i]")
+    assert [] == select("template[name=FOO]")
+    assert ["{{Infobox settlement}}"] == select(
+        "template[name='Infobox settlement']", "{{Infobox settlement}}"
+    )
+    assert ["[[Q|q]]"] == select("wikilink[text]")
+    assert ["[[Q|q]]"] == select("wikilink[text=q]")
+    assert ["[[Paris]]"] == select("wikilink[title=paris]")
+    assert ["== Life =="] == select("heading[level=2][title=Life]")
+    assert ["q"] == select("text[value=q]")
+    assert ["&nbsp;"] == select("entity[value=nbsp]")
+    assert ["{{{arg|default}}}"] == select("argument[default=default]")
+    assert ["[http://example.org Site]"] == select('extlink[url^="http://"][title]')
+    assert ["<ref group=n>[[Q|q]]</ref>"] == select("tag[name=REF][@group]")
+    assert ["<ref group=n>[[Q|q]]</ref>"] == select("tag[@group=n]")
+    assert [] == select("tag[@group=m]")
+    assert ["[a]"] == select(r'text[value="\[a\]"]', "[a]")
+
+
+def test_universal_predicates():
+    """test that each type normalizes values for * in its own way"""
+    text = "{{foo|x}} <foo>y</foo> {{{foo}}} [[foo bar]] [[Foo_bar]]"
+    assert ["{{foo|x}}", "<foo>y</foo>", "{{{foo}}}"] == select("*[name=foo]", text)
+    assert ["{{foo|x}}", "<foo>y</foo>"] == select("*[name=Foo]", text)
+    assert ["[[foo bar]]", "[[Foo_bar]]"] == select("*[title=foo_bar]", text)
+    assert ["[[foo bar]]", "[[Foo_bar]]"] == select("*[title$=o_bar]", text)
+    assert ["{{foo|x}}", "<foo>y</foo>", "{{{foo}}}"] == select("*[name=FOO i]", text)
+
+
+def test_combinators():
+    """test selecting descendants and children"""
+    query = "template[name~=Infobox*] > param[name=birth_place] wikilink"
+    assert ["[[Paris]]", "[[France]]", "[[Lyon]]", "[[Deep]]"] == select(query)
+    query = "template[name~=Infobox*] > param[name=birth_place] > wikilink"
+    assert ["[[Paris]]", "[[France]]", "[[Lyon]]"] == select(query)
+    assert ["{{flag|[[Deep]]}}", "{{cite|url=http://example.com}}"] == select(
+        "* > template"
+    )
+    assert 3 == len(select("> template"))
+    assert ["{{cite|url=http://example.com}}"] == select(
+        "tag[name=ref][@name=a] template"
+    )
+    assert [" group=n"] == select("tag > attribute[name=group]")
+    assert [] == select("wikilink > param")
+    assert ["{{b}}"] == select("template template", "{{a|{{b}}}}")
+    text = "{{a|{{b|{{c}}}}}}"
+    assert ["{{b|{{c}}}}", "{{c}}"] == select("template template", text)
+    assert ["{{c}}"] == select("template template template", text)
+    assert ["{{c}}"] == select("template >param>template>param> template", text)
+
+
+def test_element_types():
+    """test that parameters and attributes are selected as themselves"""
+    code = mwparserfromhell.parse(TEXT)
+    params = code.select("template[name=Foo] > param")
+    assert [Parameter] == [type(param) for param in params]
+    assert params[0] is code.filter_templates(matches="Foo")[0].params[0]
+    attrs = code.select("attribute[name=name][value=a]")
+    assert [Attribute] == [type(attr) for attr in attrs]
+
+
+@pytest.mark.parametrize(
+    "selector",
+    [
+        "",
+        "foo",
+        "template[",
+        "template[name",
+        "template[name=]",
+        "template[name=x",
+        "template[title=x]",
+        "template,",
+        "template]",
+        "template > ",
+        "template[name=x]wikilink",
+        "template[@name]",
+        "template ! wikilink",
+    ],
+)
+def test_errors(selector):
+    """test that invalid selectors raise SelectorError"""
+    with pytest.raises(SelectorError):
+        compile_selector(selector)
+    with pytest.raises(ValueError):
+        mwparserfromhell.parse("").select(selector)
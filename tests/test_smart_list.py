@@ -22,12 +22,21 @@
 Test cases for the SmartList class and its child, ListProxy.
 """
 
+import copy
+import pickle
+
 import pytest
 
-from mwparserfromhell.smart_list import SmartList
+from mwparserfromhell.smart_list import ChunkedSmartList, SmartList, smart_list
 from mwparserfromhell.smart_list.list_proxy import ListProxy
 
 
+class _TinyChunkedSmartList(ChunkedSmartList):
+    """A ChunkedSmartList with tiny chunks, so that tests span many of them."""
+
+    CHUNK_SIZE = 2
+
+
 def _test_get_set_del_item(builder):
     """Run tests on __get/set/delitem__ of a list built with *builder*."""
     list1 = builder([0, 1, 2, 3, "one", "two"])
@@ -276,6 +285,13 @@ def _dispatch_test_for_children(meth):
     meth(lambda L: SmartList([101, 102] + list(L) + [201, 202])[2:-2])
 
 
+def _dispatch_test_for_chunked(meth):
+    """Run a test method on chunked lists and their children."""
+    meth(_TinyChunkedSmartList)
+    meth(lambda L: _TinyChunkedSmartList(list(L))[:])
+    meth(lambda L: _TinyChunkedSmartList([101, 102] + list(L) + [201])[2:-1])
+
+
 def test_docs():
     """make sure the methods of SmartList/ListProxy have docstrings"""
     methods = [
@@ -348,9 +364,67 @@ def test_child_methods():
     _dispatch_test_for_children(_test_list_methods)
 
 
-def test_influence():
+def test_chunked_get_set_del():
+    """make sure ChunkedSmartList's getitem/setitem/delitem work"""
+    _dispatch_test_for_chunked(_test_get_set_del_item)
+
+
+def test_chunked_add():
+    """make sure ChunkedSmartList's add/radd/iadd work"""
+    _dispatch_test_for_chunked(_test_add_radd_iadd)
+
+
+def test_chunked_other_magics():
+    """make sure ChunkedSmartList's other magically implemented features work"""
+    _dispatch_test_for_chunked(_test_other_magic_methods)
+
+
+def test_chunked_methods():
+    """make sure ChunkedSmartList's non-magic methods work, like append()"""
+    _dispatch_test_for_chunked(_test_list_methods)
+
+
+def test_chunked_storage():
+    """make sure ChunkedSmartList keeps its chunks balanced and copies well"""
+    parent = _TinyChunkedSmartList(range(20))
+    assert 10 == len(parent._chunks)
+    assert [] == list.copy(parent)
+    for i in range(30):
+        parent.insert(7, i)
+    del parent[5:45]
+    assert [0, 1, 2, 3, 4] + list(range(15, 20)) == parent
+    assert all(2 <= len(chunk) < 4 for chunk in parent._chunks)
+    assert parent == pickle.loads(pickle.dumps(parent))
+    assert parent == copy.deepcopy(parent)
+    assert _TinyChunkedSmartList is type(copy.copy(parent))
+
+
+def test_chunked_selection(monkeypatch):
+    """make sure long SmartLists are created as or become ChunkedSmartLists"""
+    monkeypatch.setattr(smart_list, "CHUNKED_THRESHOLD", 5)
+    assert SmartList is type(SmartList([0, 1, 2, 3, 4]))
+    assert SmartList is type(SmartList(iter(range(10))))
+    assert ChunkedSmartList is type(SmartList(range(6)))
+    assert ChunkedSmartList is type(SmartList([0, 1, 2]) + [3, 4, 5])
+
+    parent = SmartList([0, 1, 2, 3])
+    child = parent[1:3]
+    parent.append(4)
+    assert SmartList is type(parent)
+    parent.insert(0, -1)
+    assert ChunkedSmartList is type(parent)
+    assert [-1, 0, 1, 2, 3, 4] == parent
+    assert [1, 2] == child
+    child.append(2.5)
+    parent.insert(1, -0.5)
+    assert [-1, -0.5, 0, 1, 2, 2.5, 3, 4] == parent
+    assert [1, 2, 2.5] == child
+
+
+@pytest.mark.parametrize("cls", [SmartList, _TinyChunkedSmartList])
+def test_influence(cls):
     """make sure changes are propagated from parents to children"""
-    parent = SmartList([0, 1, 2, 3, 4, 5])
+    parent = cls([0, 1, 2, 3, 4, 5])
     child1 = parent[2:]
     child2 = parent[2:5]
     assert [0, 1, 2, 3, 4, 5] == parent
@@ -432,3 +506,8 @@ def test_influence():
     assert [6, 5, 2, 3, 4, 1] == parent
     assert [4, 3, 2] == child2
     assert 0 == len(parent._children)
+
+    child4 = parent[1:3]
+    parent.clear()
+    assert [] == parent
+    assert [] == child4
@@ -132,6 +132,20 @@ def test_c_tokenizer_uses_c():
     assert CTokenizer().USES_C is True
 
 
+@pytest.mark.skipif(CTokenizer is None, reason="CTokenizer not available")
+def test_text_merged_into_emitted_stack():
+    """make sure text before an emitted stack is merged into its first Text"""
+    for text in [
+        "===" + "x" * 3000 + "==\n",
+        "===ä€==\n",
+        "==😀 " + "x" * 100 + "=\n",
+        "=== x ==\n=😀=",
+    ]:
+        expected = PyTokenizer().tokenize(text)
+        assert expected == CTokenizer().tokenize(text)
+        assert text == str(Builder().build(expected))
+
+
 def test_describe_context():
     assert "" == contexts.describe(0)
     ctx = contexts.describe(contexts.TEMPLATE_PARAM_KEY | contexts.HAS_TEXT)
@@ -0,0 +1,128 @@
+# Copyright (C) 2012-2022 Ben Kurtovic <ben.kurtovic@gmail.com>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+"""
+Tests for the transport module, which passes record batches through shared
+memory.
+"""
+
+import multiprocessing
+
+import pytest
+
+from mwparserfromhell.batches import RecordBatch, extract_templates
+from mwparserfromhell.transport import (
+    SegmentHandle,
+    SegmentPool,
+    batch_nbytes,
+    read_batch,
+    shared_memory,
+    write_batch,
+)
+
+needs_shm = pytest.mark.skipif(shared_memory is None, reason="needs Python 3.8+")
+
+
+def make_batch(pages=3):
+    pages = [(i, "{{a|x=ü|%d}} {{b}}" % i) for i in range(pages)]
+    return next(extract_templates(pages))
+
+
+def test_roundtrip():
+    """test writing a batch into a buffer and reading it back in place"""
+    batch = make_batch()
+    size = batch_nbytes(batch)
+    assert 0 == size % 8
+    buffer = bytearray(size)
+    assert size == write_batch(batch, buffer)
+    result = read_batch(buffer)
+    assert batch.schema == result.schema
+    assert batch.to_pylist() == result.to_pylist()
+    assert batch["page_id"] == result["page_id"]
+    assert batch["template"] == result["template"]
+    assert "ü" == result["value"][0]
+    assert isinstance(result["start"], memoryview)
+    assert result["start"].readonly
+    with pytest.raises(TypeError):
+        result["param"].append("x")
+
+
+def test_empty_and_errors():
+    """test edge cases of write_batch() and read_batch()"""
+    batch = RecordBatch([("a", "string")])
+    buffer = bytearray(batch_nbytes(batch))
+    write_batch(batch, buffer)
+    assert [] == read_batch(buffer).to_pylist()
+    with pytest.raises(ValueError):
+        write_batch(make_batch(), bytearray(16))
+    with pytest.raises(ValueError):
+        read_batch(bytearray(64))
+
+
+def _worker(writer, results, count):
+    for i in range(count):
+        results.put(writer.write(make_batch(i + 1)))
+    results.put(writer.write(make_batch(2000)))
+
+
+@needs_shm
+def test_pool():
+    """test passing batches from a worker process through a segment pool"""
+    context = multiprocessing.get_context()
+    results = context.Queue()
+    with SegmentPool(count=2, size=4096, context=context) as pool:
+        worker = context.Process(target=_worker, args=(pool.writer, results, 5))
+        worker.start()
+        names = set()
+        for i in range(5):
+            handle = results.get(timeout=30)
+            assert handle.pooled
+            names.add(handle.name)
+            with pool.open(handle) as batch:
+                assert make_batch(i + 1).to_pylist() == batch.to_pylist()
+            with pytest.raises(ValueError):
+                batch["page_id"][0]
+        assert 2 == len(names)
+
+        handle = results.get(timeout=30)
+        assert not handle.pooled
+        assert handle.nbytes > 4096
+        batch = pool.read(handle)
+        assert 6000 == len(batch)
+        pool.release(handle)
+        worker.join(30)
+        assert 0 == worker.exitcode
+        with pytest.raises(FileNotFoundError):
+            shared_memory.SharedMemory(handle.name)
+
+
+@needs_shm
+def test_pool_close():
+    """test that closing a pool releases batches still being read"""
+    pool = SegmentPool(count=1, size=4096)
+    handle = pool.writer.write(make_batch())
+    assert SegmentHandle(handle.name, batch_nbytes(make_batch()), True) == handle
+    batch = pool.read(handle)
+    pool.close()
+    with pytest.raises(ValueError):
+        len(batch["page_id"])
+    with pytest.raises(ValueError):
+        SegmentPool(count=0)
@@ -19,13 +19,20 @@
 # SOFTWARE.
 
 """
-Tests for the utils module, which provides parse_anything().
+Tests for the utils module, which provides parse_anything() and
+get_spans().
 """
 
 import pytest
 
 from mwparserfromhell.nodes import Template, Text
-from mwparserfromhell.utils import parse_anything
+from mwparserfromhell.utils import (
+    get_spans,
+    normalize_spaces,
+    normalize_title,
+    parse_anything,
+    render_title,
+)
 from .conftest import assert_wikicode_equal, wrap, wraptext
 
 
@@ -59,3 +66,42 @@ def test_parse_anything_invalid(invalid):
     """tests for invalid input to utils.parse_anything()"""
     with pytest.raises(ValueError):
         parse_anything(invalid)
+
+
+def test_get_spans():
+    """test that get_spans() gives the text of every node"""
+    text = (
+        "{{a|b| c = d |{{{e|f}}}}} [[g|h]] [http://i j] [http://k]http://l\n"
+        "== m ==\n<!-- n --> &amp; <ref name=\"o\" p='q' r>s</ref><br/> ''t''\n"
+        "{| class=u\n|-\n| v || w\n|} <x/ > </y>"
+    )
+    code = parse_anything(text)
+    spans = get_spans(code)
+    assert code.filter() == [node for node, _, _ in spans]
+    for node, start, end in spans:
+        assert str(node) == text[start:end]
+    assert [(code.get(0), 5, 30)] == get_spans(code, 5)[:1]
+
+
+def test_get_spans_hidden_title():
+    """test that the title of a link without brackets isn't given a span"""
+    code = parse_anything("x http://a.com y")
+    link = code.filter_external_links()[0]
+    link.title = "T"
+    assert "x http://a.com y" == code
+    assert len(str(code)) == len(code)
+    assert [(code.get(1), 2, 14), (link.url.get(0), 2, 14)] == get_spans(code)[1:3]
+    assert " y" == code.node_at(14)
+    spans = get_spans(code)
+    assert link.title.get(0) not in [node for node, _, _ in spans]
+    for node, start, end in spans:
+        assert str(node) == str(code)[start:end]
+
+
+def test_normalize_title():
+    """test that page titles are normalized like Wikicode.matches()"""
+    assert "Foo bar" == normalize_title("  foo__bar\n ")
+    assert "foo bar" == normalize_spaces("  foo _ bar ")
+    assert "" == normalize_title("")
+    assert "Foo bar" == render_title(parse_anything("foo_bar"))
+    assert "Foo bar" == render_title(parse_anything("foo<!-- c -->  bar"))
@@ -29,6 +29,7 @@ from types import GeneratorType
 import pytest
 
 from mwparserfromhell.nodes import Argument, Heading, Template, Text
+from mwparserfromhell.nodes.extras import Parameter
 from mwparserfromhell.smart_list import SmartList
 from mwparserfromhell.wikicode import Wikicode
 from mwparserfromhell import parse
@@ -118,6 +119,124 @@ def test_index():
         code.index(code.get(1).get(1).value, recursive=False)
 
 
+def test_positional_index():
+    """test len(), indexing, and node_at() using the positional index"""
+    text = "ab{{foo|x=[[bar|b]]}}<ref name=r>c</ref> ''d'' &amp;"
+    code = parse(text)
+    assert len(text) == len(code)
+    assert list(text) == [code[i] for i in range(len(text))]
+    assert list(text) == list(code)
+    assert ";" == code[-1]
+    assert text[3:15] == code[3:15]
+    assert text[-9:] == code[-9:]
+    assert text[::2] == code[::2]
+    assert "" == code[5:2]
+    with pytest.raises(IndexError):
+        code[len(text)]
+    with pytest.raises(IndexError):
+        parse("")[0]
+
+    assert "ab" == code.node_at(0)
+    assert "{{foo|x=[[bar|b]]}}" == code.node_at(2)
+    assert "foo" == code.node_at(4)
+    assert "[[bar|b]]" == code.node_at(10)
+    assert "b" == code.node_at(16)
+    assert "<ref name=r>c</ref>" == code.node_at(21)
+    assert "ref" == code.node_at(22)
+    assert "r" == code.node_at(31)
+    assert "<ref name=r>c</ref>" == code.node_at(32)
+    assert "c" == code.node_at(33)
+    assert "''d''" == code.node_at(-7)
+    assert "d" == code.node_at(-9)
+    assert "&amp;" == code.node_at(-1)
+    assert code.get(0) is code.node_at(1)
+    with pytest.raises(IndexError):
+        code.node_at(len(text))
+
+
+def test_positional_index_changes():
+    """test that the positional index follows changes to the tree"""
+    code = parse("{{foo|a}}[[b]]")
+    assert 14 == len(code)
+    template = code.get(0)
+    template.name = "quux"
+    assert 15 == len(code)
+    assert "quux" == code.node_at(3)
+    template.add("x", "yz")
+    assert "{{quux|a|x=yz}}" == code[:15]
+    assert "yz" == code.node_at(12)
+    template.get("x").value.nodes[0].value = "y"
+    assert "[[b]]" == code.node_at(14)
+    code.get(1).title.append("c")
+    assert "]" == code[-1]
+    assert 20 == len(code)
+    code.insert(0, "xyz")
+    assert "xyz" == code.node_at(0)
+    del code.nodes[:2]
+    assert "[[bc]]" == code
+    assert 6 == len(code)
+
+
+def test_positional_index_list_changes():
+    """test that the positional index follows edits to params and attributes"""
+    operations = [
+        lambda items: items.pop(),
+        lambda items: items.pop(0),
+        lambda items: items.append(items[0]),
+        lambda items: items.extend(items[:1]),
+        lambda items: items.insert(0, items[-1]),
+        lambda items: items.remove(items[0]),
+        lambda items: items.clear(),
+        lambda items: items.reverse(),
+        lambda items: items.sort(key=str),
+        lambda items: items.__setitem__(0, items[1]),
+        lambda items: items.__setitem__(slice(0, 1), []),
+        lambda items: items.__delitem__(0),
+        lambda items: items.__delitem__(slice(1, None)),
+        lambda items: items.__iadd__(items[:1]),
+        lambda items: items.__imul__(2),
+    ]
+    for operation in operations:
+        for text, get_list in [
+            ("x{{a|bb|c=d}}y", lambda code: code.get(1).params),
+            ("x<b p=1 qq='2'>t</b>y", lambda code: code.get(1).attributes),
+        ]:
+            code = parse(text)
+            assert len(text) == len(code)
+            operation(get_list(code))
+            assert len(str(code)) == len(code)
+            assert str(code) == code[:]
+            assert "y" == code.node_at(-1)
+
+
+def test_positional_index_plain_lists():
+    """test that the positional index isn't cached over plain lists"""
+    code = parse("a")
+    text = Text("bc")
+    code.nodes = [Text("a")]
+    assert 1 == len(code)
+    code.nodes.append(text)
+    assert "abc" == str(code)
+    assert 3 == len(code)
+    assert "c" == code[2]
+
+    plist = [Parameter(wraptext("1"), wraptext("b"), showkey=False)]
+    code = parse("x")
+    code.append(Template(wraptext("a"), plist))
+    assert "x{{a|b}}" == code and 8 == len(code)
+    plist.append(Parameter(wraptext("2"), wraptext("cd"), showkey=False))
+    assert "x{{a|b|cd}}" == code and 11 == len(code)
+    assert "cd" == code.node_at(7)
+
+    inner = parse("b")
+    inner.nodes = [Text("b")]
+    code = parse("x")
+    code.append(Template(inner))
+    assert 6 == len(code)
+    inner.nodes.append(Text("cd"))
+    assert "x{{bcd}}" == code and 8 == len(code)
+
+
 def test_get_ancestors_parent():
     """test Wikicode.get_ancestors() and Wikicode.get_parent()"""
     code = parse("{{a|{{b|{{d|{{e}}{{f}}}}{{g}}}}}}{{c}}")